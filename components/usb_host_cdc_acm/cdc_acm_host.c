@@ -7,7 +7,6 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/queue.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
@@ -25,14 +24,23 @@
 static const char *TAG = "cdc_acm";
 
 // Control transfer constants
-#define CDC_ACM_CTRL_TRANSFER_SIZE (64)   // All standard CTRL requests and responses fit in this size
 #define CDC_ACM_CTRL_TIMEOUT_MS    (5000) // Every CDC device should be able to respond to CTRL transfer in 5 seconds
 
+// RX and TX task constants, stack sizes are in cdc_host_types.h
+#define CDC_ACM_TX_TASK_TIMEOUT_MS (1000) // Timeout of one queued item sent by the TX task
+
 // CDC-ACM spinlock
 static portMUX_TYPE cdc_acm_lock = portMUX_INITIALIZER_UNLOCKED;
 #define CDC_ACM_ENTER_CRITICAL()   portENTER_CRITICAL(&cdc_acm_lock)
 #define CDC_ACM_EXIT_CRITICAL()    portEXIT_CRITICAL(&cdc_acm_lock)
 
+// Add n to a device statistics counter
+#define CDC_ACM_STATS_ADD(cdc_dev, counter, n) ({                           \
+            CDC_ACM_ENTER_CRITICAL();                                       \
+            (cdc_dev)->stats.counter += (n);                                \
+            CDC_ACM_EXIT_CRITICAL();                                        \
+})
+
 // CDC-ACM events
 #define CDC_ACM_TEARDOWN          BIT0
 #define CDC_ACM_TEARDOWN_COMPLETE BIT1
@@ -51,17 +59,78 @@ static portMUX_TYPE cdc_acm_lock = portMUX_INITIALIZER_UNLOCKED;
             }                                                               \
 })
 
+// Device table
+#define CDC_ACM_DEV_MAX            (32) // Maximum number of open CDC devices
+#define CDC_ACM_USB_DEV_INDEX_BITS (6)
+#define CDC_ACM_USB_DEV_INDEX_SIZE (1 << CDC_ACM_USB_DEV_INDEX_BITS) // Must be larger than CDC_ACM_DEV_MAX
+#define CDC_ACM_USB_DEV_INDEX_MASK (CDC_ACM_USB_DEV_INDEX_SIZE - 1)
+#define CDC_ACM_SLOT_NONE          (-1)
+#define CDC_ACM_HDL_GEN_MASK       (0xFFFFFFU) // Handle is (generation << 8) | (slot + 1)
+
 // CDC-ACM driver object
 typedef struct {
     usb_host_client_handle_t cdc_acm_client_hdl;        /*!< USB Host handle reused for all CDC-ACM devices in the system */
     SemaphoreHandle_t open_close_mutex;
     EventGroupHandle_t event_group;
     cdc_acm_new_dev_callback_t new_dev_cb;
-    SLIST_HEAD(list_dev, cdc_dev_s) cdc_devices_list;   /*!< List of open pseudo devices */
+    TaskHandle_t driver_task;                           /*!< Task that handles USB Host client events, all transfer callbacks run in it */
+    struct {
+        cdc_dev_t *dev;                                 /*!< Open CDC device, NULL if the slot is free */
+        uint32_t gen;                                   /*!< Incremented when the device is closed, so stale handles do not match */
+        int8_t next;                                    /*!< Next slot on the same USB device, CDC_ACM_SLOT_NONE if none */
+    } slots[CDC_ACM_DEV_MAX];                           /*!< Open CDC devices indexed by handle, protected by CDC-ACM spinlock */
+    struct {
+        usb_device_handle_t dev_hdl;                    /*!< USB device, NULL if the entry is free */
+        uint16_t vid;                                   /*!< VID of the USB device */
+        uint16_t pid;                                   /*!< PID of the USB device */
+        int8_t first;                                   /*!< First slot on this USB device */
+    } usb_devs[CDC_ACM_USB_DEV_INDEX_SIZE];             /*!< Hash index of USB devices with open CDC devices, protected by CDC-ACM spinlock */
+    int dev_count;                                      /*!< Number of open CDC devices, protected by CDC-ACM spinlock */
+    struct {
+        bool waiting;                                   /*!< cdc_acm_host_open() waits for a new device, protected by CDC-ACM spinlock */
+        uint16_t vid;                                   /*!< VID of the awaited device, can be CDC_HOST_ANY_VID */
+        uint16_t pid;                                   /*!< PID of the awaited device, can be CDC_HOST_ANY_PID */
+        const char *serial;                             /*!< Serial number of the awaited device, NULL for any */
+        usb_device_handle_t dev_hdl;                    /*!< Matching device opened in usb_event_cb() */
+        SemaphoreHandle_t found;                        /*!< Given when dev_hdl is set */
+    } open_wait;                                        /*!< Hand-off of new devices to cdc_acm_host_open() */
 } cdc_acm_obj_t;
 
 static cdc_acm_obj_t *p_cdc_acm_obj = NULL;
 
+#if CONFIG_CDC_ACM_STATIC_POOL
+#define CDC_ACM_POOL_XFER_NUM (2 + 2 * CDC_ACM_IN_XFER_NUM_MAX + CDC_ACM_OUT_XFER_NUM_MAX) // Notification, CTRL, IN, spare IN and OUT transfers
+
+// USB transfer owned by a pool slot
+typedef struct {
+    usb_transfer_t *xfer;                 // Transfer, NULL if the entry is empty
+    size_t size;                          // Requested buffer size, the transfer is reused only for the same size
+    bool in_use;                          // Transfer is used by the device in the slot
+} cdc_pool_xfer_t;
+
+// Static device pool
+static struct {
+    cdc_dev_t devs[CONFIG_CDC_ACM_STATIC_POOL_SIZE];
+    bool used[CONFIG_CDC_ACM_STATIC_POOL_SIZE];       // Protected by CDC-ACM spinlock
+    cdc_pool_xfer_t xfers[CONFIG_CDC_ACM_STATIC_POOL_SIZE][CDC_ACM_POOL_XFER_NUM]; // Only accessed by the device in the slot
+    int in_use;                                       // Protected by CDC-ACM spinlock
+    int high_water;                                   // Protected by CDC-ACM spinlock
+} cdc_acm_pool;
+
+#define CDC_ACM_SEM_BINARY_CREATE(cdc_dev, buf)              xSemaphoreCreateBinaryStatic(&(cdc_dev)->static_buf.buf)
+#define CDC_ACM_SEM_COUNTING_CREATE(cdc_dev, buf, max, init) xSemaphoreCreateCountingStatic((max), (init), &(cdc_dev)->static_buf.buf)
+#define CDC_ACM_MUTEX_CREATE(cdc_dev, buf)                   xSemaphoreCreateMutexStatic(&(cdc_dev)->static_buf.buf)
+#define CDC_ACM_CTRL_QUEUE_CREATE(cdc_dev)                   xQueueCreateStatic(CDC_ACM_CTRL_QUEUE_LEN, sizeof(cdc_ctrl_req_t), \
+                                                                 (cdc_dev)->static_buf.ctrl_queue_storage, &(cdc_dev)->static_buf.ctrl_queue)
+#define CDC_ACM_TIMER_CREATE(cdc_dev, buf, name, period, cb) xTimerCreateStatic((name), (period), pdFALSE, (cdc_dev), (cb), &(cdc_dev)->static_buf.buf)
+#else
+#define CDC_ACM_SEM_BINARY_CREATE(cdc_dev, buf)              xSemaphoreCreateBinary()
+#define CDC_ACM_SEM_COUNTING_CREATE(cdc_dev, buf, max, init) xSemaphoreCreateCounting((max), (init))
+#define CDC_ACM_MUTEX_CREATE(cdc_dev, buf)                   xSemaphoreCreateMutex()
+#define CDC_ACM_CTRL_QUEUE_CREATE(cdc_dev)                   xQueueCreate(CDC_ACM_CTRL_QUEUE_LEN, sizeof(cdc_ctrl_req_t))
+#define CDC_ACM_TIMER_CREATE(cdc_dev, buf, name, period, cb) xTimerCreate((name), (period), pdFALSE, (cdc_dev), (cb))
+#endif
+
 /**
  * @brief Default CDC-ACM driver configuration
  *
@@ -95,12 +164,32 @@ static void in_xfer_cb(usb_transfer_t *transfer);
 /**
  * @brief Data send callback
  *
- * Reused for bulk OUT and CTRL transfers
+ * Bulk OUT transfer is returned to the pool of idle transfers and the user is notified about its completion.
  *
  * @param[in] transfer Transfer that triggered the callback
  */
 static void out_xfer_cb(usb_transfer_t *transfer);
 
+/**
+ * @brief Account completed OUT transfer of cdc_acm_host_data_tx_blocking()
+ *
+ * Transfers of a timed out call can complete during the next call, they are ignored.
+ *
+ * @param[in] cdc_dev  Pointer to CDC device
+ * @param[in] tx_seq   Sequence number of the call that submitted the transfer
+ * @param[in] status   Transfer status
+ * @param[in] data_len Number of bytes sent
+ */
+static void cdc_acm_tx_blocking_done(cdc_dev_t *cdc_dev, uint32_t tx_seq, esp_err_t status, size_t data_len);
+
+/**
+ * @brief Control transfer callback
+ *
+ * @param[in] transfer Transfer that triggered the callback
+ */
+static void ctrl_xfer_cb(usb_transfer_t *transfer);
+static void ctrl_async_xfer_cb(usb_transfer_t *transfer);
+
 /**
  * @brief USB Host Client event callback
  *
@@ -129,26 +218,415 @@ static void usb_event_cb(const usb_host_client_event_msg_t *event_msg, void *arg
  * @return esp_err_t
  */
 static esp_err_t send_cdc_request(cdc_dev_t *cdc_dev, bool in_transfer, cdc_request_code_t request, uint8_t *data, uint16_t data_len, uint16_t value);
+static esp_err_t send_cdc_request_async(cdc_dev_t *cdc_dev, bool in_transfer, cdc_request_code_t request, const uint8_t *data, uint16_t data_len, uint16_t value,
+                                        cdc_acm_ctrl_done_callback_t done_cb, void *user_arg);
+static void cdc_acm_ctrl_async_kick(cdc_dev_t *cdc_dev);
+static esp_err_t cdc_acm_ctrl_transfer_locked(cdc_dev_t *cdc_dev, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength, uint8_t *data);
+static void cdc_acm_ctrl_async_stop(cdc_dev_t *cdc_dev);
+
+/**
+ * @brief Check if the caller runs in the CDC-ACM driver task
+ *
+ * All transfer callbacks run in the driver task, so a blocking CTRL request issued from there
+ * would wait for a completion that can never be delivered.
+ *
+ * @return true if called from the driver task
+ */
+static inline bool cdc_acm_in_driver_task(void)
+{
+    return p_cdc_acm_obj && xTaskGetCurrentTaskHandle() == p_cdc_acm_obj->driver_task;
+}
 
 /**
  * @brief Reset IN transfer
  *
  * In in_xfer_cb() we can modify IN transfer parameters, this function resets the transfer to its defaults
  *
- * @param[in] cdc_dev Pointer to CDC device
+ * @param[in] cdc_dev  Pointer to CDC device
+ * @param[in] transfer IN transfer to be reset
  */
-static void cdc_acm_reset_in_transfer(cdc_dev_t *cdc_dev)
+static void cdc_acm_reset_in_transfer(cdc_dev_t *cdc_dev, usb_transfer_t *transfer)
 {
-    assert(cdc_dev->data.in_xfer);
-    usb_transfer_t *transfer = cdc_dev->data.in_xfer;
-    uint8_t **ptr = (uint8_t **)(&(transfer->data_buffer));
-    *ptr = cdc_dev->data.in_data_buffer_base;
+    assert(transfer);
+    if (transfer == cdc_dev->data.in_xfer[0]) {
+        // Only the first IN transfer can have its data buffer moved by RX buffer append
+        uint8_t **ptr = (uint8_t **)(&(transfer->data_buffer));
+        *ptr = cdc_dev->data.in_data_buffer_base;
+    }
     transfer->num_bytes = transfer->data_buffer_size;
     // This is a hotfix for IDF changes, where 'transfer->data_buffer_size' does not contain actual buffer length,
     // but *allocated* buffer length, which can be larger if CONFIG_HEAP_POISONING_COMPREHENSIVE is enabled
     transfer->num_bytes -= transfer->data_buffer_size % cdc_dev->data.in_mps;
+    if (cdc_dev->data.in_adaptive && (cdc_dev->data.in_xfer_size < transfer->num_bytes)) {
+        transfer->num_bytes = cdc_dev->data.in_xfer_size;
+    }
+}
+
+/**
+ * @brief Adapt size of IN transfers to the traffic
+ *
+ * Sustained traffic fills the transfers completely, so the size is doubled, up to the whole IN buffer.
+ * Sparse traffic leaves the transfers mostly empty, so the size is halved, down to Maximum Packet Size.
+ * The size changes only after several consecutive transfers, to prevent oscillation.
+ *
+ * @param[in] cdc_dev  Pointer to CDC device
+ * @param[in] transfer Completed IN transfer
+ */
+static void cdc_acm_in_xfer_size_adapt(cdc_dev_t *cdc_dev, const usb_transfer_t *transfer)
+{
+    const size_t mps = cdc_dev->data.in_mps;
+    size_t size = cdc_dev->data.in_xfer_size;
+
+    if (transfer->actual_num_bytes >= transfer->num_bytes) {
+        cdc_dev->data.in_short_cnt = 0;
+        if ((size < cdc_dev->data.in_xfer_size_max) && (++cdc_dev->data.in_full_cnt >= CDC_ACM_IN_SIZE_GROW_THRESHOLD)) {
+            cdc_dev->data.in_full_cnt = 0;
+            size = (2 * size < cdc_dev->data.in_xfer_size_max) ? 2 * size : cdc_dev->data.in_xfer_size_max;
+            CDC_ACM_ENTER_CRITICAL();
+            cdc_dev->data.in_xfer_size = size;
+            cdc_dev->stats.in_xfer_size = size;
+            cdc_dev->stats.in_xfer_size_grow++;
+            CDC_ACM_EXIT_CRITICAL();
+        }
+    } else if (transfer->actual_num_bytes < transfer->num_bytes / 2) {
+        cdc_dev->data.in_full_cnt = 0;
+        if ((size > mps) && (++cdc_dev->data.in_short_cnt >= CDC_ACM_IN_SIZE_SHRINK_THRESHOLD)) {
+            cdc_dev->data.in_short_cnt = 0;
+            size = (size / 2 / mps) * mps;
+            size = (size < mps) ? mps : size;
+            CDC_ACM_ENTER_CRITICAL();
+            cdc_dev->data.in_xfer_size = size;
+            cdc_dev->stats.in_xfer_size = size;
+            cdc_dev->stats.in_xfer_size_shrink++;
+            CDC_ACM_EXIT_CRITICAL();
+        }
+    } else {
+        cdc_dev->data.in_full_cnt = 0;
+        cdc_dev->data.in_short_cnt = 0;
+    }
+}
+
+/**
+ * @brief Mark IN transfer as idle (not submitted)
+ *
+ * @param[in] cdc_dev  Pointer to CDC device
+ * @param[in] transfer IN transfer
+ */
+static void cdc_acm_in_xfer_set_idle(cdc_dev_t *cdc_dev, usb_transfer_t *transfer)
+{
+    CDC_ACM_ENTER_CRITICAL();
+    for (int i = 0; i < cdc_dev->data.in_xfer_num; i++) {
+        if (cdc_dev->data.in_xfer[i] == transfer) {
+            cdc_dev->data.in_xfer_idle |= (1U << i);
+            break;
+        }
+    }
+    CDC_ACM_EXIT_CRITICAL();
+}
+
+/**
+ * @brief Loan IN transfer to the user
+ *
+ * The transfer is moved to the spare slot reserved by cdc_acm_host_rx_buffer_hold()
+ * and the spare transfer takes its place among the IN transfers.
+ *
+ * @param[in] cdc_dev  Pointer to CDC device
+ * @param[in] transfer IN transfer held by the user
+ * @return Spare IN transfer that replaced the held one
+ */
+static usb_transfer_t *cdc_acm_in_xfer_loan(cdc_dev_t *cdc_dev, usb_transfer_t *transfer)
+{
+    // Restore default buffer pointer, while the transfer is still in its original slot
+    cdc_acm_reset_in_transfer(cdc_dev, transfer);
+
+    CDC_ACM_ENTER_CRITICAL();
+    const int spare_idx = __builtin_ctz(cdc_dev->data.in_xfer_hold);
+    cdc_dev->data.in_xfer_hold = 0;
+    usb_transfer_t *spare = cdc_dev->data.in_xfer_spare[spare_idx];
+    cdc_dev->data.in_xfer_spare[spare_idx] = transfer;
+    for (int i = 0; i < cdc_dev->data.in_xfer_num; i++) {
+        if (cdc_dev->data.in_xfer[i] == transfer) {
+            cdc_dev->data.in_xfer[i] = spare;
+            if (i == 0) {
+                cdc_dev->data.in_data_buffer_base = spare->data_buffer;
+            }
+            break;
+        }
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    cdc_acm_reset_in_transfer(cdc_dev, spare);
+    return spare;
+}
+
+/**
+ * @brief Submit all idle IN transfers
+ *
+ * The USB Host Library completes transfers of one endpoint in the order they were submitted,
+ * so the received data are delivered to the user in order, no matter how many transfers are in flight.
+ * While the user's data callback runs for one transfer, the remaining transfers keep the IN endpoint busy.
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ * @return esp_err_t
+ */
+static esp_err_t cdc_acm_in_xfers_submit(cdc_dev_t *cdc_dev)
+{
+    esp_err_t ret = ESP_OK;
+    while (1) {
+        CDC_ACM_ENTER_CRITICAL();
+        const uint8_t idle = cdc_dev->data.in_xfer_idle;
+        if ((idle == 0) || cdc_dev->data.in_pause) {
+            // Paused transfers stay idle, the device NAKs until polling is resumed
+            CDC_ACM_EXIT_CRITICAL();
+            break;
+        }
+        const int idx = __builtin_ctz(idle);
+        cdc_dev->data.in_xfer_idle &= ~(1U << idx);
+        CDC_ACM_EXIT_CRITICAL();
+
+        ESP_LOGD(TAG, "Submitting poll for BULK IN transfer");
+        ret = usb_host_transfer_submit(cdc_dev->data.in_xfer[idx]);
+        if (ret != ESP_OK) {
+            // Give the transfer back, it will be submitted after next completed transfer
+            CDC_ACM_ENTER_CRITICAL();
+            cdc_dev->data.in_xfer_idle |= (1U << idx);
+            CDC_ACM_EXIT_CRITICAL();
+            break;
+        }
+    }
+    return ret;
+}
+
+/**
+ * @brief Inform the user about RX data overrun
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_rx_overrun_notify(cdc_dev_t *cdc_dev)
+{
+    CDC_ACM_STATS_ADD(cdc_dev, rx_overruns, 1);
+    cdc_dev->serial_state.bOverRun = true;
+    if (cdc_dev->notif.cb) {
+        const cdc_acm_host_dev_event_data_t serial_state_event = {
+            .type = CDC_ACM_HOST_SERIAL_STATE,
+            .data.serial_state = cdc_dev->serial_state
+        };
+        cdc_dev->notif.cb(&serial_state_event, cdc_dev->cb_arg);
+    }
+    cdc_dev->serial_state.bOverRun = false;
+}
+
+/**
+ * @brief Resume IN polling paused by RX ring high-water mark, regardless of the ring level
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_rx_flow_resume(cdc_dev_t *cdc_dev)
+{
+    CDC_ACM_ENTER_CRITICAL();
+    const bool paused = cdc_dev->data.in_pause & CDC_ACM_RX_PAUSE_FLOW;
+    cdc_dev->data.in_pause &= ~CDC_ACM_RX_PAUSE_FLOW;
+    CDC_ACM_EXIT_CRITICAL();
+    if (paused) {
+        ESP_LOGD(TAG, "Resuming IN polling");
+        cdc_acm_in_xfers_submit(cdc_dev);
+    }
+}
+
+/**
+ * @brief Resume IN polling paused by RX ring high-water mark
+ *
+ * Called by the consumer of the RX ring after it drained some data.
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_rx_ring_drained(cdc_dev_t *cdc_dev)
+{
+    if (cdc_dev->rx.high_water == 0 || cdc_rx_ring_used(&cdc_dev->rx.ring) > cdc_dev->rx.low_water) {
+        return;
+    }
+    cdc_acm_rx_flow_resume(cdc_dev);
+}
+
+/**
+ * @brief End the calling RX or TX task after it gave its task_done semaphore
+ *
+ * Task of a pooled device has static storage that is reused by the next open. A task that deletes itself
+ * is cleaned up later by the idle task, so it suspends itself instead and cdc_acm_task_join() deletes it.
+ */
+static void cdc_acm_task_exit(void)
+{
+#if CONFIG_CDC_ACM_STATIC_POOL
+    vTaskSuspend(NULL);
+#else
+    vTaskDelete(NULL);
+#endif
+}
+
+/**
+ * @brief Make sure that RX or TX task ended by cdc_acm_task_exit() is deleted
+ *
+ * @param[in] task Task that gave its task_done semaphore
+ */
+static void cdc_acm_task_join(TaskHandle_t task)
+{
+#if CONFIG_CDC_ACM_STATIC_POOL
+    while (eTaskGetState(task) != eSuspended) {
+        vTaskDelay(1);
+    }
+    vTaskDelete(task);
+#else
+    (void)task;
+#endif
+}
+
+/**
+ * @brief RX task
+ *
+ * Drains the RX ring to the user's data callback, so a slow callback does not stall polling of the IN endpoint.
+ * The task is woken up by in_xfer_cb() every time new data are written to the ring.
+ *
+ * @param[in] arg Pointer to CDC device
+ */
+static void cdc_acm_rx_task(void *arg)
+{
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)arg;
+    size_t refused_len = 0; // Length of data that the user did not process in the last call of data_cb
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        CDC_ACM_ENTER_CRITICAL();
+        const bool task_exit = cdc_dev->rx.task_exit;
+        CDC_ACM_EXIT_CRITICAL();
+        if (task_exit) {
+            break;
+        }
+
+        const uint8_t *data;
+        size_t data_len;
+        // Call data_cb only if there are new data
+        while ((data_len = cdc_rx_ring_peek_all(&cdc_dev->rx.ring, &data)) > refused_len) {
+            CDC_ACM_ENTER_CRITICAL();
+            const cdc_acm_data_callback_t in_cb = cdc_dev->data.in_cb;
+            CDC_ACM_EXIT_CRITICAL();
+
+            if (!in_cb || in_cb(data, data_len, cdc_dev->cb_arg)) {
+                cdc_rx_ring_consume(&cdc_dev->rx.ring, data_len);
+                cdc_acm_rx_ring_drained(cdc_dev);
+                refused_len = 0;
+                continue;
+            }
+
+            // The user expects more data. They are appended to the current data, also across the end of the ring,
+            // unless the ring is full
+            if (data_len == cdc_dev->rx.ring.size) {
+                ESP_LOGW(TAG, "RX ring overflow");
+                cdc_acm_rx_overrun_notify(cdc_dev);
+                cdc_rx_ring_consume(&cdc_dev->rx.ring, data_len);
+                cdc_acm_rx_ring_drained(cdc_dev);
+                refused_len = 0;
+            } else {
+                refused_len = data_len;
+                // The rest of the message cannot arrive while IN polling is paused, fill the ring above high-water mark
+                cdc_acm_rx_flow_resume(cdc_dev);
+            }
+        }
+    }
+
+    xSemaphoreGive(cdc_dev->rx.task_done);
+    cdc_acm_task_exit();
+}
+
+/**
+ * @brief Stop deferred RX processing and free RX ring
+ *
+ * Blocks until the RX task returns from user's data callback.
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_rx_stop(cdc_dev_t *cdc_dev)
+{
+    if (cdc_dev->rx.task) {
+        CDC_ACM_ENTER_CRITICAL();
+        cdc_dev->rx.task_exit = true;
+        CDC_ACM_EXIT_CRITICAL();
+        xTaskNotifyGive(cdc_dev->rx.task);
+        xSemaphoreTake(cdc_dev->rx.task_done, portMAX_DELAY);
+        cdc_acm_task_join(cdc_dev->rx.task);
+        cdc_dev->rx.task = NULL;
+    }
+    if (cdc_dev->rx.task_done) {
+        vSemaphoreDelete(cdc_dev->rx.task_done);
+        cdc_dev->rx.task_done = NULL;
+    }
+    if (cdc_dev->rx.data_ready) {
+        vSemaphoreDelete(cdc_dev->rx.data_ready);
+        cdc_dev->rx.data_ready = NULL;
+    }
+    if (cdc_dev->rx.mux) {
+        vSemaphoreDelete(cdc_dev->rx.mux);
+        cdc_dev->rx.mux = NULL;
+    }
+    cdc_rx_ring_deinit(&cdc_dev->rx.ring);
+}
+
+/**
+ * @brief Allocate RX ring and start deferred RX processing
+ *
+ * If the user provided data_cb, RX task is started. Otherwise the ring is read by cdc_acm_host_data_rx().
+ *
+ * @param[in] cdc_dev    Pointer to CDC device
+ * @param[in] dev_config Device configuration
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_NO_MEM: Not enough memory for the ring or the task
+ */
+static esp_err_t cdc_acm_rx_start(cdc_dev_t *cdc_dev, const cdc_acm_host_device_config_t *dev_config)
+{
+    esp_err_t ret;
+#if CONFIG_CDC_ACM_STATIC_POOL && (CONFIG_CDC_ACM_STATIC_POOL_RX_RING_SIZE > 0)
+    uint8_t *ring_storage = cdc_dev->static_buf.rx_ring; // rx_ring_size was checked against the pool in cdc_acm_host_open()
+#else
+    uint8_t *ring_storage = NULL;
+#endif
+    // RX task delivers unprocessed data that wrap around the end of the ring in one block
+    ESP_RETURN_ON_ERROR(cdc_rx_ring_init(&cdc_dev->rx.ring, dev_config->rx_ring_size, dev_config->data_cb != NULL, ring_storage), TAG, "Could not allocate RX ring");
+    cdc_dev->rx.high_water = dev_config->rx_high_water;
+    cdc_dev->rx.low_water = dev_config->rx_low_water;
+
+    if (dev_config->data_cb == NULL) {
+        // Pull mode: cdc_acm_host_data_rx() waits for data_ready, rx_mux serializes the readers
+        cdc_dev->rx.trigger_level = (dev_config->rx_trigger_level == 0) ? 1 : dev_config->rx_trigger_level;
+        cdc_dev->rx.data_ready = CDC_ACM_SEM_BINARY_CREATE(cdc_dev, rx_data_ready);
+        cdc_dev->rx.mux = CDC_ACM_MUTEX_CREATE(cdc_dev, rx_mux);
+        ESP_GOTO_ON_FALSE(cdc_dev->rx.data_ready && cdc_dev->rx.mux, ESP_ERR_NO_MEM, err, TAG,);
+        return ESP_OK;
+    }
+
+    cdc_dev->rx.task_done = CDC_ACM_SEM_BINARY_CREATE(cdc_dev, rx_task_done);
+    ESP_GOTO_ON_FALSE(cdc_dev->rx.task_done, ESP_ERR_NO_MEM, err, TAG,);
+    cdc_dev->rx.task_exit = false;
+#if CONFIG_CDC_ACM_STATIC_POOL && (CONFIG_CDC_ACM_STATIC_POOL_RX_RING_SIZE > 0)
+    cdc_dev->rx.task = xTaskCreateStaticPinnedToCore(
+                           cdc_acm_rx_task, "CDC_RX", CDC_ACM_RX_TASK_STACK_SIZE, (void *)cdc_dev,
+                           dev_config->rx_task_priority, cdc_dev->static_buf.rx_task_stack, &cdc_dev->static_buf.rx_task, dev_config->rx_task_core_id);
+    const BaseType_t task_created = cdc_dev->rx.task ? pdTRUE : pdFALSE;
+#elif CONFIG_CDC_ACM_STATIC_POOL
+    const BaseType_t task_created = pdFALSE; // Not reached, the pool has no RX ring
+#else
+    BaseType_t task_created = xTaskCreatePinnedToCore(
+                                  cdc_acm_rx_task, "CDC_RX", CDC_ACM_RX_TASK_STACK_SIZE, (void *)cdc_dev,
+                                  dev_config->rx_task_priority, &cdc_dev->rx.task, dev_config->rx_task_core_id);
+#endif
+    ESP_GOTO_ON_FALSE(task_created == pdTRUE, ESP_ERR_NO_MEM, err, TAG, "Could not create RX task");
+    return ESP_OK;
+
+err:
+    cdc_dev->rx.task = NULL;
+    cdc_acm_rx_stop(cdc_dev);
+    return ret;
 }
 
+
 /**
  * @brief CDC-ACM driver handling task
  *
@@ -227,9 +705,8 @@ static esp_err_t cdc_acm_start(cdc_dev_t *cdc_dev, cdc_acm_host_dev_callback_t e
             cdc_dev->data.intf_desc->bInterfaceNumber,
             cdc_dev->data.intf_desc->bAlternateSetting),
         err, TAG, "Could not claim interface");
-    if (cdc_dev->data.in_xfer) {
-        ESP_LOGD(TAG, "Submitting poll for BULK IN transfer");
-        ESP_ERROR_CHECK(usb_host_transfer_submit(cdc_dev->data.in_xfer));
+    if (cdc_dev->data.in_xfer_num) {
+        ESP_ERROR_CHECK(cdc_acm_in_xfers_submit(cdc_dev));
     }
 
     // If notification are supported, claim its interface and start polling its IN endpoint
@@ -247,10 +724,6 @@ static esp_err_t cdc_acm_start(cdc_dev_t *cdc_dev, cdc_acm_host_dev_callback_t e
         ESP_ERROR_CHECK(usb_host_transfer_submit(cdc_dev->notif.xfer));
     }
 
-    // Everything OK, add the device into list and return
-    CDC_ACM_ENTER_CRITICAL();
-    SLIST_INSERT_HEAD(&p_cdc_acm_obj->cdc_devices_list, cdc_dev, list_entry);
-    CDC_ACM_EXIT_CRITICAL();
     return ret;
 
 err:
@@ -261,108 +734,529 @@ err:
     return ret;
 }
 
-static void cdc_acm_transfers_free(cdc_dev_t *cdc_dev);
 /**
- * @brief Helper function that releases resources claimed by CDC device
- *
- * Close underlying USB device, free device driver memory
+ * @brief Get hash index entry of USB device
  *
- * @note All interfaces claimed by this device must be release before calling this function
- * @param cdc_dev CDC device handle to be removed
+ * @note Must be called from CDC-ACM critical section
+ * @param[in] dev_hdl USB device handle
+ * @return Index of the entry of dev_hdl, or of the free entry where it can be inserted
  */
-static void cdc_acm_device_remove(cdc_dev_t *cdc_dev)
+static int cdc_acm_usb_dev_find(usb_device_handle_t dev_hdl)
 {
-    assert(cdc_dev);
-    cdc_acm_transfers_free(cdc_dev);
-    free(cdc_dev->cdc_func_desc);
-    // We don't check the error code of usb_host_device_close, as the close might fail, if someone else is still using the device (not all interfaces are released)
-    usb_host_device_close(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl); // Gracefully continue on error
-    free(cdc_dev);
+    int i = ((uint32_t)((uintptr_t)dev_hdl >> 2) * 2654435761U) >> (32 - CDC_ACM_USB_DEV_INDEX_BITS);
+    while (p_cdc_acm_obj->usb_devs[i].dev_hdl && p_cdc_acm_obj->usb_devs[i].dev_hdl != dev_hdl) {
+        i = (i + 1) & CDC_ACM_USB_DEV_INDEX_MASK;
+    }
+    return i;
 }
 
 /**
- * @brief Open USB device with requested VID/PID
+ * @brief Remove hash index entry of USB device
  *
- * This function has two regular return paths:
- * 1. USB device with matching VID/PID is already opened by this driver: allocate new CDC device on top of the already opened USB device.
- * 2. USB device with matching VID/PID is NOT opened by this driver yet: poll USB connected devices until it is found.
+ * Following entries are shifted back, so lookups do not need tombstones.
  *
- * @note This function will block for timeout_ms, if the device is not enumerated at the moment of calling this function.
- * @param[in] vid Vendor ID
- * @param[in] pid Product ID
- * @param[in] timeout_ms Connection timeout [ms]
- * @param[out] dev CDC-ACM device
- * @return esp_err_t
+ * @note Must be called from CDC-ACM critical section
+ * @param[in] i Index of the entry
  */
-static esp_err_t cdc_acm_find_and_open_usb_device(uint16_t vid, uint16_t pid, int timeout_ms, cdc_dev_t **dev)
+static void cdc_acm_usb_dev_remove(int i)
 {
-    assert(p_cdc_acm_obj);
-    assert(dev);
-
-    *dev = calloc(1, sizeof(cdc_dev_t));
-    if (*dev == NULL) {
-        return ESP_ERR_NO_MEM;
-    }
-
-    // First, check list of already opened CDC devices
-    ESP_LOGD(TAG, "Checking list of opened USB devices");
-    cdc_dev_t *cdc_dev;
-    SLIST_FOREACH(cdc_dev, &p_cdc_acm_obj->cdc_devices_list, list_entry) {
-        const usb_device_desc_t *device_desc;
-        ESP_ERROR_CHECK(usb_host_get_device_descriptor(cdc_dev->dev_hdl, &device_desc));
-        if ((vid == device_desc->idVendor || vid == CDC_HOST_ANY_VID) &&
-                (pid == device_desc->idProduct || pid == CDC_HOST_ANY_PID)) {
-            // Return path 1:
-            (*dev)->dev_hdl = cdc_dev->dev_hdl;
-            return ESP_OK;
+    int j = i;
+    while (true) {
+        j = (j + 1) & CDC_ACM_USB_DEV_INDEX_MASK;
+        if (!p_cdc_acm_obj->usb_devs[j].dev_hdl) {
+            break;
+        }
+        const int home = ((uint32_t)((uintptr_t)p_cdc_acm_obj->usb_devs[j].dev_hdl >> 2) * 2654435761U) >> (32 - CDC_ACM_USB_DEV_INDEX_BITS);
+        // Entry j can fill the hole if the hole lies between its home and j
+        if (((j - home) & CDC_ACM_USB_DEV_INDEX_MASK) >= ((j - i) & CDC_ACM_USB_DEV_INDEX_MASK)) {
+            p_cdc_acm_obj->usb_devs[i] = p_cdc_acm_obj->usb_devs[j];
+            i = j;
         }
     }
+    p_cdc_acm_obj->usb_devs[i].dev_hdl = NULL;
+}
 
-    // Second, poll connected devices until new device is connected or timeout
-    TickType_t timeout_ticks = (timeout_ms == 0) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
-    TimeOut_t connection_timeout;
-    vTaskSetTimeOutState(&connection_timeout);
-
-    do {
-        ESP_LOGD(TAG, "Checking list of connected USB devices");
-        uint8_t dev_addr_list[10];
-        int num_of_devices;
-        ESP_ERROR_CHECK(usb_host_device_addr_list_fill(sizeof(dev_addr_list), dev_addr_list, &num_of_devices));
-
-        // Go through device address list and find the one we are looking for
-        for (int i = 0; i < num_of_devices; i++) {
-            usb_device_handle_t current_device;
-            // Open USB device
-            if (usb_host_device_open(p_cdc_acm_obj->cdc_acm_client_hdl, dev_addr_list[i], &current_device) != ESP_OK) {
-                continue; // In case we failed to open this device, continue with next one in the list
-            }
-            assert(current_device);
-            const usb_device_desc_t *device_desc;
-            ESP_ERROR_CHECK(usb_host_get_device_descriptor(current_device, &device_desc));
-            if ((vid == device_desc->idVendor || vid == CDC_HOST_ANY_VID) &&
-                    (pid == device_desc->idProduct || pid == CDC_HOST_ANY_PID)) {
-                // Return path 2:
-                (*dev)->dev_hdl = current_device;
-                return ESP_OK;
-            }
-            usb_host_device_close(p_cdc_acm_obj->cdc_acm_client_hdl, current_device);
+/**
+ * @brief Add CDC device to device table
+ *
+ * @param[in] cdc_dev     CDC device with dev_hdl set
+ * @param[in] device_desc Device descriptor of the USB device
+ * @return
+ *   - ESP_OK: Success, cdc_dev->hdl is set
+ *   - ESP_ERR_NO_MEM: CDC_ACM_DEV_MAX devices are open
+ */
+static esp_err_t cdc_acm_dev_register(cdc_dev_t *cdc_dev, const usb_device_desc_t *device_desc)
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    CDC_ACM_ENTER_CRITICAL();
+    for (int slot = 0; slot < CDC_ACM_DEV_MAX; slot++) {
+        if (p_cdc_acm_obj->slots[slot].dev) {
+            continue;
         }
-        vTaskDelay(pdMS_TO_TICKS(50));
-    } while (xTaskCheckForTimeOut(&connection_timeout, &timeout_ticks) == pdFALSE);
-
-    // Timeout was reached, clean-up
-    free(*dev);
-    *dev = NULL;
-    return ESP_ERR_NOT_FOUND;
+        const int i = cdc_acm_usb_dev_find(cdc_dev->dev_hdl);
+        if (!p_cdc_acm_obj->usb_devs[i].dev_hdl) {
+            p_cdc_acm_obj->usb_devs[i].dev_hdl = cdc_dev->dev_hdl;
+            p_cdc_acm_obj->usb_devs[i].vid = device_desc->idVendor;
+            p_cdc_acm_obj->usb_devs[i].pid = device_desc->idProduct;
+            p_cdc_acm_obj->usb_devs[i].first = CDC_ACM_SLOT_NONE;
+        }
+        p_cdc_acm_obj->slots[slot].dev = cdc_dev;
+        p_cdc_acm_obj->slots[slot].next = p_cdc_acm_obj->usb_devs[i].first;
+        p_cdc_acm_obj->usb_devs[i].first = slot;
+        p_cdc_acm_obj->dev_count++;
+        cdc_dev->hdl = (cdc_acm_dev_hdl_t)(uintptr_t)(((p_cdc_acm_obj->slots[slot].gen & CDC_ACM_HDL_GEN_MASK) << 8) | (slot + 1));
+        ret = ESP_OK;
+        break;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    return ret;
 }
 
-esp_err_t cdc_acm_host_install(const cdc_acm_host_driver_config_t *driver_config)
+/**
+ * @brief Remove CDC device from device table
+ *
+ * Handle of the device becomes stale. Does nothing if the device is not in the table.
+ *
+ * @param[in] cdc_dev CDC device
+ */
+static void cdc_acm_dev_unregister(cdc_dev_t *cdc_dev)
 {
-    CDC_ACM_CHECK(!p_cdc_acm_obj, ESP_ERR_INVALID_STATE);
-
-    // Check driver configuration, use default if NULL is passed
-    if (driver_config == NULL) {
-        driver_config = &cdc_acm_driver_config_default;
+    if (!cdc_dev->hdl) {
+        return;
+    }
+    const int slot = (int)((uintptr_t)cdc_dev->hdl & 0xFF) - 1;
+    CDC_ACM_ENTER_CRITICAL();
+    const int i = cdc_acm_usb_dev_find(cdc_dev->dev_hdl);
+    assert(p_cdc_acm_obj->usb_devs[i].dev_hdl);
+    int8_t *link = &p_cdc_acm_obj->usb_devs[i].first;
+    while (*link != slot) {
+        link = &p_cdc_acm_obj->slots[*link].next;
+    }
+    *link = p_cdc_acm_obj->slots[slot].next;
+    if (p_cdc_acm_obj->usb_devs[i].first == CDC_ACM_SLOT_NONE) {
+        cdc_acm_usb_dev_remove(i);
+    }
+    p_cdc_acm_obj->slots[slot].dev = NULL;
+    p_cdc_acm_obj->slots[slot].gen++;
+    p_cdc_acm_obj->dev_count--;
+    CDC_ACM_EXIT_CRITICAL();
+    cdc_dev->hdl = NULL;
+}
+
+/**
+ * @brief Get CDC device from its handle
+ *
+ * @param[in] cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @return CDC device, NULL if the handle is invalid or the device was closed
+ */
+static cdc_dev_t *cdc_acm_dev_get(cdc_acm_dev_hdl_t cdc_hdl)
+{
+    const uintptr_t hdl = (uintptr_t)cdc_hdl;
+    const int slot = (int)(hdl & 0xFF) - 1;
+    if (!p_cdc_acm_obj || slot < 0 || slot >= CDC_ACM_DEV_MAX) {
+        return NULL;
+    }
+    cdc_dev_t *cdc_dev = NULL;
+    CDC_ACM_ENTER_CRITICAL();
+    if ((p_cdc_acm_obj->slots[slot].gen & CDC_ACM_HDL_GEN_MASK) == (hdl >> 8)) {
+        cdc_dev = p_cdc_acm_obj->slots[slot].dev;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    return cdc_dev;
+}
+
+/**
+ * @brief Get handles of CDC devices open on USB device
+ *
+ * The spinlock is held only while the handles are copied. The caller looks up each device with cdc_acm_dev_get(),
+ * so it can call user's callbacks that close the devices.
+ *
+ * @param[in]  dev_hdl USB device handle
+ * @param[out] hdls    Handles of CDC devices
+ * @return Number of handles
+ */
+static int cdc_acm_dev_handles_get(usb_device_handle_t dev_hdl, cdc_acm_dev_hdl_t hdls[CDC_ACM_DEV_MAX])
+{
+    int cnt = 0;
+    CDC_ACM_ENTER_CRITICAL();
+    const int i = cdc_acm_usb_dev_find(dev_hdl);
+    if (p_cdc_acm_obj->usb_devs[i].dev_hdl) {
+        for (int slot = p_cdc_acm_obj->usb_devs[i].first; slot != CDC_ACM_SLOT_NONE; slot = p_cdc_acm_obj->slots[slot].next) {
+            hdls[cnt++] = p_cdc_acm_obj->slots[slot].dev->hdl;
+        }
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    return cnt;
+}
+
+/**
+ * @brief Allocate zeroed CDC device
+ *
+ * With CONFIG_CDC_ACM_STATIC_POOL the device is taken from the static pool.
+ *
+ * @return CDC device, NULL if there is not enough memory or the pool is exhausted
+ */
+static cdc_dev_t *cdc_acm_dev_alloc(void)
+{
+#if CONFIG_CDC_ACM_STATIC_POOL
+    cdc_dev_t *cdc_dev = NULL;
+    CDC_ACM_ENTER_CRITICAL();
+    for (int i = 0; i < CONFIG_CDC_ACM_STATIC_POOL_SIZE; i++) {
+        if (!cdc_acm_pool.used[i]) {
+            cdc_acm_pool.used[i] = true;
+            cdc_dev = &cdc_acm_pool.devs[i];
+            cdc_acm_pool.in_use++;
+            if (cdc_acm_pool.in_use > cdc_acm_pool.high_water) {
+                cdc_acm_pool.high_water = cdc_acm_pool.in_use;
+            }
+            break;
+        }
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    if (cdc_dev) {
+        memset(cdc_dev, 0, sizeof(cdc_dev_t));
+    } else {
+        ESP_LOGW(TAG, "Static device pool exhausted");
+    }
+    return cdc_dev;
+#else
+    return calloc(1, sizeof(cdc_dev_t));
+#endif
+}
+
+/**
+ * @brief Free CDC device allocated by cdc_acm_dev_alloc()
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_dev_free(cdc_dev_t *cdc_dev)
+{
+#if CONFIG_CDC_ACM_STATIC_POOL
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_acm_pool.used[cdc_dev - cdc_acm_pool.devs] = false;
+    cdc_acm_pool.in_use--;
+    CDC_ACM_EXIT_CRITICAL();
+#else
+    free(cdc_dev);
+#endif
+}
+
+/**
+ * @brief Allocate USB transfer for CDC device
+ *
+ * With CONFIG_CDC_ACM_STATIC_POOL a transfer of the same size kept by the pool slot is reused.
+ *
+ * @param[in]  cdc_dev Pointer to CDC device
+ * @param[in]  size    Size of data buffer
+ * @param[out] xfer    Allocated transfer
+ * @return esp_err_t
+ */
+static esp_err_t cdc_acm_xfer_alloc(cdc_dev_t *cdc_dev, size_t size, usb_transfer_t **xfer)
+{
+#if CONFIG_CDC_ACM_STATIC_POOL
+    cdc_pool_xfer_t *kept = cdc_acm_pool.xfers[cdc_dev - cdc_acm_pool.devs];
+    cdc_pool_xfer_t *entry = NULL;
+    for (int i = 0; i < CDC_ACM_POOL_XFER_NUM; i++) {
+        if (kept[i].xfer && !kept[i].in_use && kept[i].size == size) {
+            kept[i].in_use = true;
+            *xfer = kept[i].xfer;
+            return ESP_OK;
+        }
+        if (!kept[i].xfer) {
+            entry = &kept[i];
+        }
+    }
+    if (!entry) {
+        // All entries hold transfers; replace a kept transfer of different size
+        for (int i = 0; i < CDC_ACM_POOL_XFER_NUM; i++) {
+            if (!kept[i].in_use) {
+                entry = &kept[i];
+                usb_host_transfer_free(entry->xfer);
+                entry->xfer = NULL;
+                break;
+            }
+        }
+    }
+    assert(entry);
+    esp_err_t ret = usb_host_transfer_alloc(size, 0, xfer);
+    if (ret == ESP_OK) {
+        entry->xfer = *xfer;
+        entry->size = size;
+        entry->in_use = true;
+    }
+    return ret;
+#else
+    return usb_host_transfer_alloc(size, 0, xfer);
+#endif
+}
+
+/**
+ * @brief Free USB transfer allocated by cdc_acm_xfer_alloc()
+ *
+ * With CONFIG_CDC_ACM_STATIC_POOL the transfer is kept by the pool slot.
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ * @param[in] xfer    Transfer to be freed
+ */
+static void cdc_acm_xfer_free(cdc_dev_t *cdc_dev, usb_transfer_t *xfer)
+{
+#if CONFIG_CDC_ACM_STATIC_POOL
+    cdc_pool_xfer_t *kept = cdc_acm_pool.xfers[cdc_dev - cdc_acm_pool.devs];
+    for (int i = 0; i < CDC_ACM_POOL_XFER_NUM; i++) {
+        if (kept[i].xfer == xfer) {
+            // Restore defaults of usb_host_transfer_alloc(), the next device sets only some of the fields
+            xfer->num_bytes = 0;
+            xfer->actual_num_bytes = 0;
+            xfer->flags = 0;
+            xfer->device_handle = NULL;
+            xfer->bEndpointAddress = 0;
+            xfer->timeout_ms = 0;
+            xfer->callback = NULL;
+            xfer->context = NULL;
+            kept[i].in_use = false;
+            return;
+        }
+    }
+#endif
+    usb_host_transfer_free(xfer);
+}
+
+#if CONFIG_CDC_ACM_STATIC_POOL
+/**
+ * @brief Free USB transfers kept by the static pool
+ *
+ * @note All devices must be closed
+ */
+static void cdc_acm_pool_xfers_free(void)
+{
+    for (int slot = 0; slot < CONFIG_CDC_ACM_STATIC_POOL_SIZE; slot++) {
+        for (int i = 0; i < CDC_ACM_POOL_XFER_NUM; i++) {
+            cdc_pool_xfer_t *entry = &cdc_acm_pool.xfers[slot][i];
+            if (entry->xfer) {
+                assert(!entry->in_use);
+                usb_host_transfer_free(entry->xfer);
+                entry->xfer = NULL;
+            }
+        }
+    }
+}
+#endif
+
+static void cdc_acm_transfers_free(cdc_dev_t *cdc_dev);
+static esp_err_t cdc_acm_tx_coalesce_start(cdc_dev_t *cdc_dev, const cdc_acm_host_device_config_t *dev_config);
+static void cdc_acm_tx_coalesce_stop(cdc_dev_t *cdc_dev);
+static esp_err_t cdc_acm_tx_task_start(cdc_dev_t *cdc_dev, const cdc_acm_host_device_config_t *dev_config);
+static void cdc_acm_tx_task_stop(cdc_dev_t *cdc_dev);
+static void cdc_acm_out_xfer_release(cdc_dev_t *cdc_dev, int idx);
+/**
+ * @brief Helper function that releases resources claimed by CDC device
+ *
+ * Close underlying USB device, free device driver memory
+ *
+ * @note All interfaces claimed by this device must be release before calling this function
+ * @param cdc_dev CDC device handle to be removed
+ */
+static void cdc_acm_device_remove(cdc_dev_t *cdc_dev)
+{
+    assert(cdc_dev);
+    cdc_acm_dev_unregister(cdc_dev);
+    cdc_acm_rx_stop(cdc_dev);
+    cdc_acm_tx_task_stop(cdc_dev);
+    cdc_acm_tx_coalesce_stop(cdc_dev);
+    cdc_acm_transfers_free(cdc_dev);
+    // We don't check the error code of usb_host_device_close, as the close might fail, if someone else is still using the device (not all interfaces are released)
+    usb_host_device_close(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl); // Gracefully continue on error
+    cdc_acm_dev_free(cdc_dev);
+}
+
+/**
+ * @brief Check VID and PID of USB device
+ *
+ * @param[in] device_desc Device descriptor
+ * @param[in] vid         Requested VID, can be CDC_HOST_ANY_VID
+ * @param[in] pid         Requested PID, can be CDC_HOST_ANY_PID
+ * @return true if the device matches
+ */
+static bool cdc_acm_usb_id_match(const usb_device_desc_t *device_desc, uint16_t vid, uint16_t pid)
+{
+    return (vid == device_desc->idVendor || vid == CDC_HOST_ANY_VID) &&
+           (pid == device_desc->idProduct || pid == CDC_HOST_ANY_PID);
+}
+
+/**
+ * @brief Check serial number of USB device
+ *
+ * String descriptors are UTF-16LE, the requested serial number is compared as ASCII.
+ *
+ * @param[in] str_desc Serial number string descriptor, can be NULL
+ * @param[in] serial   Requested serial number, NULL for any
+ * @return true if the device matches
+ */
+static bool cdc_acm_usb_serial_match(const usb_str_desc_t *str_desc, const char *serial)
+{
+    if (serial == NULL) {
+        return true;
+    }
+    if (str_desc == NULL) {
+        return false;
+    }
+    const size_t len = (str_desc->bLength - USB_STANDARD_DESC_SIZE) / 2;
+    size_t i = 0;
+    for (; i < len && serial[i]; i++) {
+        if (str_desc->wData[i] != (uint8_t)serial[i]) {
+            return false;
+        }
+    }
+    return (i == len) && (serial[i] == '\0');
+}
+
+/**
+ * @brief Check VID, PID and serial number of USB device
+ *
+ * @param[in] dev_hdl USB device handle
+ * @param[in] vid     Requested VID, can be CDC_HOST_ANY_VID
+ * @param[in] pid     Requested PID, can be CDC_HOST_ANY_PID
+ * @param[in] serial  Requested serial number, NULL for any
+ * @return true if the device matches
+ */
+static bool cdc_acm_usb_device_match(usb_device_handle_t dev_hdl, uint16_t vid, uint16_t pid, const char *serial)
+{
+    const usb_device_desc_t *device_desc;
+    ESP_ERROR_CHECK(usb_host_get_device_descriptor(dev_hdl, &device_desc));
+    if (!cdc_acm_usb_id_match(device_desc, vid, pid)) {
+        return false;
+    }
+    if (serial == NULL) {
+        return true;
+    }
+    usb_device_info_t dev_info;
+    return (usb_host_device_info(dev_hdl, &dev_info) == ESP_OK) && cdc_acm_usb_serial_match(dev_info.str_desc_serial_num, serial);
+}
+
+/**
+ * @brief Open USB device with requested VID/PID and serial number
+ *
+ * This function has two regular return paths:
+ * 1. USB device with matching VID/PID is already opened by this driver: allocate new CDC device on top of the already opened USB device.
+ * 2. USB device with matching VID/PID is NOT opened by this driver yet: open it from the list of connected devices,
+ *    or wait until usb_event_cb() hands it over right after its enumeration.
+ *
+ * @note This function will block for timeout_ms, if the device is not enumerated at the moment of calling this function.
+ * @param[in] vid Vendor ID
+ * @param[in] pid Product ID
+ * @param[in] serial Serial number, NULL for any
+ * @param[in] timeout_ms Connection timeout [ms]
+ * @param[out] dev CDC-ACM device
+ * @return esp_err_t
+ */
+static esp_err_t cdc_acm_find_and_open_usb_device(uint16_t vid, uint16_t pid, const char *serial, int timeout_ms, cdc_dev_t **dev)
+{
+    assert(p_cdc_acm_obj);
+    assert(dev);
+
+    *dev = cdc_acm_dev_alloc();
+    if (*dev == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // First, check USB devices of already opened CDC devices
+    // They stay open while we hold open_close_mutex, so their serial numbers can be checked outside of the critical section
+    ESP_LOGD(TAG, "Checking list of opened USB devices");
+    usb_device_handle_t opened_devs[CDC_ACM_USB_DEV_INDEX_SIZE];
+    int opened_cnt = 0;
+    CDC_ACM_ENTER_CRITICAL();
+    for (int i = 0; i < CDC_ACM_USB_DEV_INDEX_SIZE; i++) {
+        if (p_cdc_acm_obj->usb_devs[i].dev_hdl &&
+                (vid == p_cdc_acm_obj->usb_devs[i].vid || vid == CDC_HOST_ANY_VID) &&
+                (pid == p_cdc_acm_obj->usb_devs[i].pid || pid == CDC_HOST_ANY_PID)) {
+            opened_devs[opened_cnt++] = p_cdc_acm_obj->usb_devs[i].dev_hdl;
+        }
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    for (int i = 0; i < opened_cnt; i++) {
+        usb_device_info_t dev_info;
+        if (serial == NULL ||
+                (usb_host_device_info(opened_devs[i], &dev_info) == ESP_OK && cdc_acm_usb_serial_match(dev_info.str_desc_serial_num, serial))) {
+            (*dev)->dev_hdl = opened_devs[i];
+            break;
+        }
+    }
+    if ((*dev)->dev_hdl) {
+        // Return path 1:
+        return ESP_OK;
+    }
+
+    // Second, wait for new devices before checking the connected ones, so a device connected meanwhile is not missed
+    CDC_ACM_ENTER_CRITICAL();
+    p_cdc_acm_obj->open_wait.vid = vid;
+    p_cdc_acm_obj->open_wait.pid = pid;
+    p_cdc_acm_obj->open_wait.serial = serial;
+    p_cdc_acm_obj->open_wait.dev_hdl = NULL;
+    p_cdc_acm_obj->open_wait.waiting = true;
+    CDC_ACM_EXIT_CRITICAL();
+
+    // Third, check devices that are already connected
+    usb_device_handle_t found_dev = NULL;
+    ESP_LOGD(TAG, "Checking list of connected USB devices");
+    uint8_t dev_addr_list[10];
+    int num_of_devices;
+    ESP_ERROR_CHECK(usb_host_device_addr_list_fill(sizeof(dev_addr_list), dev_addr_list, &num_of_devices));
+
+    // Go through device address list and find the one we are looking for
+    for (int i = 0; i < num_of_devices; i++) {
+        usb_device_handle_t current_device;
+        // Open USB device
+        if (usb_host_device_open(p_cdc_acm_obj->cdc_acm_client_hdl, dev_addr_list[i], &current_device) != ESP_OK) {
+            continue; // In case we failed to open this device, continue with next one in the list
+        }
+        assert(current_device);
+        if (cdc_acm_usb_device_match(current_device, vid, pid, serial)) {
+            found_dev = current_device;
+            break;
+        }
+        usb_host_device_close(p_cdc_acm_obj->cdc_acm_client_hdl, current_device);
+    }
+
+    // Fourth, wait until usb_event_cb() hands over a matching new device or timeout
+    if (!found_dev) {
+        ESP_LOGD(TAG, "Waiting for new USB device");
+        xSemaphoreTake(p_cdc_acm_obj->open_wait.found, (timeout_ms == 0) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms));
+    }
+    CDC_ACM_ENTER_CRITICAL();
+    p_cdc_acm_obj->open_wait.waiting = false;
+    p_cdc_acm_obj->open_wait.serial = NULL;
+    usb_device_handle_t new_dev = p_cdc_acm_obj->open_wait.dev_hdl;
+    p_cdc_acm_obj->open_wait.dev_hdl = NULL;
+    CDC_ACM_EXIT_CRITICAL();
+    xSemaphoreTake(p_cdc_acm_obj->open_wait.found, 0); // The device could be handed over after the wait ended
+
+    if (new_dev) {
+        if (found_dev) {
+            // The same or another matching device was connected during the check, we need only one
+            usb_host_device_close(p_cdc_acm_obj->cdc_acm_client_hdl, new_dev);
+        } else {
+            found_dev = new_dev;
+        }
+    }
+    if (found_dev) {
+        // Return path 2:
+        (*dev)->dev_hdl = found_dev;
+        return ESP_OK;
+    }
+
+    // Timeout was reached, clean-up
+    cdc_acm_dev_free(*dev);
+    *dev = NULL;
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t cdc_acm_host_install(const cdc_acm_host_driver_config_t *driver_config)
+{
+    CDC_ACM_CHECK(!p_cdc_acm_obj, ESP_ERR_INVALID_STATE);
+
+    // Check driver configuration, use default if NULL is passed
+    if (driver_config == NULL) {
+        driver_config = &cdc_acm_driver_config_default;
     }
 
     // Allocate all we need for this driver
@@ -370,12 +1264,13 @@ esp_err_t cdc_acm_host_install(const cdc_acm_host_driver_config_t *driver_config
     cdc_acm_obj_t *cdc_acm_obj = heap_caps_calloc(1, sizeof(cdc_acm_obj_t), MALLOC_CAP_DEFAULT);
     EventGroupHandle_t event_group = xEventGroupCreate();
     SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+    SemaphoreHandle_t open_found = xSemaphoreCreateBinary();
     TaskHandle_t driver_task_h = NULL;
     xTaskCreatePinnedToCore(
         cdc_acm_client_task, "USB-CDC", driver_config->driver_task_stack_size, NULL,
         driver_config->driver_task_priority, &driver_task_h, driver_config->xCoreID);
 
-    if (cdc_acm_obj == NULL || driver_task_h == NULL || event_group == NULL || mutex == NULL) {
+    if (cdc_acm_obj == NULL || driver_task_h == NULL || event_group == NULL || mutex == NULL || open_found == NULL) {
         ret = ESP_ERR_NO_MEM;
         goto err;
     }
@@ -391,11 +1286,12 @@ esp_err_t cdc_acm_host_install(const cdc_acm_host_driver_config_t *driver_config
     ESP_GOTO_ON_ERROR(usb_host_client_register(&client_config, &usb_client), err, TAG, "Failed to register USB host client");
 
     // Initialize CDC-ACM driver structure
-    SLIST_INIT(&(cdc_acm_obj->cdc_devices_list));
     cdc_acm_obj->event_group = event_group;
     cdc_acm_obj->open_close_mutex = mutex;
+    cdc_acm_obj->open_wait.found = open_found;
     cdc_acm_obj->cdc_acm_client_hdl = usb_client;
     cdc_acm_obj->new_dev_cb = driver_config->new_dev_cb;
+    cdc_acm_obj->driver_task = driver_task_h;
 
     // Between 1st call of this function and following section, another task might try to install this driver:
     // Make sure that there is only one instance of this driver in the system
@@ -407,6 +1303,9 @@ esp_err_t cdc_acm_host_install(const cdc_acm_host_driver_config_t *driver_config
         goto client_err;
     } else {
         p_cdc_acm_obj = cdc_acm_obj;
+#if CONFIG_CDC_ACM_STATIC_POOL
+        cdc_acm_pool.high_water = cdc_acm_pool.in_use;
+#endif
     }
     CDC_ACM_EXIT_CRITICAL();
 
@@ -427,6 +1326,9 @@ err: // Clean-up
     if (mutex) {
         vSemaphoreDelete(mutex);
     }
+    if (open_found) {
+        vSemaphoreDelete(open_found);
+    }
     return ret;
 }
 
@@ -442,7 +1344,7 @@ esp_err_t cdc_acm_host_uninstall()
     xSemaphoreTake(p_cdc_acm_obj->open_close_mutex, portMAX_DELAY); // Wait for all open/close calls to finish
 
     CDC_ACM_ENTER_CRITICAL();
-    if (SLIST_EMPTY(&p_cdc_acm_obj->cdc_devices_list)) { // Check that device list is empty (all devices closed)
+    if (p_cdc_acm_obj->dev_count == 0) { // Check that all devices are closed
         p_cdc_acm_obj = NULL; // NULL static driver pointer: No open/close calls form this point
     } else {
         ret = ESP_ERR_INVALID_STATE;
@@ -462,7 +1364,12 @@ esp_err_t cdc_acm_host_uninstall()
     vEventGroupDelete(cdc_acm_obj->event_group);
     xSemaphoreGive(cdc_acm_obj->open_close_mutex);
     vSemaphoreDelete(cdc_acm_obj->open_close_mutex);
+    vSemaphoreDelete(cdc_acm_obj->open_wait.found);
     free(cdc_acm_obj);
+    cdc_parse_cache_clear();
+#if CONFIG_CDC_ACM_STATIC_POOL
+    cdc_acm_pool_xfers_free();
+#endif
     return ESP_OK;
 
 unblock:
@@ -488,29 +1395,44 @@ static void cdc_acm_transfers_free(cdc_dev_t *cdc_dev)
 {
     assert(cdc_dev);
     if (cdc_dev->notif.xfer != NULL) {
-        usb_host_transfer_free(cdc_dev->notif.xfer);
+        cdc_acm_xfer_free(cdc_dev, cdc_dev->notif.xfer);
     }
-    if (cdc_dev->data.in_xfer != NULL) {
-        cdc_acm_reset_in_transfer(cdc_dev);
-        usb_host_transfer_free(cdc_dev->data.in_xfer);
+    for (int i = 0; i < cdc_dev->data.in_xfer_num; i++) {
+        if (cdc_dev->data.in_xfer[i] != NULL) {
+            cdc_acm_reset_in_transfer(cdc_dev, cdc_dev->data.in_xfer[i]);
+            cdc_acm_xfer_free(cdc_dev, cdc_dev->data.in_xfer[i]);
+        }
     }
-    if (cdc_dev->data.out_xfer != NULL) {
-        if (cdc_dev->data.out_xfer->context != NULL) {
-            vSemaphoreDelete((SemaphoreHandle_t)cdc_dev->data.out_xfer->context);
+    for (int i = 0; i < cdc_dev->data.in_xfer_spare_num; i++) {
+        if (cdc_dev->data.in_xfer_spare[i] != NULL) {
+            cdc_acm_xfer_free(cdc_dev, cdc_dev->data.in_xfer_spare[i]);
         }
-        if (cdc_dev->data.out_mux != NULL) {
-            vSemaphoreDelete(cdc_dev->data.out_mux);
+    }
+    for (int i = 0; i < cdc_dev->data.out_xfer_num; i++) {
+        if (cdc_dev->data.out_xfer[i] != NULL) {
+            cdc_acm_xfer_free(cdc_dev, cdc_dev->data.out_xfer[i]);
         }
-        usb_host_transfer_free(cdc_dev->data.out_xfer);
+    }
+    if (cdc_dev->data.out_free != NULL) {
+        vSemaphoreDelete(cdc_dev->data.out_free);
+    }
+    if (cdc_dev->data.out_done != NULL) {
+        vSemaphoreDelete(cdc_dev->data.out_done);
+    }
+    if (cdc_dev->data.out_mux != NULL) {
+        vSemaphoreDelete(cdc_dev->data.out_mux);
     }
     if (cdc_dev->ctrl_transfer != NULL) {
-        if (cdc_dev->ctrl_transfer->context != NULL) {
-            vSemaphoreDelete((SemaphoreHandle_t)cdc_dev->ctrl_transfer->context);
+        if (cdc_dev->ctrl_done != NULL) {
+            vSemaphoreDelete(cdc_dev->ctrl_done);
         }
         if (cdc_dev->ctrl_mux != NULL) {
             vSemaphoreDelete(cdc_dev->ctrl_mux);
         }
-        usb_host_transfer_free(cdc_dev->ctrl_transfer);
+        if (cdc_dev->ctrl_async.queue != NULL) {
+            vQueueDelete(cdc_dev->ctrl_async.queue);
+        }
+        cdc_acm_xfer_free(cdc_dev, cdc_dev->ctrl_transfer);
     }
 }
 
@@ -521,14 +1443,17 @@ static void cdc_acm_transfers_free(cdc_dev_t *cdc_dev)
  * @param[in] notif_ep_desc Pointer to notification EP descriptor
  * @param[in] in_ep_desc-   Pointer to data IN EP descriptor
  * @param[in] in_buf_len    Length of data IN buffer
+ * @param[in] in_xfer_num   Number of data IN transfers
+ * @param[in] in_spare_num  Number of spare data IN transfers, that can be held by the user
  * @param[in] out_ep_desc   Pointer to data OUT EP descriptor
  * @param[in] out_buf_len   Length of data OUT buffer
+ * @param[in] out_xfer_num  Number of data OUT transfers
  * @return
  *     - ESP_OK:            Success
  *     - ESP_ERR_NO_MEM:    Not enough memory for transfers and semaphores allocation
  *     - ESP_ERR_NOT_FOUND: IN or OUT endpoints were not found in the selected interface
  */
-static esp_err_t cdc_acm_transfers_allocate(cdc_dev_t *cdc_dev, const usb_ep_desc_t *notif_ep_desc, const usb_ep_desc_t *in_ep_desc, size_t in_buf_len, const usb_ep_desc_t *out_ep_desc, size_t out_buf_len)
+static esp_err_t cdc_acm_transfers_allocate(cdc_dev_t *cdc_dev, const usb_ep_desc_t *notif_ep_desc, const usb_ep_desc_t *in_ep_desc, size_t in_buf_len, uint8_t in_xfer_num, uint8_t in_spare_num, const usb_ep_desc_t *out_ep_desc, size_t out_buf_len, uint8_t out_xfer_num)
 {
     assert(in_ep_desc);
     assert(out_ep_desc);
@@ -537,7 +1462,7 @@ static esp_err_t cdc_acm_transfers_allocate(cdc_dev_t *cdc_dev, const usb_ep_des
     // 1. Setup notification transfer if it is supported
     if (notif_ep_desc) {
         ESP_GOTO_ON_ERROR(
-            usb_host_transfer_alloc(USB_EP_DESC_GET_MPS(notif_ep_desc), 0, &cdc_dev->notif.xfer),
+            cdc_acm_xfer_alloc(cdc_dev, USB_EP_DESC_GET_MPS(notif_ep_desc), &cdc_dev->notif.xfer),
             err, TAG,);
         cdc_dev->notif.xfer->device_handle = cdc_dev->dev_hdl;
         cdc_dev->notif.xfer->bEndpointAddress = notif_ep_desc->bEndpointAddress;
@@ -546,49 +1471,86 @@ static esp_err_t cdc_acm_transfers_allocate(cdc_dev_t *cdc_dev, const usb_ep_des
         cdc_dev->notif.xfer->num_bytes = USB_EP_DESC_GET_MPS(notif_ep_desc);
     }
 
-    // 2. Setup control transfer
+    // 2. Setup control transfer, with one spare byte to detect encapsulated responses longer than ctrl_buffer_size
     ESP_GOTO_ON_ERROR(
-        usb_host_transfer_alloc(CDC_ACM_CTRL_TRANSFER_SIZE, 0, &cdc_dev->ctrl_transfer),
+        cdc_acm_xfer_alloc(cdc_dev, sizeof(usb_setup_packet_t) + cdc_dev->ctrl_buffer_size + 1, &cdc_dev->ctrl_transfer),
         err, TAG,);
     cdc_dev->ctrl_transfer->timeout_ms = 1000;
     cdc_dev->ctrl_transfer->bEndpointAddress = 0;
     cdc_dev->ctrl_transfer->device_handle = cdc_dev->dev_hdl;
-    cdc_dev->ctrl_transfer->callback = out_xfer_cb;
-    cdc_dev->ctrl_transfer->context = xSemaphoreCreateBinary();
-    ESP_GOTO_ON_FALSE(cdc_dev->ctrl_transfer->context, ESP_ERR_NO_MEM, err, TAG,);
-    cdc_dev->ctrl_mux = xSemaphoreCreateMutex();
+    cdc_dev->ctrl_transfer->callback = ctrl_xfer_cb;
+    cdc_dev->ctrl_transfer->context = cdc_dev;
+    cdc_dev->ctrl_done = CDC_ACM_SEM_BINARY_CREATE(cdc_dev, ctrl_done);
+    ESP_GOTO_ON_FALSE(cdc_dev->ctrl_done, ESP_ERR_NO_MEM, err, TAG,);
+    cdc_dev->ctrl_mux = CDC_ACM_SEM_BINARY_CREATE(cdc_dev, ctrl_mux);
     ESP_GOTO_ON_FALSE(cdc_dev->ctrl_mux, ESP_ERR_NO_MEM, err, TAG,);
+    xSemaphoreGive(cdc_dev->ctrl_mux);
+    cdc_dev->ctrl_async.queue = CDC_ACM_CTRL_QUEUE_CREATE(cdc_dev);
+    ESP_GOTO_ON_FALSE(cdc_dev->ctrl_async.queue, ESP_ERR_NO_MEM, err, TAG,);
 
-    // 3. Setup IN data transfer (if it is required (in_buf_len > 0))
+    // 3. Setup IN data transfers (if they are required (in_buf_len > 0))
     if (in_buf_len != 0) {
-        ESP_GOTO_ON_ERROR(
-            usb_host_transfer_alloc(in_buf_len, 0, &cdc_dev->data.in_xfer),
-            err, TAG,
-        );
-        assert(cdc_dev->data.in_xfer);
-        cdc_dev->data.in_xfer->callback = in_xfer_cb;
-        cdc_dev->data.in_xfer->num_bytes = in_buf_len;
-        cdc_dev->data.in_xfer->bEndpointAddress = in_ep_desc->bEndpointAddress;
-        cdc_dev->data.in_xfer->device_handle = cdc_dev->dev_hdl;
-        cdc_dev->data.in_xfer->context = cdc_dev;
         cdc_dev->data.in_mps = USB_EP_DESC_GET_MPS(in_ep_desc);
-        cdc_dev->data.in_data_buffer_base = cdc_dev->data.in_xfer->data_buffer;
+        for (int i = 0; i < in_xfer_num; i++) {
+            usb_transfer_t *in_xfer;
+            ESP_GOTO_ON_ERROR(
+                cdc_acm_xfer_alloc(cdc_dev, in_buf_len, &in_xfer),
+                err, TAG,
+            );
+            assert(in_xfer);
+            cdc_dev->data.in_xfer[i] = in_xfer;
+            cdc_dev->data.in_xfer_num = i + 1;
+            in_xfer->callback = in_xfer_cb;
+            in_xfer->num_bytes = in_buf_len;
+            in_xfer->bEndpointAddress = in_ep_desc->bEndpointAddress;
+            in_xfer->device_handle = cdc_dev->dev_hdl;
+            in_xfer->context = cdc_dev;
+        }
+        cdc_dev->data.in_data_buffer_base = cdc_dev->data.in_xfer[0]->data_buffer;
+        cdc_dev->data.in_xfer_idle = (1U << in_xfer_num) - 1;
+
+        for (int i = 0; i < in_spare_num; i++) {
+            usb_transfer_t *in_xfer;
+            ESP_GOTO_ON_ERROR(
+                cdc_acm_xfer_alloc(cdc_dev, in_buf_len, &in_xfer),
+                err, TAG,
+            );
+            assert(in_xfer);
+            cdc_dev->data.in_xfer_spare[i] = in_xfer;
+            cdc_dev->data.in_xfer_spare_num = i + 1;
+            in_xfer->callback = in_xfer_cb;
+            in_xfer->num_bytes = in_buf_len;
+            in_xfer->bEndpointAddress = in_ep_desc->bEndpointAddress;
+            in_xfer->device_handle = cdc_dev->dev_hdl;
+            in_xfer->context = cdc_dev;
+        }
     }
 
-    // 4. Setup OUT bulk transfer (if it is required (out_buf_len > 0))
+    // 4. Setup OUT bulk transfers (if they are required (out_buf_len > 0))
     if (out_buf_len != 0) {
-        ESP_GOTO_ON_ERROR(
-            usb_host_transfer_alloc(out_buf_len, 0, &cdc_dev->data.out_xfer),
-            err, TAG,
-        );
-        assert(cdc_dev->data.out_xfer);
-        cdc_dev->data.out_xfer->device_handle = cdc_dev->dev_hdl;
-        cdc_dev->data.out_xfer->context = xSemaphoreCreateBinary();
-        ESP_GOTO_ON_FALSE(cdc_dev->data.out_xfer->context, ESP_ERR_NO_MEM, err, TAG,);
-        cdc_dev->data.out_mux = xSemaphoreCreateMutex();
+        cdc_dev->data.out_mps = USB_EP_DESC_GET_MPS(out_ep_desc);
+        for (int i = 0; i < out_xfer_num; i++) {
+            usb_transfer_t *out_xfer;
+            ESP_GOTO_ON_ERROR(
+                cdc_acm_xfer_alloc(cdc_dev, out_buf_len, &out_xfer),
+                err, TAG,
+            );
+            assert(out_xfer);
+            cdc_dev->data.out_xfer[i] = out_xfer;
+            cdc_dev->data.out_xfer_num = i + 1;
+            cdc_dev->data.out_ctx[i].cdc_dev = cdc_dev;
+            out_xfer->device_handle = cdc_dev->dev_hdl;
+            out_xfer->context = &cdc_dev->data.out_ctx[i];
+            out_xfer->bEndpointAddress = out_ep_desc->bEndpointAddress;
+            out_xfer->callback = out_xfer_cb;
+        }
+        cdc_dev->data.out_xfer_idle = (1U << out_xfer_num) - 1;
+        cdc_dev->data.out_free = CDC_ACM_SEM_COUNTING_CREATE(cdc_dev, out_free, out_xfer_num, out_xfer_num);
+        ESP_GOTO_ON_FALSE(cdc_dev->data.out_free, ESP_ERR_NO_MEM, err, TAG,);
+        cdc_dev->data.out_done = CDC_ACM_SEM_COUNTING_CREATE(cdc_dev, out_done, out_xfer_num, 0);
+        ESP_GOTO_ON_FALSE(cdc_dev->data.out_done, ESP_ERR_NO_MEM, err, TAG,);
+        cdc_dev->data.out_mux = CDC_ACM_MUTEX_CREATE(cdc_dev, out_mux);
         ESP_GOTO_ON_FALSE(cdc_dev->data.out_mux, ESP_ERR_NO_MEM, err, TAG,);
-        cdc_dev->data.out_xfer->bEndpointAddress = out_ep_desc->bEndpointAddress;
-        cdc_dev->data.out_xfer->callback = out_xfer_cb;
     }
     return ESP_OK;
 
@@ -603,11 +1565,22 @@ esp_err_t cdc_acm_host_open(uint16_t vid, uint16_t pid, uint8_t interface_idx, c
     CDC_ACM_CHECK(p_cdc_acm_obj, ESP_ERR_INVALID_STATE);
     CDC_ACM_CHECK(dev_config, ESP_ERR_INVALID_ARG);
     CDC_ACM_CHECK(cdc_hdl_ret, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(dev_config->in_transfer_count <= CDC_ACM_IN_XFER_NUM_MAX, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(dev_config->rx_loan_count <= CDC_ACM_IN_XFER_NUM_MAX, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(dev_config->out_transfer_count <= CDC_ACM_OUT_XFER_NUM_MAX, ESP_ERR_INVALID_ARG);
+    // Flow control without RX ring keeps refused data in the IN buffer, which is only possible with one IN transfer
+    CDC_ACM_CHECK(!(dev_config->in_transfer_count > 1 && dev_config->rx_ring_size == 0 && dev_config->rx_high_water != 0), ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(dev_config->ctrl_buffer_size < UINT16_MAX, ESP_ERR_INVALID_ARG); // wLength of encapsulated response is one byte longer
+#if CONFIG_CDC_ACM_STATIC_POOL
+    // RX ring and TX queue of a pooled device use storage reserved in the pool
+    CDC_ACM_CHECK(dev_config->rx_ring_size <= CONFIG_CDC_ACM_STATIC_POOL_RX_RING_SIZE, ESP_ERR_NOT_SUPPORTED);
+    CDC_ACM_CHECK(dev_config->tx_queue_len <= CONFIG_CDC_ACM_STATIC_POOL_TX_QUEUE_LEN, ESP_ERR_NOT_SUPPORTED);
+#endif
 
     xSemaphoreTake(p_cdc_acm_obj->open_close_mutex, portMAX_DELAY);
     // Find underlying USB device
     cdc_dev_t *cdc_dev;
-    ret =  cdc_acm_find_and_open_usb_device(vid, pid, dev_config->connection_timeout_ms, &cdc_dev);
+    ret =  cdc_acm_find_and_open_usb_device(vid, pid, dev_config->serial_number, dev_config->connection_timeout_ms, &cdc_dev);
     if (ESP_OK != ret) {
         goto exit;
     }
@@ -617,11 +1590,12 @@ esp_err_t cdc_acm_host_open(uint16_t vid, uint16_t pid, uint8_t interface_idx, c
     const usb_device_desc_t *device_desc;
     ESP_ERROR_CHECK(usb_host_get_device_descriptor(cdc_dev->dev_hdl, &device_desc));
     ESP_ERROR_CHECK(usb_host_get_active_config_descriptor(cdc_dev->dev_hdl, &config_desc));
+    ESP_GOTO_ON_ERROR(cdc_acm_dev_register(cdc_dev, device_desc), err, TAG, "Too many open CDC devices");
 
     // Parse the required interface descriptor
     cdc_parsed_info_t cdc_info;
     ESP_GOTO_ON_ERROR(
-        cdc_parse_interface_descriptor(device_desc, config_desc, interface_idx, &cdc_info),
+        cdc_parse_interface_descriptor_cached(device_desc, config_desc, interface_idx, &cdc_info),
         err, TAG, "Could not open required interface as CDC");
 
     // Save all members of cdc_dev
@@ -631,19 +1605,56 @@ esp_err_t cdc_acm_host_open(uint16_t vid, uint16_t pid, uint8_t interface_idx, c
     if (cdc_info.notif_intf) {
         cdc_dev->comm_protocol = (cdc_comm_protocol_t)cdc_dev->notif.intf_desc->bInterfaceProtocol;
     }
-    cdc_dev->cdc_func_desc = cdc_info.func;
+    cdc_dev->config_desc = config_desc;
     cdc_dev->cdc_func_desc_cnt = cdc_info.func_cnt;
+    memcpy(cdc_dev->cdc_func_desc, cdc_info.func, cdc_info.func_cnt * sizeof(cdc_func_desc_t));
+    for (int i = cdc_info.func_cnt - 1; i >= 0; i--) {
+        // Iterate backwards, so the first descriptor of each subtype is found
+        if (cdc_info.func[i].subtype < USB_CDC_DESC_SUBTYPE_MAX) {
+            cdc_dev->cdc_func_desc_idx[cdc_info.func[i].subtype] = i + 1;
+        }
+    }
 
     // The following line is here for backward compatibility with v1.0.*
     // where fixed size of IN buffer (equal to IN Maximum Packet Size) was used
     const size_t in_buf_size = (dev_config->data_cb && (dev_config->in_buffer_size == 0)) ? USB_EP_DESC_GET_MPS(cdc_info.in_ep) : dev_config->in_buffer_size;
+    const uint8_t in_xfer_num = (dev_config->in_transfer_count == 0) ? 1 : dev_config->in_transfer_count;
+    const uint8_t out_xfer_num = (dev_config->out_transfer_count == 0) ? 1 : dev_config->out_transfer_count;
+
+    cdc_dev->ctrl_buffer_size = (dev_config->ctrl_buffer_size < CDC_ACM_ENCAP_MAX_SIZE) ? CDC_ACM_ENCAP_MAX_SIZE : dev_config->ctrl_buffer_size;
 
     // Allocate USB transfers, claim CDC interfaces and return CDC-ACM handle
     ESP_GOTO_ON_ERROR(
-        cdc_acm_transfers_allocate(cdc_dev, cdc_info.notif_ep, cdc_info.in_ep, in_buf_size, cdc_info.out_ep, dev_config->out_buffer_size),
+        cdc_acm_transfers_allocate(cdc_dev, cdc_info.notif_ep, cdc_info.in_ep, in_buf_size, in_xfer_num, dev_config->rx_loan_count, cdc_info.out_ep, dev_config->out_buffer_size, out_xfer_num),
         err, TAG,);
+    cdc_dev->data.in_flow_control = (dev_config->rx_high_water != 0);
+    if (cdc_dev->data.in_xfer_num) {
+        cdc_dev->data.in_xfer_size_max = cdc_dev->data.in_xfer[0]->num_bytes - cdc_dev->data.in_xfer[0]->num_bytes % cdc_dev->data.in_mps;
+        cdc_dev->data.in_adaptive = dev_config->in_adaptive_size;
+        // Adaptive size starts with Maximum Packet Size
+        cdc_dev->data.in_xfer_size = cdc_dev->data.in_adaptive ? cdc_dev->data.in_mps : cdc_dev->data.in_xfer_size_max;
+        cdc_dev->stats.in_xfer_size = cdc_dev->data.in_xfer_size;
+        for (int i = 0; i < cdc_dev->data.in_xfer_num; i++) {
+            cdc_acm_reset_in_transfer(cdc_dev, cdc_dev->data.in_xfer[i]);
+        }
+    }
+    if (dev_config->rx_ring_size && cdc_dev->data.in_xfer_num) {
+        ESP_GOTO_ON_ERROR(cdc_acm_rx_start(cdc_dev, dev_config), err, TAG,);
+    }
+    if (dev_config->tx_coalesce_ms && cdc_dev->data.out_xfer_num) {
+        ESP_GOTO_ON_ERROR(cdc_acm_tx_coalesce_start(cdc_dev, dev_config), err, TAG,);
+    }
+    if (dev_config->tx_pacing && cdc_dev->data.out_xfer_num) {
+        cdc_dev->tx_pace.enabled = true;
+        cdc_dev->tx_pace.fifo_size = (dev_config->tx_pacing_fifo_size == 0) ? cdc_dev->data.out_mps : dev_config->tx_pacing_fifo_size;
+        cdc_dev->tx_pace.backlog_tick = xTaskGetTickCount();
+    }
+    if (dev_config->tx_queue_len && cdc_dev->data.out_xfer_num) {
+        ESP_GOTO_ON_ERROR(cdc_acm_tx_task_start(cdc_dev, dev_config), err, TAG,);
+    }
+    cdc_dev->notif.encap_response_cb = dev_config->encap_response_cb;
     ESP_GOTO_ON_ERROR(cdc_acm_start(cdc_dev, dev_config->event_cb, dev_config->data_cb, dev_config->user_arg), err, TAG,);
-    *cdc_hdl_ret = (cdc_acm_dev_hdl_t)cdc_dev;
+    *cdc_hdl_ret = cdc_dev->hdl;
     xSemaphoreGive(p_cdc_acm_obj->open_close_mutex);
     return ESP_OK;
 
@@ -662,36 +1673,51 @@ esp_err_t cdc_acm_host_close(cdc_acm_dev_hdl_t cdc_hdl)
 
     xSemaphoreTake(p_cdc_acm_obj->open_close_mutex, portMAX_DELAY);
 
-    // Make sure that the device is in the devices list (that it is not already closed)
-    cdc_dev_t *cdc_dev;
-    bool device_found = false;
-    CDC_ACM_ENTER_CRITICAL();
-    SLIST_FOREACH(cdc_dev, &p_cdc_acm_obj->cdc_devices_list, list_entry) {
-        if (cdc_dev == (cdc_dev_t *)cdc_hdl) {
-            device_found = true;
-            break;
-        }
-    }
-
-    // Device was not found in the cdc_devices_list; it was already closed, return OK
-    if (!device_found) {
-        CDC_ACM_EXIT_CRITICAL();
+    // Device was not found in the device table; it was already closed, return OK
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    if (!cdc_dev) {
         xSemaphoreGive(p_cdc_acm_obj->open_close_mutex);
         return ESP_OK;
     }
 
     // No user callbacks from this point
+    CDC_ACM_ENTER_CRITICAL();
     cdc_dev->notif.cb = NULL;
+    cdc_dev->notif.encap_response_cb = NULL;
     cdc_dev->data.in_cb = NULL;
+    for (int i = 0; i < cdc_dev->data.out_xfer_num; i++) {
+        cdc_dev->data.out_ctx[i].done_cb = NULL;
+        cdc_dev->data.out_ctx[i].tx_seq = 0;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+
+    // Queued CTRL requests, queued data, pending coalesced data and acquired OUT buffer are dropped
+    cdc_acm_ctrl_async_stop(cdc_dev);
+    cdc_acm_tx_task_stop(cdc_dev);
+    cdc_acm_tx_coalesce_stop(cdc_dev);
+    CDC_ACM_ENTER_CRITICAL();
+    usb_transfer_t *acquired = cdc_dev->data.out_acquired;
+    cdc_dev->data.out_acquired = NULL;
+    CDC_ACM_EXIT_CRITICAL();
+    if (acquired) {
+        cdc_acm_out_xfer_release(cdc_dev, (cdc_out_xfer_ctx_t *)acquired->context - cdc_dev->data.out_ctx);
+    }
+    CDC_ACM_ENTER_CRITICAL();
+    const bool out_in_flight = (cdc_dev->data.out_xfer_idle != (1U << cdc_dev->data.out_xfer_num) - 1);
     CDC_ACM_EXIT_CRITICAL();
 
     // Cancel polling of BULK IN and INTERRUPT IN
-    if (cdc_dev->data.in_xfer) {
-        ESP_ERROR_CHECK(cdc_acm_reset_transfer_endpoint(cdc_dev->dev_hdl, cdc_dev->data.in_xfer));
+    if (cdc_dev->data.in_xfer_num) {
+        // Resetting the endpoint cancels all in-flight IN transfers
+        ESP_ERROR_CHECK(cdc_acm_reset_transfer_endpoint(cdc_dev->dev_hdl, cdc_dev->data.in_xfer[0]));
     }
     if (cdc_dev->notif.xfer != NULL) {
         ESP_ERROR_CHECK(cdc_acm_reset_transfer_endpoint(cdc_dev->dev_hdl, cdc_dev->notif.xfer));
     }
+    if (out_in_flight) {
+        // Resetting the endpoint cancels all in-flight OUT transfers
+        ESP_ERROR_CHECK(cdc_acm_reset_transfer_endpoint(cdc_dev->dev_hdl, cdc_dev->data.out_xfer[0]));
+    }
 
     // Release all interfaces
     ESP_ERROR_CHECK(usb_host_interface_release(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl, cdc_dev->data.intf_desc->bInterfaceNumber));
@@ -699,10 +1725,6 @@ esp_err_t cdc_acm_host_close(cdc_acm_dev_hdl_t cdc_hdl)
         ESP_ERROR_CHECK(usb_host_interface_release(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl, cdc_dev->notif.intf_desc->bInterfaceNumber));
     }
 
-    CDC_ACM_ENTER_CRITICAL();
-    SLIST_REMOVE(&p_cdc_acm_obj->cdc_devices_list, cdc_dev, cdc_dev_s, list_entry);
-    CDC_ACM_EXIT_CRITICAL();
-
     cdc_acm_device_remove(cdc_dev);
     xSemaphoreGive(p_cdc_acm_obj->open_close_mutex);
     return ESP_OK;
@@ -710,8 +1732,8 @@ esp_err_t cdc_acm_host_close(cdc_acm_dev_hdl_t cdc_hdl)
 
 void cdc_acm_host_desc_print(cdc_acm_dev_hdl_t cdc_hdl)
 {
-    assert(cdc_hdl);
-    cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    assert(cdc_dev);
 
     const usb_device_desc_t *device_desc;
     const usb_config_desc_t *config_desc;
@@ -722,10 +1744,37 @@ void cdc_acm_host_desc_print(cdc_acm_dev_hdl_t cdc_hdl)
 }
 
 /**
- * @brief Check finished transfer status
+ * @brief Count failed transfer in device statistics
  *
- * Return to on transfer completed OK.
- * Cancel the transfer and issue user's callback in case of an error.
+ * @param[in] cdc_dev Pointer to CDC device
+ * @param[in] status  Status of the failed transfer
+ */
+static void cdc_acm_stats_count_error(cdc_dev_t *cdc_dev, usb_transfer_status_t status)
+{
+    CDC_ACM_ENTER_CRITICAL();
+    switch (status) {
+    case USB_TRANSFER_STATUS_COMPLETED:
+    case USB_TRANSFER_STATUS_NO_DEVICE:
+    case USB_TRANSFER_STATUS_CANCELED:
+        break;
+    case USB_TRANSFER_STATUS_STALL:
+        cdc_dev->stats.xfer_stalls++;
+        break;
+    case USB_TRANSFER_STATUS_TIMED_OUT:
+        cdc_dev->stats.xfer_timeouts++;
+        break;
+    default:
+        cdc_dev->stats.xfer_errors++;
+        break;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+}
+
+/**
+ * @brief Check finished transfer status
+ *
+ * Return to on transfer completed OK.
+ * Cancel the transfer and issue user's callback in case of an error.
  *
  * @param[in] transfer Transfer to be checked
  * @return true Transfer completed
@@ -750,6 +1799,7 @@ static bool cdc_acm_is_transfer_completed(usb_transfer_t *transfer)
     case USB_TRANSFER_STATUS_SKIPPED:
     default:
         // Transfer was not completed or cancelled by user. Inform user about this
+        cdc_acm_stats_count_error(cdc_dev, transfer->status);
         if (cdc_dev->notif.cb) {
             const cdc_acm_host_dev_event_data_t error_event = {
                 .type = CDC_ACM_HOST_ERROR,
@@ -767,17 +1817,62 @@ static void in_xfer_cb(usb_transfer_t *transfer)
     cdc_dev_t *cdc_dev = (cdc_dev_t *)transfer->context;
 
     if (!cdc_acm_is_transfer_completed(transfer)) {
+        // Transfer is not resubmitted, keep it marked as idle
+        cdc_acm_in_xfer_set_idle(cdc_dev, transfer);
         return;
     }
 
-    if (cdc_dev->data.in_cb) {
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_dev->stats.rx_bytes += transfer->actual_num_bytes;
+    cdc_dev->stats.rx_transfers++;
+    if (transfer->actual_num_bytes < transfer->num_bytes) {
+        cdc_dev->stats.rx_short_transfers++;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+
+    if (cdc_dev->data.in_adaptive) {
+        cdc_acm_in_xfer_size_adapt(cdc_dev, transfer);
+    }
+
+    if (cdc_dev->rx.ring.buf) {
+        // Deferred RX processing: only copy the data, they are processed by the RX task or by cdc_acm_host_data_rx()
+        const size_t written = cdc_rx_ring_write(&cdc_dev->rx.ring, transfer->data_buffer, transfer->actual_num_bytes);
+        if (written < transfer->actual_num_bytes) {
+            ESP_LOGW(TAG, "RX ring overflow");
+            cdc_acm_rx_overrun_notify(cdc_dev);
+        }
+        if (cdc_dev->rx.high_water && cdc_rx_ring_used(&cdc_dev->rx.ring) >= cdc_dev->rx.high_water) {
+            ESP_LOGD(TAG, "RX ring above high-water mark, pausing IN polling");
+            CDC_ACM_ENTER_CRITICAL();
+            cdc_dev->data.in_pause |= CDC_ACM_RX_PAUSE_FLOW;
+            CDC_ACM_EXIT_CRITICAL();
+            // The consumer might have drained the ring in the meantime
+            cdc_acm_rx_ring_drained(cdc_dev);
+        }
+        if (cdc_dev->rx.task) {
+            xTaskNotifyGive(cdc_dev->rx.task);
+        } else {
+            xSemaphoreGive(cdc_dev->rx.data_ready);
+        }
+        cdc_acm_reset_in_transfer(cdc_dev, transfer);
+    } else if (cdc_dev->data.in_cb) {
+        cdc_dev->data.in_xfer_current = transfer;
         const bool data_processed = cdc_dev->data.in_cb(transfer->data_buffer, transfer->actual_num_bytes, cdc_dev->cb_arg);
+        cdc_dev->data.in_xfer_current = NULL;
 
         // Information for developers:
         // In order to save RAM and CPU time, the application can indicate that the received data was not processed and that the application expects more data.
         // In this case, the next received data must be appended to the existing buffer.
         // Since the data_buffer in usb_transfer_t is a constant pointer, we must cast away to const qualifier.
-        if (!data_processed) {
+        if (cdc_dev->data.in_xfer_hold) {
+            // The user keeps this buffer, continue with a spare transfer
+            transfer = cdc_acm_in_xfer_loan(cdc_dev, transfer);
+        } else if (!data_processed && cdc_dev->data.in_xfer_num > 1) {
+            // Other IN transfers are already in flight, the data cannot be appended and are dropped
+            ESP_LOGW(TAG, "RX buffer append is not supported with multiple IN transfers, %d bytes dropped", transfer->actual_num_bytes);
+            cdc_acm_rx_overrun_notify(cdc_dev);
+            cdc_acm_reset_in_transfer(cdc_dev, transfer);
+        } else if (!data_processed) {
 #if !SOC_CACHE_INTERNAL_MEM_VIA_L1CACHE
             // In case the received data was not processed, the next RX data must be appended to current buffer
             uint8_t **ptr = (uint8_t **)(&(transfer->data_buffer));
@@ -788,20 +1883,17 @@ static void in_xfer_cb(usb_transfer_t *transfer)
             uint16_t mps = cdc_dev->data.in_mps;
             transfer->num_bytes = (space_left / mps) * mps; // Round down to MPS for next transfer
 
-            if (transfer->num_bytes == 0) {
+            if (transfer->num_bytes == 0 && cdc_dev->data.in_flow_control) {
+                // The IN buffer cannot accept more data, keep it and stop polling until the user resumes reception
+                ESP_LOGD(TAG, "IN buffer full, pausing IN polling");
+                CDC_ACM_ENTER_CRITICAL();
+                cdc_dev->data.in_pause |= CDC_ACM_RX_PAUSE_USER;
+                CDC_ACM_EXIT_CRITICAL();
+            } else if (transfer->num_bytes == 0) {
                 // The IN buffer cannot accept more data, inform the user and reset the buffer
                 ESP_LOGW(TAG, "IN buffer overflow");
-                cdc_dev->serial_state.bOverRun = true;
-                if (cdc_dev->notif.cb) {
-                    const cdc_acm_host_dev_event_data_t serial_state_event = {
-                        .type = CDC_ACM_HOST_SERIAL_STATE,
-                        .data.serial_state = cdc_dev->serial_state
-                    };
-                    cdc_dev->notif.cb(&serial_state_event, cdc_dev->cb_arg);
-                }
-
-                cdc_acm_reset_in_transfer(cdc_dev);
-                cdc_dev->serial_state.bOverRun = false;
+                cdc_acm_rx_overrun_notify(cdc_dev);
+                cdc_acm_reset_in_transfer(cdc_dev, transfer);
             }
 #else
             // For targets that must sync internal memory through L1CACHE, we cannot change the data_buffer
@@ -809,12 +1901,33 @@ static void in_xfer_cb(usb_transfer_t *transfer)
             ESP_LOGW(TAG, "RX buffer append is not yet supported on ESP32-P4!");
 #endif
         } else {
-            cdc_acm_reset_in_transfer(cdc_dev);
+            cdc_acm_reset_in_transfer(cdc_dev, transfer);
         }
     }
 
-    ESP_LOGD(TAG, "Submitting poll for BULK IN transfer");
-    usb_host_transfer_submit(cdc_dev->data.in_xfer);
+    cdc_acm_in_xfer_set_idle(cdc_dev, transfer);
+    cdc_acm_in_xfers_submit(cdc_dev);
+}
+
+/**
+ * @brief Completion of GET_ENCAPSULATED_RESPONSE request
+ *
+ * The request asks for one byte more than ctrl_buffer_size. If the device fills it, the response was truncated.
+ *
+ * @param[in] user_arg Device whose response was fetched
+ */
+static void encap_response_done_cb(esp_err_t status, const uint8_t *data, size_t data_len, void *user_arg)
+{
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)user_arg;
+    const cdc_acm_ctrl_done_callback_t response_cb = cdc_dev->notif.encap_response_cb;
+    if ((status == ESP_OK) && (data_len > cdc_dev->ctrl_buffer_size)) {
+        ESP_LOGW(TAG, "Encapsulated response does not fit in %d bytes", cdc_dev->ctrl_buffer_size);
+        status = ESP_ERR_INVALID_SIZE;
+        data_len = cdc_dev->ctrl_buffer_size;
+    }
+    if (response_cb) {
+        response_cb(status, data, data_len, cdc_dev->cb_arg);
+    }
 }
 
 static void notif_xfer_cb(usb_transfer_t *transfer)
@@ -823,6 +1936,7 @@ static void notif_xfer_cb(usb_transfer_t *transfer)
     cdc_dev_t *cdc_dev = (cdc_dev_t *)transfer->context;
 
     if (cdc_acm_is_transfer_completed(transfer)) {
+        CDC_ACM_STATS_ADD(cdc_dev, notif_transfers, 1);
         cdc_notification_t *notif = (cdc_notification_t *)transfer->data_buffer;
         switch (notif->bNotificationCode) {
         case USB_CDC_NOTIF_NETWORK_CONNECTION: {
@@ -846,7 +1960,21 @@ static void notif_xfer_cb(usb_transfer_t *transfer)
             }
             break;
         }
-        case USB_CDC_NOTIF_RESPONSE_AVAILABLE: // Encapsulated commands not implemented - fallthrough
+        case USB_CDC_NOTIF_RESPONSE_AVAILABLE: {
+            // The response is fetched from EP0 only now, the device is never polled for it
+            const cdc_acm_ctrl_done_callback_t response_cb = cdc_dev->notif.encap_response_cb;
+            if (response_cb) {
+                const esp_err_t ret = send_cdc_request_async(cdc_dev, true, USB_CDC_REQ_GET_ENCAPSULATED_RESPONSE, NULL, cdc_dev->ctrl_buffer_size + 1, 0,
+                                      encap_response_done_cb, cdc_dev);
+                if (ret != ESP_OK) {
+                    ESP_LOGW(TAG, "Encapsulated response not fetched: %s", esp_err_to_name(ret));
+                    response_cb(ret, NULL, 0, cdc_dev->cb_arg);
+                }
+            } else {
+                ESP_LOGW(TAG, "Encapsulated response available, but there is no response callback");
+            }
+            break;
+        }
         default:
             ESP_LOGW(TAG, "Unsupported notification type 0x%02X", notif->bNotificationCode);
             ESP_LOG_BUFFER_HEX(TAG, transfer->data_buffer, transfer->actual_num_bytes);
@@ -859,46 +1987,130 @@ static void notif_xfer_cb(usb_transfer_t *transfer)
     }
 }
 
+/**
+ * @brief Return OUT transfer to the pool of idle transfers
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ * @param[in] idx     Index of the OUT transfer
+ */
+static void cdc_acm_out_xfer_release(cdc_dev_t *cdc_dev, int idx)
+{
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_dev->data.out_xfer_idle |= (1U << idx);
+    CDC_ACM_EXIT_CRITICAL();
+    xSemaphoreGive(cdc_dev->data.out_free);
+}
+
 static void out_xfer_cb(usb_transfer_t *transfer)
 {
-    ESP_LOGD(TAG, "out/ctrl xfer cb");
+    ESP_LOGD(TAG, "out xfer cb");
+    cdc_out_xfer_ctx_t *ctx = (cdc_out_xfer_ctx_t *)transfer->context;
+    cdc_dev_t *cdc_dev = ctx->cdc_dev;
+    const cdc_acm_tx_done_callback_t done_cb = ctx->done_cb;
+    void *user_arg = ctx->user_arg;
+    const uint32_t tx_seq = ctx->tx_seq;
+    const size_t data_len = transfer->actual_num_bytes;
+    esp_err_t status;
+
+    switch (transfer->status) {
+    case USB_TRANSFER_STATUS_COMPLETED:
+        status = ESP_OK;
+        CDC_ACM_ENTER_CRITICAL();
+        cdc_dev->stats.tx_bytes += data_len;
+        cdc_dev->stats.tx_transfers++;
+        CDC_ACM_EXIT_CRITICAL();
+        break;
+    case USB_TRANSFER_STATUS_NO_DEVICE:
+    case USB_TRANSFER_STATUS_CANCELED:
+        status = ESP_ERR_INVALID_STATE;
+        break;
+    case USB_TRANSFER_STATUS_TIMED_OUT:
+        status = ESP_ERR_TIMEOUT;
+        break;
+    default:
+        status = ESP_ERR_INVALID_RESPONSE;
+        break;
+    }
+    cdc_acm_stats_count_error(cdc_dev, transfer->status);
+
+    // Release the transfer before notifying the user, so that done_cb can submit next data
+    cdc_acm_out_xfer_release(cdc_dev, ctx - cdc_dev->data.out_ctx);
+    if (tx_seq) {
+        cdc_acm_tx_blocking_done(cdc_dev, tx_seq, status, data_len);
+    } else if (done_cb) {
+        done_cb(status, data_len, user_arg);
+    }
+}
+
+static void ctrl_xfer_cb(usb_transfer_t *transfer)
+{
+    ESP_LOGD(TAG, "ctrl xfer cb");
     assert(transfer->context);
-    xSemaphoreGive((SemaphoreHandle_t)transfer->context);
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)transfer->context;
+    xSemaphoreGive(cdc_dev->ctrl_done);
 }
 
 static void usb_event_cb(const usb_host_client_event_msg_t *event_msg, void *arg)
 {
     switch (event_msg->event) {
     case USB_HOST_CLIENT_EVENT_NEW_DEV:
-        // Guard p_cdc_acm_obj->new_dev_cb from concurrent access
+        // Guard p_cdc_acm_obj->new_dev_cb and open_wait from concurrent access
         ESP_LOGD(TAG, "New device connected");
         CDC_ACM_ENTER_CRITICAL();
         cdc_acm_new_dev_callback_t _new_dev_cb = p_cdc_acm_obj->new_dev_cb;
+        const bool open_waiting = p_cdc_acm_obj->open_wait.waiting;
+        const bool open_by_serial = (p_cdc_acm_obj->open_wait.serial != NULL);
         CDC_ACM_EXIT_CRITICAL();
 
-        if (_new_dev_cb) {
+        if (_new_dev_cb || open_waiting) {
             usb_device_handle_t new_dev;
             if (usb_host_device_open(p_cdc_acm_obj->cdc_acm_client_hdl, event_msg->new_dev.address, &new_dev) != ESP_OK) {
                 break;
             }
             assert(new_dev);
-            _new_dev_cb(new_dev);
-            usb_host_device_close(p_cdc_acm_obj->cdc_acm_client_hdl, new_dev);
-        }
+            if (_new_dev_cb) {
+                _new_dev_cb(new_dev);
+            }
 
+            // Hand the device over to waiting cdc_acm_host_open(), it keeps the device open
+            // The request is matched under the spinlock, cdc_acm_host_open() might time out and release its serial number meanwhile
+            bool handed_over = false;
+            if (open_waiting) {
+                const usb_device_desc_t *device_desc;
+                ESP_ERROR_CHECK(usb_host_get_device_descriptor(new_dev, &device_desc));
+                usb_device_info_t dev_info = {0};
+                if (open_by_serial && usb_host_device_info(new_dev, &dev_info) != ESP_OK) {
+                    dev_info.str_desc_serial_num = NULL;
+                }
+                CDC_ACM_ENTER_CRITICAL();
+                if (p_cdc_acm_obj->open_wait.waiting && !p_cdc_acm_obj->open_wait.dev_hdl &&
+                        cdc_acm_usb_id_match(device_desc, p_cdc_acm_obj->open_wait.vid, p_cdc_acm_obj->open_wait.pid) &&
+                        cdc_acm_usb_serial_match(dev_info.str_desc_serial_num, p_cdc_acm_obj->open_wait.serial)) {
+                    p_cdc_acm_obj->open_wait.dev_hdl = new_dev;
+                    handed_over = true;
+                }
+                CDC_ACM_EXIT_CRITICAL();
+            }
+            if (handed_over) {
+                xSemaphoreGive(p_cdc_acm_obj->open_wait.found);
+            } else {
+                usb_host_device_close(p_cdc_acm_obj->cdc_acm_client_hdl, new_dev);
+            }
+        }
         break;
     case USB_HOST_CLIENT_EVENT_DEV_GONE: {
         ESP_LOGD(TAG, "Device suddenly disconnected");
         // Find CDC pseudo-devices associated with this USB device and close them
-        cdc_dev_t *cdc_dev;
-        cdc_dev_t *tcdc_dev;
-        // We are using 'SAFE' version of 'SLIST_FOREACH' which enables user to close the disconnected device in the callback
-        SLIST_FOREACH_SAFE(cdc_dev, &p_cdc_acm_obj->cdc_devices_list, list_entry, tcdc_dev) {
-            if (cdc_dev->dev_hdl == event_msg->dev_gone.dev_hdl && cdc_dev->notif.cb) {
+        // The handles are looked up one by one, which enables user to close the disconnected device in the callback
+        cdc_acm_dev_hdl_t hdls[CDC_ACM_DEV_MAX];
+        const int hdl_cnt = cdc_acm_dev_handles_get(event_msg->dev_gone.dev_hdl, hdls);
+        for (int i = 0; i < hdl_cnt; i++) {
+            cdc_dev_t *cdc_dev = cdc_acm_dev_get(hdls[i]);
+            if (cdc_dev && cdc_dev->notif.cb) {
                 // The suddenly disconnected device was opened by this driver: inform user about this
                 const cdc_acm_host_dev_event_data_t disconn_event = {
                     .type = CDC_ACM_HOST_DEVICE_DISCONNECTED,
-                    .data.cdc_hdl = (cdc_acm_dev_hdl_t) cdc_dev,
+                    .data.cdc_hdl = hdls[i],
                 };
                 cdc_dev->notif.cb(&disconn_event, cdc_dev->cb_arg);
             }
@@ -911,194 +2123,1462 @@ static void usb_event_cb(const usb_host_client_event_msg_t *event_msg, void *arg
     }
 }
 
-esp_err_t cdc_acm_host_data_tx_blocking(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, uint32_t timeout_ms)
+/**
+ * @brief Take an idle OUT transfer from the pool
+ *
+ * @param[in] cdc_dev       Pointer to CDC device
+ * @param[in] ticks_to_wait Timeout for an OUT transfer to become idle
+ * @return Idle OUT transfer, NULL on timeout
+ */
+static usb_transfer_t *cdc_acm_out_xfer_acquire(cdc_dev_t *cdc_dev, TickType_t ticks_to_wait)
 {
-    esp_err_t ret;
-    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
-    cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
-    CDC_ACM_CHECK(data && (data_len > 0), ESP_ERR_INVALID_ARG);
-    CDC_ACM_CHECK(cdc_dev->data.out_xfer, ESP_ERR_NOT_SUPPORTED); // Device was opened as read-only.
-    CDC_ACM_CHECK(data_len <= cdc_dev->data.out_xfer->data_buffer_size, ESP_ERR_INVALID_SIZE);
-
-    // Take OUT mutex and fill the OUT transfer
-    BaseType_t taken = xSemaphoreTake(cdc_dev->data.out_mux, pdMS_TO_TICKS(timeout_ms));
-    if (taken != pdTRUE) {
-        return ESP_ERR_TIMEOUT;
+    if (xSemaphoreTake(cdc_dev->data.out_free, ticks_to_wait) != pdTRUE) {
+        return NULL;
     }
 
-    ESP_LOGD(TAG, "Submitting BULK OUT transfer");
-    SemaphoreHandle_t transfer_finished_semaphore = (SemaphoreHandle_t)cdc_dev->data.out_xfer->context;
-    xSemaphoreTake(transfer_finished_semaphore, 0); // Make sure the semaphore is taken before we submit new transfer
-
-    memcpy(cdc_dev->data.out_xfer->data_buffer, data, data_len);
-    cdc_dev->data.out_xfer->num_bytes = data_len;
-    cdc_dev->data.out_xfer->timeout_ms = timeout_ms;
-    ESP_GOTO_ON_ERROR(usb_host_transfer_submit(cdc_dev->data.out_xfer), unblock, TAG,);
-
-    // Wait for OUT transfer completion
-    taken = xSemaphoreTake(transfer_finished_semaphore, pdMS_TO_TICKS(timeout_ms));
-    if (!taken) {
-        cdc_acm_reset_transfer_endpoint(cdc_dev->dev_hdl, cdc_dev->data.out_xfer); // Resetting the endpoint will cause all in-progress transfers to complete
-        ESP_LOGW(TAG, "TX transfer timeout");
-        ret = ESP_ERR_TIMEOUT;
-        goto unblock;
-    }
+    CDC_ACM_ENTER_CRITICAL();
+    const int idx = __builtin_ctz(cdc_dev->data.out_xfer_idle);
+    cdc_dev->data.out_xfer_idle &= ~(1U << idx);
+    cdc_dev->data.out_ctx[idx].tx_seq = 0; // Only cdc_acm_host_data_tx_iov() tags its transfers
+    CDC_ACM_EXIT_CRITICAL();
+    return cdc_dev->data.out_xfer[idx];
+}
 
-    ESP_GOTO_ON_FALSE(cdc_dev->data.out_xfer->status == USB_TRANSFER_STATUS_COMPLETED, ESP_ERR_INVALID_RESPONSE, unblock, TAG, "Bulk OUT transfer error");
-    ESP_GOTO_ON_FALSE(cdc_dev->data.out_xfer->actual_num_bytes == data_len, ESP_ERR_INVALID_RESPONSE, unblock, TAG, "Incorrect number of bytes transferred");
-    ret = ESP_OK;
+/**
+ * @brief Update TX pacing rate from line coding
+ *
+ * @param[in] cdc_dev     Pointer to CDC device
+ * @param[in] line_coding Line coding of the device
+ */
+static void cdc_acm_tx_pace_rate_set(cdc_dev_t *cdc_dev, const cdc_acm_line_coding_t *line_coding)
+{
+    if (!cdc_dev->tx_pace.enabled) {
+        return;
+    }
+    // Bits per character in tenths: start bit, data bits, parity bit and 1, 1.5 or 2 stop bits
+    const uint32_t stop_bits_x10 = (line_coding->bCharFormat == 0) ? 10 : (line_coding->bCharFormat == 1) ? 15 : 20;
+    const uint32_t data_bits = (line_coding->bDataBits != 0) ? line_coding->bDataBits : 8;
+    const uint32_t char_bits_x10 = 10 + data_bits * 10 + (line_coding->bParityType ? 10 : 0) + stop_bits_x10;
+    const uint32_t rate = (uint32_t)(((uint64_t)line_coding->dwDTERate * 10) / char_bits_x10);
 
-unblock:
-    xSemaphoreGive(cdc_dev->data.out_mux);
-    return ret;
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_dev->tx_pace.rate = rate;
+    CDC_ACM_EXIT_CRITICAL();
 }
 
-esp_err_t cdc_acm_host_line_coding_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_acm_line_coding_t *line_coding)
+/**
+ * @brief Drain TX pacing backlog by the data the device sent since the last update
+ *
+ * @note Must be called from critical section
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_tx_pace_update(cdc_dev_t *cdc_dev)
 {
-    CDC_ACM_CHECK(line_coding, ESP_ERR_INVALID_ARG);
+    const TickType_t now = xTaskGetTickCount();
+    const TickType_t elapsed = now - cdc_dev->tx_pace.backlog_tick;
+    const uint64_t drained = ((uint64_t)elapsed * cdc_dev->tx_pace.rate) / configTICK_RATE_HZ;
+    if (drained >= cdc_dev->tx_pace.backlog) {
+        cdc_dev->tx_pace.backlog = 0;
+        cdc_dev->tx_pace.backlog_tick = now;
+    } else if (drained > 0) {
+        // Remainder of the last tick is kept for the next update
+        cdc_dev->tx_pace.backlog -= drained;
+        cdc_dev->tx_pace.backlog_tick += (TickType_t)((drained * configTICK_RATE_HZ) / cdc_dev->tx_pace.rate);
+    }
+}
 
-    ESP_RETURN_ON_ERROR(
-        send_cdc_request((cdc_dev_t *)cdc_hdl, true, USB_CDC_REQ_GET_LINE_CODING, (uint8_t *)line_coding, sizeof(cdc_acm_line_coding_t), 0),
-        TAG,);
-    ESP_LOGD(TAG, "Line Get: Rate: %"PRIu32", Stop bits: %d, Parity: %d, Databits: %d", line_coding->dwDTERate,
-             line_coding->bCharFormat, line_coding->bParityType, line_coding->bDataBits);
-    return ESP_OK;
+/**
+ * @brief Get delay before data_len bytes can be submitted without overflowing the device's TX FIFO
+ *
+ * @param[in] cdc_dev  Pointer to CDC device
+ * @param[in] data_len Length of data to be submitted
+ * @return Number of ticks to wait, 0 if the data can be submitted now
+ */
+static TickType_t cdc_acm_tx_pace_delay(cdc_dev_t *cdc_dev, size_t data_len)
+{
+    TickType_t delay = 0;
+    CDC_ACM_ENTER_CRITICAL();
+    if (cdc_dev->tx_pace.enabled && cdc_dev->tx_pace.rate) {
+        cdc_acm_tx_pace_update(cdc_dev);
+        // Data longer than the FIFO are submitted once the FIFO is empty
+        const size_t needed = (data_len < cdc_dev->tx_pace.fifo_size) ? data_len : cdc_dev->tx_pace.fifo_size;
+        if (cdc_dev->tx_pace.backlog + needed > cdc_dev->tx_pace.fifo_size) {
+            const uint64_t excess = cdc_dev->tx_pace.backlog + needed - cdc_dev->tx_pace.fifo_size;
+            delay = (TickType_t)((excess * configTICK_RATE_HZ + cdc_dev->tx_pace.rate - 1) / cdc_dev->tx_pace.rate);
+        }
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    return delay;
 }
 
-esp_err_t cdc_acm_host_line_coding_set(cdc_acm_dev_hdl_t cdc_hdl, const cdc_acm_line_coding_t *line_coding)
+/**
+ * @brief Submit OUT transfer filled by the caller
+ *
+ * The transfer is returned to the pool if it cannot be submitted.
+ *
+ * @param[in] cdc_dev  Pointer to CDC device
+ * @param[in] transfer OUT transfer obtained from cdc_acm_out_xfer_acquire()
+ * @param[in] data_len Number of bytes in the transfer buffer
+ * @param[in] last     This is the last transfer of a write, it is terminated by a zero-length packet if data_len is a multiple of MPS
+ * @param[in] done_cb  Completion callback, can be NULL
+ * @param[in] user_arg Argument of done_cb
+ * @return
+ *   - ESP_OK: Transfer was submitted
+ *   - Other: Error returned by usb_host_transfer_submit()
+ */
+static esp_err_t cdc_acm_out_xfer_commit(cdc_dev_t *cdc_dev, usb_transfer_t *transfer, size_t data_len, bool last,
+        cdc_acm_tx_done_callback_t done_cb, void *user_arg)
 {
-    CDC_ACM_CHECK(line_coding, ESP_ERR_INVALID_ARG);
+    cdc_out_xfer_ctx_t *ctx = (cdc_out_xfer_ctx_t *)transfer->context;
+    ctx->done_cb = done_cb;
+    ctx->user_arg = user_arg;
+    transfer->num_bytes = data_len;
+    transfer->flags = last ? USB_TRANSFER_FLAG_ZERO_PACK : 0;
 
-    ESP_RETURN_ON_ERROR(
-        send_cdc_request((cdc_dev_t *)cdc_hdl, false, USB_CDC_REQ_SET_LINE_CODING, (uint8_t *)line_coding, sizeof(cdc_acm_line_coding_t), 0),
-        TAG,);
-    ESP_LOGD(TAG, "Line Set: Rate: %"PRIu32", Stop bits: %d, Parity: %d, Databits: %d", line_coding->dwDTERate,
-             line_coding->bCharFormat, line_coding->bParityType, line_coding->bDataBits);
-    return ESP_OK;
+    ESP_LOGD(TAG, "Submitting BULK OUT transfer");
+    const esp_err_t ret = usb_host_transfer_submit(transfer);
+    if (ret != ESP_OK) {
+        cdc_acm_out_xfer_release(cdc_dev, ctx - cdc_dev->data.out_ctx);
+    } else if (cdc_dev->tx_pace.enabled) {
+        CDC_ACM_ENTER_CRITICAL();
+        if (cdc_dev->tx_pace.rate) {
+            cdc_acm_tx_pace_update(cdc_dev);
+            cdc_dev->tx_pace.backlog += data_len;
+        }
+        CDC_ACM_EXIT_CRITICAL();
+    }
+    return ret;
 }
 
-esp_err_t cdc_acm_host_set_control_line_state(cdc_acm_dev_hdl_t cdc_hdl, bool dtr, bool rts)
+/**
+ * @brief Copy data from scatter-gather list
+ *
+ * @param[inout] iov     Current element of the list, advanced past the copied data
+ * @param[inout] iov_cnt Number of remaining elements
+ * @param[inout] iov_off Offset in the current element
+ * @param[out]   dst     Destination buffer
+ * @param[in]    len     Number of bytes to copy
+ */
+static void cdc_acm_iov_gather(const cdc_iovec_t **iov, int *iov_cnt, size_t *iov_off, uint8_t *dst, size_t len)
 {
-    const uint16_t ctrl_bitmap = (uint16_t)dtr | ((uint16_t)rts << 1);
+    while (len > 0) {
+        const size_t left = (*iov)->iov_len - *iov_off;
+        const size_t copy_len = (len < left) ? len : left;
+        memcpy(dst, (const uint8_t *)(*iov)->iov_base + *iov_off, copy_len);
+        dst += copy_len;
+        len -= copy_len;
+        *iov_off += copy_len;
+        if (*iov_off == (*iov)->iov_len) {
+            (*iov)++;
+            (*iov_cnt)--;
+            *iov_off = 0;
+        }
+    }
+}
 
-    ESP_RETURN_ON_ERROR(
-        send_cdc_request((cdc_dev_t *)cdc_hdl, false, USB_CDC_REQ_SET_CONTROL_LINE_STATE, NULL, 0, ctrl_bitmap),
-        TAG,);
-    ESP_LOGD(TAG, "Control Line Set: DTR: %d, RTS: %d", dtr, rts);
-    return ESP_OK;
+/**
+ * @brief Get maximum length of OUT transfer that is not terminated by a short packet
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ * @return OUT buffer size rounded down to MPS, or the buffer size if it is smaller than MPS
+ */
+static size_t cdc_acm_out_chunk_max(const cdc_dev_t *cdc_dev)
+{
+    const size_t buffer_size = cdc_dev->data.out_xfer[0]->data_buffer_size;
+    return (buffer_size >= cdc_dev->data.out_mps) ? buffer_size - buffer_size % cdc_dev->data.out_mps : buffer_size;
 }
 
-esp_err_t cdc_acm_host_send_break(cdc_acm_dev_hdl_t cdc_hdl, uint16_t duration_ms)
+static void cdc_acm_tx_blocking_done(cdc_dev_t *cdc_dev, uint32_t tx_seq, esp_err_t status, size_t data_len)
 {
-    ESP_RETURN_ON_ERROR(
-        send_cdc_request((cdc_dev_t *)cdc_hdl, false, USB_CDC_REQ_SEND_BREAK, NULL, 0, duration_ms),
-        TAG,);
+    CDC_ACM_ENTER_CRITICAL();
+    const bool current = (tx_seq == cdc_dev->data.out_done_seq);
+    if (current) {
+        if (cdc_dev->data.out_done_status == ESP_OK) {
+            cdc_dev->data.out_done_status = status;
+        }
+        cdc_dev->data.out_done_len += data_len;
+        cdc_dev->data.out_done_cnt++;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    if (current) {
+        xSemaphoreGive(cdc_dev->data.out_done);
+    } else {
+        ESP_LOGD(TAG, "Ignoring completion of timed out blocking TX call");
+    }
+}
 
-    // Block until break is deasserted
-    vTaskDelay(pdMS_TO_TICKS(duration_ms + 1));
-    return ESP_OK;
+esp_err_t cdc_acm_host_data_tx_blocking(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, uint32_t timeout_ms)
+{
+    CDC_ACM_CHECK(data && (data_len > 0), ESP_ERR_INVALID_ARG);
+    const cdc_iovec_t iov = {
+        .iov_base = data,
+        .iov_len = data_len,
+    };
+    return cdc_acm_host_data_tx_iov(cdc_hdl, &iov, 1, timeout_ms);
 }
 
-esp_err_t cdc_acm_host_send_custom_request(cdc_acm_dev_hdl_t cdc_hdl, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength, uint8_t *data)
+esp_err_t cdc_acm_host_data_tx_iov(cdc_acm_dev_hdl_t cdc_hdl, const cdc_iovec_t *iov, int iov_cnt, uint32_t timeout_ms)
 {
+    esp_err_t ret = ESP_OK;
     CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
-    cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
-    if (wLength > 0) {
-        CDC_ACM_CHECK(data, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(iov && (iov_cnt > 0), ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(cdc_dev->data.out_xfer_num, ESP_ERR_NOT_SUPPORTED); // Device was opened as read-only.
+    size_t data_len = 0;
+    for (int i = 0; i < iov_cnt; i++) {
+        CDC_ACM_CHECK(iov[i].iov_base || (iov[i].iov_len == 0), ESP_ERR_INVALID_ARG);
+        data_len += iov[i].iov_len;
     }
-    CDC_ACM_CHECK(cdc_dev->ctrl_transfer->data_buffer_size >= wLength, ESP_ERR_INVALID_SIZE);
-
-    esp_err_t ret;
+    CDC_ACM_CHECK(data_len > 0, ESP_ERR_INVALID_ARG);
 
-    // Take Mutex and fill the CTRL request
-    BaseType_t taken = xSemaphoreTake(cdc_dev->ctrl_mux, pdMS_TO_TICKS(CDC_ACM_CTRL_TIMEOUT_MS));
-    if (!taken) {
+    // Take OUT mutex, blocking calls are not interleaved
+    TimeOut_t timeout;
+    TickType_t ticks_to_wait = pdMS_TO_TICKS(timeout_ms);
+    vTaskSetTimeOutState(&timeout);
+    if (xSemaphoreTake(cdc_dev->data.out_mux, ticks_to_wait) != pdTRUE) {
         return ESP_ERR_TIMEOUT;
     }
-    usb_setup_packet_t *req = (usb_setup_packet_t *)(cdc_dev->ctrl_transfer->data_buffer);
-    uint8_t *start_of_data = (uint8_t *)req + sizeof(usb_setup_packet_t);
-    req->bmRequestType = bmRequestType;
-    req->bRequest = bRequest;
-    req->wValue = wValue;
-    req->wIndex = wIndex;
-    req->wLength = wLength;
 
-    // For IN transfers we must transfer data ownership to CDC driver
-    const bool in_transfer = bmRequestType & USB_BM_REQUEST_TYPE_DIR_IN;
-    if (!in_transfer) {
-        memcpy(start_of_data, data, wLength);
+    // Transfers canceled by previous timed out call could complete after it returned,
+    // they are told apart by sequence number of the call that submitted them
+    CDC_ACM_ENTER_CRITICAL();
+    uint32_t tx_seq = cdc_dev->data.out_done_seq + 1;
+    if (tx_seq == 0) {
+        tx_seq = 1; // 0 marks transfers of other TX functions
     }
+    cdc_dev->data.out_done_seq = tx_seq;
+    cdc_dev->data.out_done_cnt = 0;
+    cdc_dev->data.out_done_status = ESP_OK;
+    cdc_dev->data.out_done_len = 0;
+    CDC_ACM_EXIT_CRITICAL();
+    while (xSemaphoreTake(cdc_dev->data.out_done, 0) == pdTRUE) {}
+
+    // Data are gathered to chunks of whole packets, so the device sees one continuous bulk transfer.
+    // Chunks are pipelined in all OUT transfers
+    const size_t chunk_max = cdc_acm_out_chunk_max(cdc_dev);
+    size_t iov_off = 0;
+    size_t submitted = 0;
+    int xfer_cnt = 0;  // Number of OUT transfers submitted by this call
+    int in_flight = 0;
+    while ((submitted < data_len) || (in_flight > 0)) {
+        if ((submitted < data_len) && (in_flight < cdc_dev->data.out_xfer_num)) {
+            const size_t chunk_len = (data_len - submitted < chunk_max) ? data_len - submitted : chunk_max;
+            const TickType_t pace_delay = cdc_acm_tx_pace_delay(cdc_dev, chunk_len);
+            if (pace_delay > 0) {
+                if ((xTaskCheckForTimeOut(&timeout, &ticks_to_wait) == pdTRUE) || (pace_delay > ticks_to_wait)) {
+                    ret = ESP_ERR_TIMEOUT;
+                    goto cancel;
+                }
+                CDC_ACM_STATS_ADD(cdc_dev, tx_pace_waits, 1);
+                CDC_ACM_STATS_ADD(cdc_dev, tx_pace_wait_ms, pdTICKS_TO_MS(pace_delay));
+                vTaskDelay(pace_delay);
+            }
+            xTaskCheckForTimeOut(&timeout, &ticks_to_wait);
+            usb_transfer_t *transfer = cdc_acm_out_xfer_acquire(cdc_dev, ticks_to_wait);
+            ESP_GOTO_ON_FALSE(transfer, ESP_ERR_TIMEOUT, cancel, TAG, "No idle OUT transfer");
+            cdc_acm_iov_gather(&iov, &iov_cnt, &iov_off, transfer->data_buffer, chunk_len);
+            ((cdc_out_xfer_ctx_t *)transfer->context)->tx_seq = tx_seq;
+            ESP_GOTO_ON_ERROR(
+                cdc_acm_out_xfer_commit(cdc_dev, transfer, chunk_len, submitted + chunk_len == data_len, NULL, NULL),
+                cancel, TAG,);
+            submitted += chunk_len;
+            xfer_cnt++;
+            in_flight++;
+            continue;
+        }
 
-    cdc_dev->ctrl_transfer->num_bytes = wLength + sizeof(usb_setup_packet_t);
-    ESP_GOTO_ON_ERROR(
-        usb_host_transfer_submit_control(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->ctrl_transfer),
-        unblock, TAG, "CTRL transfer failed");
-
-    taken = xSemaphoreTake((SemaphoreHandle_t)cdc_dev->ctrl_transfer->context, pdMS_TO_TICKS(CDC_ACM_CTRL_TIMEOUT_MS));
-    if (!taken) {
-        // Transfer was not finished, error in USB LIB. Reset the endpoint
-        cdc_acm_reset_transfer_endpoint(cdc_dev->dev_hdl, cdc_dev->ctrl_transfer);
-        ret = ESP_ERR_TIMEOUT;
-        goto unblock;
+        // Wait for OUT transfer completion
+        if ((xTaskCheckForTimeOut(&timeout, &ticks_to_wait) == pdTRUE) ||
+                (xSemaphoreTake(cdc_dev->data.out_done, ticks_to_wait) != pdTRUE)) {
+            CDC_ACM_STATS_ADD(cdc_dev, tx_timeouts, 1);
+            ESP_LOGW(TAG, "TX transfer timeout");
+            ret = ESP_ERR_TIMEOUT;
+            goto cancel;
+        }
+        CDC_ACM_ENTER_CRITICAL();
+        in_flight = xfer_cnt - cdc_dev->data.out_done_cnt;
+        CDC_ACM_EXIT_CRITICAL();
     }
 
-    ESP_GOTO_ON_FALSE(cdc_dev->ctrl_transfer->status == USB_TRANSFER_STATUS_COMPLETED, ESP_ERR_INVALID_RESPONSE, unblock, TAG, "Control transfer error");
-    ESP_GOTO_ON_FALSE(cdc_dev->ctrl_transfer->actual_num_bytes == cdc_dev->ctrl_transfer->num_bytes, ESP_ERR_INVALID_RESPONSE, unblock, TAG, "Incorrect number of bytes transferred");
+    ESP_GOTO_ON_FALSE(cdc_dev->data.out_done_status == ESP_OK, ESP_ERR_INVALID_RESPONSE, unblock, TAG, "Bulk OUT transfer error");
+    ESP_GOTO_ON_FALSE(cdc_dev->data.out_done_len == data_len, ESP_ERR_INVALID_RESPONSE, unblock, TAG, "Incorrect number of bytes transferred");
+    goto unblock;
 
-    // For OUT transfers, we must transfer data ownership to user
-    if (in_transfer) {
-        memcpy(data, start_of_data, wLength);
+cancel:
+    CDC_ACM_ENTER_CRITICAL();
+    in_flight = xfer_cnt - cdc_dev->data.out_done_cnt;
+    // OUT transfers taken by other TX functions, resetting the endpoint would cancel them too
+    int other_busy = 0;
+    for (int i = 0; i < cdc_dev->data.out_xfer_num; i++) {
+        if (!(cdc_dev->data.out_xfer_idle & (1U << i)) && (cdc_dev->data.out_ctx[i].tx_seq != tx_seq)) {
+            other_busy++;
+        }
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    if (in_flight > 0) {
+        if (other_busy == 0) {
+            cdc_acm_reset_transfer_endpoint(cdc_dev->dev_hdl, cdc_dev->data.out_xfer[0]); // Resetting the endpoint will cause all in-progress transfers to complete
+        } else {
+            // Transfers of this call are left to complete, their completion is ignored thanks to tx_seq
+            ESP_LOGD(TAG, "Other TX in progress, %d timed out transfers left in flight", in_flight);
+        }
     }
-    ret = ESP_OK;
-
 unblock:
-    xSemaphoreGive(cdc_dev->ctrl_mux);
+    xSemaphoreGive(cdc_dev->data.out_mux);
     return ret;
 }
 
-static esp_err_t send_cdc_request(cdc_dev_t *cdc_dev, bool in_transfer, cdc_request_code_t request, uint8_t *data, uint16_t data_len, uint16_t value)
+esp_err_t cdc_acm_host_data_tx_async(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, cdc_acm_tx_done_callback_t done_cb, void *user_arg)
 {
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
     CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
-    CDC_ACM_CHECK(cdc_dev->notif.intf_desc, ESP_ERR_NOT_SUPPORTED);
+    CDC_ACM_CHECK(data && (data_len > 0), ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(cdc_dev->data.out_xfer_num, ESP_ERR_NOT_SUPPORTED); // Device was opened as read-only.
+    CDC_ACM_CHECK(data_len <= cdc_dev->data.out_xfer[0]->data_buffer_size, ESP_ERR_INVALID_SIZE);
 
-    uint8_t req_type = USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
-    if (in_transfer) {
-        req_type |= USB_BM_REQUEST_TYPE_DIR_IN;
-    } else {
-        req_type |= USB_BM_REQUEST_TYPE_DIR_OUT;
-    }
-    return cdc_acm_host_send_custom_request((cdc_acm_dev_hdl_t) cdc_dev, req_type, request, value, cdc_dev->notif.intf_desc->bInterfaceNumber, data_len, data);
+    usb_transfer_t *transfer = cdc_acm_out_xfer_acquire(cdc_dev, 0);
+    CDC_ACM_CHECK(transfer, ESP_ERR_NO_MEM);
+    memcpy(transfer->data_buffer, data, data_len);
+    return cdc_acm_out_xfer_commit(cdc_dev, transfer, data_len, true, done_cb, user_arg);
 }
 
-esp_err_t cdc_acm_host_protocols_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_comm_protocol_t *comm, cdc_data_protocol_t *data)
+esp_err_t cdc_acm_host_tx_acquire(cdc_acm_dev_hdl_t cdc_hdl, uint8_t **buf, size_t *cap, uint32_t timeout_ms)
 {
     CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
-    cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(buf && cap, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(cdc_dev->data.out_xfer_num, ESP_ERR_NOT_SUPPORTED); // Device was opened as read-only.
+    CDC_ACM_CHECK(cdc_dev->data.out_acquired == NULL, ESP_ERR_INVALID_STATE);
 
-    if (comm != NULL) {
-        *comm = cdc_dev->comm_protocol;
+    usb_transfer_t *transfer = cdc_acm_out_xfer_acquire(cdc_dev, pdMS_TO_TICKS(timeout_ms));
+    CDC_ACM_CHECK(transfer, ESP_ERR_TIMEOUT);
+
+    CDC_ACM_ENTER_CRITICAL();
+    const bool already_acquired = (cdc_dev->data.out_acquired != NULL);
+    if (!already_acquired) {
+        cdc_dev->data.out_acquired = transfer;
     }
-    if (data != NULL) {
-        *data = cdc_dev->data_protocol;
+    CDC_ACM_EXIT_CRITICAL();
+    if (already_acquired) {
+        // Other task acquired a buffer in the meantime
+        cdc_acm_out_xfer_release(cdc_dev, (cdc_out_xfer_ctx_t *)transfer->context - cdc_dev->data.out_ctx);
+        return ESP_ERR_INVALID_STATE;
     }
+
+    *buf = transfer->data_buffer;
+    *cap = transfer->data_buffer_size;
     return ESP_OK;
 }
 
-esp_err_t cdc_acm_host_cdc_desc_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_desc_subtype_t desc_type, const usb_standard_desc_t **desc_out)
+esp_err_t cdc_acm_host_tx_commit(cdc_acm_dev_hdl_t cdc_hdl, size_t len)
 {
     CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
-    CDC_ACM_CHECK(desc_type < USB_CDC_DESC_SUBTYPE_MAX, ESP_ERR_INVALID_ARG);
-    cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
-    esp_err_t ret = ESP_ERR_NOT_FOUND;
-    *desc_out = NULL;
-
-    for (int i = 0; i < cdc_dev->cdc_func_desc_cnt; i++) {
-        const cdc_header_desc_t *_desc = (const cdc_header_desc_t *)((*(cdc_dev->cdc_func_desc))[i]);
-        if (_desc->bDescriptorSubtype == desc_type) {
-            ret = ESP_OK;
-            *desc_out = (const usb_standard_desc_t *)_desc;
-            break;
-        }
-    }
-    return ret;
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+
+    CDC_ACM_ENTER_CRITICAL();
+    usb_transfer_t *transfer = cdc_dev->data.out_acquired;
+    CDC_ACM_CHECK_FROM_CRIT(transfer, ESP_ERR_INVALID_STATE);
+    CDC_ACM_CHECK_FROM_CRIT(len <= transfer->data_buffer_size, ESP_ERR_INVALID_SIZE);
+    cdc_dev->data.out_acquired = NULL;
+    CDC_ACM_EXIT_CRITICAL();
+
+    if (len == 0) {
+        cdc_acm_out_xfer_release(cdc_dev, (cdc_out_xfer_ctx_t *)transfer->context - cdc_dev->data.out_ctx);
+        return ESP_OK;
+    }
+    return cdc_acm_out_xfer_commit(cdc_dev, transfer, len, true, NULL, NULL);
+}
+
+/**
+ * @brief Submit pending coalesced OUT transfer
+ *
+ * @note Must be called with tx_coalesce.mux taken
+ * @param[in] cdc_dev Pointer to CDC device
+ * @return Error returned by usb_host_transfer_submit()
+ */
+static esp_err_t cdc_acm_tx_coalesce_flush(cdc_dev_t *cdc_dev)
+{
+    usb_transfer_t *transfer = cdc_dev->tx_coalesce.pending;
+    if (transfer == NULL) {
+        return ESP_OK;
+    }
+    cdc_dev->tx_coalesce.pending = NULL;
+    xTimerStop(cdc_dev->tx_coalesce.timer, 0);
+
+    const uint32_t latency_ms = pdTICKS_TO_MS(xTaskGetTickCount() - cdc_dev->tx_coalesce.pending_since);
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_dev->stats.tx_coalesce_flushes++;
+    if (latency_ms > cdc_dev->stats.tx_coalesce_latency_max_ms) {
+        cdc_dev->stats.tx_coalesce_latency_max_ms = latency_ms;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    return cdc_acm_out_xfer_commit(cdc_dev, transfer, cdc_dev->tx_coalesce.pending_len, true, NULL, NULL);
+}
+
+/**
+ * @brief Coalescing deadline timer callback
+ *
+ * Runs in the timer service task, so it must not block. If a writer holds the mutex, for example while it waits
+ * for an idle OUT transfer, the timer is re-armed and the deadline is checked again one period later.
+ *
+ * @param[in] timer Timer, its ID is the CDC device
+ */
+static void cdc_acm_tx_coalesce_timer_cb(TimerHandle_t timer)
+{
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)pvTimerGetTimerID(timer);
+    if (xSemaphoreTake(cdc_dev->tx_coalesce.mux, 0) != pdTRUE) {
+        xTimerReset(timer, 0);
+        return;
+    }
+    // The transfer could have been flushed and a new one started while this callback was waiting for the mutex
+    if (cdc_dev->tx_coalesce.pending &&
+            (xTaskGetTickCount() - cdc_dev->tx_coalesce.pending_since >= xTimerGetPeriod(timer))) {
+        cdc_acm_tx_coalesce_flush(cdc_dev);
+    }
+    xSemaphoreGive(cdc_dev->tx_coalesce.mux);
+}
+
+/**
+ * @brief Give semaphore from the timer service task
+ */
+static void cdc_acm_tx_coalesce_sync(void *sem, uint32_t unused)
+{
+    xSemaphoreGive((SemaphoreHandle_t)sem);
+}
+
+static esp_err_t cdc_acm_tx_coalesce_start(cdc_dev_t *cdc_dev, const cdc_acm_host_device_config_t *dev_config)
+{
+    esp_err_t ret;
+    cdc_dev->tx_coalesce.flush_on_delimiter = dev_config->tx_flush_on_delimiter;
+    cdc_dev->tx_coalesce.delimiter = dev_config->tx_delimiter;
+    cdc_dev->tx_coalesce.mux = CDC_ACM_MUTEX_CREATE(cdc_dev, tx_coalesce_mux);
+    ESP_GOTO_ON_FALSE(cdc_dev->tx_coalesce.mux, ESP_ERR_NO_MEM, err, TAG,);
+    cdc_dev->tx_coalesce.sync = CDC_ACM_SEM_BINARY_CREATE(cdc_dev, tx_coalesce_sync);
+    ESP_GOTO_ON_FALSE(cdc_dev->tx_coalesce.sync, ESP_ERR_NO_MEM, err, TAG,);
+    const TickType_t period = pdMS_TO_TICKS(dev_config->tx_coalesce_ms);
+    cdc_dev->tx_coalesce.timer = CDC_ACM_TIMER_CREATE(cdc_dev, tx_coalesce_timer, "CDC-ACM TX", (period > 0) ? period : 1, cdc_acm_tx_coalesce_timer_cb);
+    ESP_GOTO_ON_FALSE(cdc_dev->tx_coalesce.timer, ESP_ERR_NO_MEM, err, TAG,);
+    return ESP_OK;
+
+err:
+    cdc_acm_tx_coalesce_stop(cdc_dev);
+    return ret;
+}
+
+static void cdc_acm_tx_coalesce_stop(cdc_dev_t *cdc_dev)
+{
+    if (cdc_dev->tx_coalesce.timer) {
+        xTimerDelete(cdc_dev->tx_coalesce.timer, portMAX_DELAY);
+        // Timer commands are processed in order, the timer callback cannot run after this function is called
+        xTimerPendFunctionCall(cdc_acm_tx_coalesce_sync, cdc_dev->tx_coalesce.sync, 0, portMAX_DELAY);
+        xSemaphoreTake(cdc_dev->tx_coalesce.sync, portMAX_DELAY);
+        cdc_dev->tx_coalesce.timer = NULL;
+    }
+    if (cdc_dev->tx_coalesce.pending) {
+        cdc_out_xfer_ctx_t *ctx = (cdc_out_xfer_ctx_t *)cdc_dev->tx_coalesce.pending->context;
+        cdc_acm_out_xfer_release(cdc_dev, ctx - cdc_dev->data.out_ctx);
+        cdc_dev->tx_coalesce.pending = NULL;
+    }
+    if (cdc_dev->tx_coalesce.sync) {
+        vSemaphoreDelete(cdc_dev->tx_coalesce.sync);
+        cdc_dev->tx_coalesce.sync = NULL;
+    }
+    if (cdc_dev->tx_coalesce.mux) {
+        vSemaphoreDelete(cdc_dev->tx_coalesce.mux);
+        cdc_dev->tx_coalesce.mux = NULL;
+    }
+}
+
+esp_err_t cdc_acm_host_data_tx_coalesced(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, uint32_t timeout_ms)
+{
+    esp_err_t ret = ESP_OK;
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(data && (data_len > 0), ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(cdc_dev->tx_coalesce.timer, ESP_ERR_NOT_SUPPORTED); // Device was opened without TX coalescing
+
+    TimeOut_t timeout;
+    TickType_t ticks_to_wait = pdMS_TO_TICKS(timeout_ms);
+    vTaskSetTimeOutState(&timeout);
+    if (xSemaphoreTake(cdc_dev->tx_coalesce.mux, ticks_to_wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    CDC_ACM_STATS_ADD(cdc_dev, tx_coalesced_writes, 1);
+
+    const size_t chunk_max = cdc_acm_out_chunk_max(cdc_dev);
+    while (data_len > 0) {
+        if (cdc_dev->tx_coalesce.pending == NULL) {
+            xTaskCheckForTimeOut(&timeout, &ticks_to_wait);
+            usb_transfer_t *transfer = cdc_acm_out_xfer_acquire(cdc_dev, ticks_to_wait);
+            ESP_GOTO_ON_FALSE(transfer, ESP_ERR_TIMEOUT, exit, TAG, "No idle OUT transfer");
+            cdc_dev->tx_coalesce.pending = transfer;
+            cdc_dev->tx_coalesce.pending_len = 0;
+            cdc_dev->tx_coalesce.pending_since = xTaskGetTickCount();
+            xTimerReset(cdc_dev->tx_coalesce.timer, portMAX_DELAY);
+        }
+
+        // Copy up to the end of the transfer buffer, or up to and including the delimiter
+        size_t copy_len = chunk_max - cdc_dev->tx_coalesce.pending_len;
+        copy_len = (data_len < copy_len) ? data_len : copy_len;
+        bool flush = (cdc_dev->tx_coalesce.pending_len + copy_len == chunk_max);
+        if (cdc_dev->tx_coalesce.flush_on_delimiter) {
+            const uint8_t *delimiter = memchr(data, cdc_dev->tx_coalesce.delimiter, copy_len);
+            if (delimiter) {
+                copy_len = delimiter - data + 1;
+                flush = true;
+            }
+        }
+        memcpy(cdc_dev->tx_coalesce.pending->data_buffer + cdc_dev->tx_coalesce.pending_len, data, copy_len);
+        cdc_dev->tx_coalesce.pending_len += copy_len;
+        data += copy_len;
+        data_len -= copy_len;
+
+        if (flush) {
+            ESP_GOTO_ON_ERROR(cdc_acm_tx_coalesce_flush(cdc_dev), exit, TAG,);
+        }
+    }
+
+exit:
+    xSemaphoreGive(cdc_dev->tx_coalesce.mux);
+    return ret;
+}
+
+/**
+ * @brief TX task
+ *
+ * Owns the OUT pipe of devices opened with tx_queue_len. Queued items are sent one by one,
+ * so callers of cdc_acm_host_data_tx_queue() never contend for the OUT transfers.
+ * The task is notified after every queued item and by cdc_acm_tx_task_stop().
+ *
+ * @param[in] arg Pointer to CDC device
+ */
+static void cdc_acm_tx_task(void *arg)
+{
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)arg;
+    cdc_tx_item_t item;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        CDC_ACM_ENTER_CRITICAL();
+        const bool task_exit = cdc_dev->tx.task_exit;
+        CDC_ACM_EXIT_CRITICAL();
+        if (task_exit) {
+            break;
+        }
+
+        while (1) {
+            // Items queued during close are completed by cdc_acm_tx_task_stop(), so the close is not delayed by sending them
+            CDC_ACM_ENTER_CRITICAL();
+            const bool closing = cdc_dev->tx.closing;
+            CDC_ACM_EXIT_CRITICAL();
+            if (closing || (xQueueReceive(cdc_dev->tx.queue, &item, 0) != pdTRUE)) {
+                break;
+            }
+            const esp_err_t ret = cdc_acm_host_data_tx_blocking(cdc_dev->hdl, item.data, item.data_len, CDC_ACM_TX_TASK_TIMEOUT_MS);
+            if (item.done_cb) {
+                item.done_cb(ret, (ret == ESP_OK) ? item.data_len : 0, item.user_arg);
+            }
+        }
+    }
+
+    xSemaphoreGive(cdc_dev->tx.task_done);
+    cdc_acm_task_exit();
+}
+
+static esp_err_t cdc_acm_tx_task_start(cdc_dev_t *cdc_dev, const cdc_acm_host_device_config_t *dev_config)
+{
+    esp_err_t ret;
+    cdc_dev->tx.full_policy = dev_config->tx_queue_full_policy;
+    cdc_dev->tx.task_exit = false;
+    cdc_dev->tx.closing = false;
+    cdc_dev->tx.users = 0;
+#if CONFIG_CDC_ACM_STATIC_POOL && (CONFIG_CDC_ACM_STATIC_POOL_TX_QUEUE_LEN > 0)
+    // tx_queue_len was checked against the pool in cdc_acm_host_open()
+    cdc_dev->tx.queue = xQueueCreateStatic(dev_config->tx_queue_len, sizeof(cdc_tx_item_t), cdc_dev->static_buf.tx_queue_storage, &cdc_dev->static_buf.tx_queue);
+#elif !CONFIG_CDC_ACM_STATIC_POOL
+    cdc_dev->tx.queue = xQueueCreate(dev_config->tx_queue_len, sizeof(cdc_tx_item_t));
+#endif
+    ESP_GOTO_ON_FALSE(cdc_dev->tx.queue, ESP_ERR_NO_MEM, err, TAG,);
+    cdc_dev->tx.task_done = CDC_ACM_SEM_BINARY_CREATE(cdc_dev, tx_task_done);
+    ESP_GOTO_ON_FALSE(cdc_dev->tx.task_done, ESP_ERR_NO_MEM, err, TAG,);
+#if CONFIG_CDC_ACM_STATIC_POOL && (CONFIG_CDC_ACM_STATIC_POOL_TX_QUEUE_LEN > 0)
+    cdc_dev->tx.task = xTaskCreateStaticPinnedToCore(
+                           cdc_acm_tx_task, "CDC_TX", CDC_ACM_TX_TASK_STACK_SIZE, (void *)cdc_dev,
+                           dev_config->tx_task_priority, cdc_dev->static_buf.tx_task_stack, &cdc_dev->static_buf.tx_task, dev_config->tx_task_core_id);
+    const BaseType_t task_created = cdc_dev->tx.task ? pdTRUE : pdFALSE;
+#elif CONFIG_CDC_ACM_STATIC_POOL
+    const BaseType_t task_created = pdFALSE; // Not reached, the pool has no TX queue
+#else
+    BaseType_t task_created = xTaskCreatePinnedToCore(
+                                  cdc_acm_tx_task, "CDC_TX", CDC_ACM_TX_TASK_STACK_SIZE, (void *)cdc_dev,
+                                  dev_config->tx_task_priority, &cdc_dev->tx.task, dev_config->tx_task_core_id);
+#endif
+    ESP_GOTO_ON_FALSE(task_created == pdTRUE, ESP_ERR_NO_MEM, err, TAG, "Could not create TX task");
+    return ESP_OK;
+
+err:
+    cdc_dev->tx.task = NULL;
+    cdc_acm_tx_task_stop(cdc_dev);
+    return ret;
+}
+
+/**
+ * @brief Complete items left in TX queue with ESP_ERR_INVALID_STATE
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_tx_queue_flush(cdc_dev_t *cdc_dev)
+{
+    cdc_tx_item_t item;
+    while (xQueueReceive(cdc_dev->tx.queue, &item, 0) == pdTRUE) {
+        if (item.done_cb) {
+            item.done_cb(ESP_ERR_INVALID_STATE, 0, item.user_arg);
+        }
+    }
+}
+
+/**
+ * @brief Stop TX task and complete items left in TX queue with ESP_ERR_INVALID_STATE
+ *
+ * New items are rejected first. Callers of cdc_acm_host_data_tx_queue() blocked on full queue get free space
+ * as the queue is flushed, and the queue is deleted only after all of them returned.
+ * Blocks until the TX task finishes the item it is sending.
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_tx_task_stop(cdc_dev_t *cdc_dev)
+{
+    if (cdc_dev->tx.queue) {
+        CDC_ACM_ENTER_CRITICAL();
+        cdc_dev->tx.closing = true;
+        CDC_ACM_EXIT_CRITICAL();
+        while (1) {
+            cdc_acm_tx_queue_flush(cdc_dev);
+            CDC_ACM_ENTER_CRITICAL();
+            const uint32_t users = cdc_dev->tx.users;
+            CDC_ACM_EXIT_CRITICAL();
+            if (users == 0) {
+                break;
+            }
+            vTaskDelay(1); // Let the callers blocked on full queue finish
+        }
+    }
+    if (cdc_dev->tx.task) {
+        CDC_ACM_ENTER_CRITICAL();
+        cdc_dev->tx.task_exit = true;
+        CDC_ACM_EXIT_CRITICAL();
+        xTaskNotifyGive(cdc_dev->tx.task);
+        xSemaphoreTake(cdc_dev->tx.task_done, portMAX_DELAY);
+        cdc_acm_task_join(cdc_dev->tx.task);
+        cdc_dev->tx.task = NULL;
+    }
+    if (cdc_dev->tx.queue) {
+        cdc_acm_tx_queue_flush(cdc_dev);
+        vQueueDelete(cdc_dev->tx.queue);
+        cdc_dev->tx.queue = NULL;
+    }
+    if (cdc_dev->tx.task_done) {
+        vSemaphoreDelete(cdc_dev->tx.task_done);
+        cdc_dev->tx.task_done = NULL;
+    }
+}
+
+esp_err_t cdc_acm_host_data_tx_queue(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, cdc_acm_tx_done_callback_t done_cb, void *user_arg, uint32_t timeout_ms)
+{
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(data && (data_len > 0), ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(cdc_dev->tx.queue, ESP_ERR_NOT_SUPPORTED); // Device was opened without TX task
+
+    // Register as a user of the queue, so cdc_acm_tx_task_stop() does not delete it under us
+    CDC_ACM_ENTER_CRITICAL();
+    const bool closing = cdc_dev->tx.closing;
+    if (!closing) {
+        cdc_dev->tx.users++;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    CDC_ACM_CHECK(!closing, ESP_ERR_INVALID_STATE);
+
+    esp_err_t ret = ESP_OK;
+    const cdc_tx_item_t item = {
+        .data = data,
+        .data_len = data_len,
+        .done_cb = done_cb,
+        .user_arg = user_arg,
+    };
+    switch (cdc_dev->tx.full_policy) {
+    case CDC_ACM_TX_QUEUE_DROP_OLDEST:
+        while (xQueueSend(cdc_dev->tx.queue, &item, 0) != pdTRUE) {
+            cdc_tx_item_t oldest;
+            if (xQueueReceive(cdc_dev->tx.queue, &oldest, 0) == pdTRUE) {
+                CDC_ACM_STATS_ADD(cdc_dev, tx_queue_drops, 1);
+                if (oldest.done_cb) {
+                    oldest.done_cb(ESP_ERR_NO_MEM, 0, oldest.user_arg);
+                }
+            }
+        }
+        break;
+    case CDC_ACM_TX_QUEUE_FAIL:
+        if (xQueueSend(cdc_dev->tx.queue, &item, 0) != pdTRUE) {
+            CDC_ACM_STATS_ADD(cdc_dev, tx_queue_drops, 1);
+            ret = ESP_ERR_NO_MEM;
+        }
+        break;
+    case CDC_ACM_TX_QUEUE_BLOCK:
+    default:
+        if (xQueueSend(cdc_dev->tx.queue, &item, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+            CDC_ACM_STATS_ADD(cdc_dev, tx_queue_drops, 1);
+            ret = ESP_ERR_TIMEOUT;
+        }
+        break;
+    }
+
+    const uint32_t depth = uxQueueMessagesWaiting(cdc_dev->tx.queue);
+    if (ret == ESP_OK) {
+        xTaskNotifyGive(cdc_dev->tx.task);
+    }
+    CDC_ACM_ENTER_CRITICAL();
+    if ((ret == ESP_OK) && (depth > cdc_dev->stats.tx_queue_depth_max)) {
+        cdc_dev->stats.tx_queue_depth_max = depth;
+    }
+    cdc_dev->tx.users--;
+    CDC_ACM_EXIT_CRITICAL();
+    return ret;
+}
+
+esp_err_t cdc_acm_host_data_rx(cdc_acm_dev_hdl_t cdc_hdl, uint8_t *data, size_t data_len, size_t *data_len_ret, uint32_t timeout_ms)
+{
+    esp_err_t ret;
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(data && (data_len > 0) && data_len_ret, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(cdc_dev->rx.data_ready, ESP_ERR_NOT_SUPPORTED); // Device was not opened in pull mode
+    *data_len_ret = 0;
+
+    TimeOut_t timeout;
+    TickType_t ticks_to_wait = pdMS_TO_TICKS(timeout_ms);
+    vTaskSetTimeOutState(&timeout);
+    if (xSemaphoreTake(cdc_dev->rx.mux, ticks_to_wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    // Return when trigger level is reached, or on timeout with whatever was received
+    const size_t trigger_level = (data_len < cdc_dev->rx.trigger_level) ? data_len : cdc_dev->rx.trigger_level;
+    size_t received = 0;
+    while (1) {
+        const uint8_t *ring_data;
+        size_t ring_data_len;
+        while ((received < data_len) && (ring_data_len = cdc_rx_ring_peek(&cdc_dev->rx.ring, &ring_data)) > 0) {
+            const size_t copy_len = (ring_data_len < data_len - received) ? ring_data_len : data_len - received;
+            memcpy(data + received, ring_data, copy_len);
+            cdc_rx_ring_consume(&cdc_dev->rx.ring, copy_len);
+            received += copy_len;
+        }
+        cdc_acm_rx_ring_drained(cdc_dev);
+        if (received >= trigger_level) {
+            break;
+        }
+        // data_ready is given after every write to the ring
+        if ((xTaskCheckForTimeOut(&timeout, &ticks_to_wait) == pdTRUE) ||
+                (xSemaphoreTake(cdc_dev->rx.data_ready, ticks_to_wait) != pdTRUE)) {
+            break;
+        }
+    }
+
+    *data_len_ret = received;
+    ret = (received > 0) ? ESP_OK : ESP_ERR_TIMEOUT;
+    xSemaphoreGive(cdc_dev->rx.mux);
+    return ret;
+}
+
+esp_err_t cdc_acm_host_rx_pause(cdc_acm_dev_hdl_t cdc_hdl)
+{
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(cdc_dev->data.in_xfer_num, ESP_ERR_NOT_SUPPORTED); // Device was opened as write-only
+
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_dev->data.in_pause |= CDC_ACM_RX_PAUSE_USER;
+    CDC_ACM_EXIT_CRITICAL();
+    return ESP_OK;
+}
+
+esp_err_t cdc_acm_host_rx_resume(cdc_acm_dev_hdl_t cdc_hdl)
+{
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(cdc_dev->data.in_xfer_num, ESP_ERR_NOT_SUPPORTED); // Device was opened as write-only
+
+    // Full RX append buffer is kept until the user processes its data, its transfer is idle while reception is paused
+    usb_transfer_t *transfer = cdc_dev->data.in_xfer[0];
+    CDC_ACM_ENTER_CRITICAL();
+    const bool full = (cdc_dev->data.in_xfer_idle & 1U) && (transfer->num_bytes == 0);
+    if (!full) {
+        cdc_dev->data.in_pause &= ~CDC_ACM_RX_PAUSE_USER;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+
+    if (full) {
+        // Deliver all buffered data again, they are flushed only if the user processed them this time
+        const size_t data_len = transfer->data_buffer - cdc_dev->data.in_data_buffer_base;
+        if (cdc_dev->data.in_cb && !cdc_dev->data.in_cb(cdc_dev->data.in_data_buffer_base, data_len, cdc_dev->cb_arg)) {
+            ESP_LOGD(TAG, "RX append buffer still not processed, reception stays paused");
+            return ESP_ERR_INVALID_STATE;
+        }
+        cdc_acm_reset_in_transfer(cdc_dev, transfer);
+        CDC_ACM_ENTER_CRITICAL();
+        cdc_dev->data.in_pause &= ~CDC_ACM_RX_PAUSE_USER;
+        CDC_ACM_EXIT_CRITICAL();
+    }
+    return cdc_acm_in_xfers_submit(cdc_dev);
+}
+
+esp_err_t cdc_acm_host_rx_buffer_hold(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data)
+{
+    CDC_ACM_CHECK(cdc_hdl && data, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    const usb_transfer_t *transfer = cdc_dev->data.in_xfer_current;
+
+    // Only the data that are being passed to data_cb can be held
+    CDC_ACM_CHECK(transfer, ESP_ERR_INVALID_STATE);
+    CDC_ACM_CHECK(data >= transfer->data_buffer && data < transfer->data_buffer + transfer->actual_num_bytes, ESP_ERR_INVALID_ARG);
+
+    CDC_ACM_ENTER_CRITICAL();
+    if (cdc_dev->data.in_xfer_hold == 0) {
+        const uint8_t spare_free = ~cdc_dev->data.in_xfer_loaned & ((1U << cdc_dev->data.in_xfer_spare_num) - 1);
+        CDC_ACM_CHECK_FROM_CRIT(spare_free, ESP_ERR_NO_MEM);
+        cdc_dev->data.in_xfer_hold = spare_free & -spare_free; // Reserve the lowest free spare slot
+        cdc_dev->data.in_xfer_loaned |= cdc_dev->data.in_xfer_hold;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    return ESP_OK;
+}
+
+esp_err_t cdc_acm_host_rx_buffer_release(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data)
+{
+    CDC_ACM_CHECK(cdc_hdl && data, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+
+    CDC_ACM_ENTER_CRITICAL();
+    for (int i = 0; i < cdc_dev->data.in_xfer_spare_num; i++) {
+        const usb_transfer_t *transfer = cdc_dev->data.in_xfer_spare[i];
+        // Slot reserved in current data_cb does not contain the held transfer yet
+        if (!(cdc_dev->data.in_xfer_loaned & ~cdc_dev->data.in_xfer_hold & (1U << i))) {
+            continue;
+        }
+        if (data >= transfer->data_buffer && data < transfer->data_buffer + transfer->data_buffer_size) {
+            cdc_dev->data.in_xfer_loaned &= ~(1U << i);
+            CDC_ACM_EXIT_CRITICAL();
+            return ESP_OK;
+        }
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    return ESP_ERR_NOT_FOUND;
+}
+
+/**
+ * @brief Get number of queued asynchronous requests that change the same port setting as this request
+ *
+ * Must be called from CDC-ACM critical section.
+ *
+ * @return Pointer to the counter in shadow, NULL if the request does not change a shadowed port setting
+ */
+static uint8_t *cdc_acm_ctrl_async_pending(cdc_dev_t *cdc_dev, const usb_setup_packet_t *setup)
+{
+    if ((setup->bmRequestType & USB_BM_REQUEST_TYPE_TYPE_MASK) != USB_BM_REQUEST_TYPE_TYPE_CLASS) {
+        return NULL;
+    }
+    switch (setup->bRequest) {
+    case USB_CDC_REQ_SET_LINE_CODING:
+        return &cdc_dev->shadow.line_coding_pending;
+    case USB_CDC_REQ_SET_CONTROL_LINE_STATE:
+        return &cdc_dev->shadow.ctrl_line_state_pending;
+    default:
+        return NULL;
+    }
+}
+
+/**
+ * @brief Count asynchronous request that was queued or finished
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ * @param[in] setup   Setup packet of the request
+ * @param[in] queued  true if the request was queued, false if it finished or was dropped
+ */
+static void cdc_acm_ctrl_async_pending_update(cdc_dev_t *cdc_dev, const usb_setup_packet_t *setup, bool queued)
+{
+    CDC_ACM_ENTER_CRITICAL();
+    uint8_t *pending = cdc_acm_ctrl_async_pending(cdc_dev, setup);
+    if (pending) {
+        *pending = queued ? *pending + 1 : *pending - 1;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+}
+
+/**
+ * @brief Check if line coding is equal to the shadow copy
+ *
+ * A queued asynchronous request will overwrite the shadow copy, so nothing is cached while one is pending.
+ */
+static bool cdc_acm_line_coding_cached(cdc_dev_t *cdc_dev, const cdc_acm_line_coding_t *line_coding)
+{
+    CDC_ACM_ENTER_CRITICAL();
+    const bool cached = cdc_dev->shadow.line_coding_valid && (cdc_dev->shadow.line_coding_pending == 0) &&
+                        (memcmp(&cdc_dev->shadow.line_coding, line_coding, sizeof(cdc_acm_line_coding_t)) == 0);
+    CDC_ACM_EXIT_CRITICAL();
+    return cached;
+}
+
+/**
+ * @brief Update shadow copy of line coding, after it was set or read
+ */
+static void cdc_acm_line_coding_update(cdc_dev_t *cdc_dev, const cdc_acm_line_coding_t *line_coding)
+{
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_dev->shadow.line_coding = *line_coding;
+    cdc_dev->shadow.line_coding_valid = true;
+    CDC_ACM_EXIT_CRITICAL();
+    cdc_acm_tx_pace_rate_set(cdc_dev, line_coding);
+}
+
+/**
+ * @brief Check if control line state bitmap is equal to the shadow copy
+ *
+ * A queued asynchronous request will overwrite the shadow copy, so nothing is cached while one is pending.
+ */
+static bool cdc_acm_ctrl_line_state_cached(cdc_dev_t *cdc_dev, uint16_t ctrl_bitmap)
+{
+    CDC_ACM_ENTER_CRITICAL();
+    const bool cached = cdc_dev->shadow.ctrl_line_state_valid && (cdc_dev->shadow.ctrl_line_state_pending == 0) &&
+                        (cdc_dev->shadow.ctrl_line_state == ctrl_bitmap);
+    CDC_ACM_EXIT_CRITICAL();
+    return cached;
+}
+
+/**
+ * @brief Update shadow copy of control line state, after it was set
+ */
+static void cdc_acm_ctrl_line_state_update(cdc_dev_t *cdc_dev, uint16_t ctrl_bitmap)
+{
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_dev->shadow.ctrl_line_state = ctrl_bitmap;
+    cdc_dev->shadow.ctrl_line_state_valid = true;
+    CDC_ACM_EXIT_CRITICAL();
+}
+
+esp_err_t cdc_acm_host_line_coding_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_acm_line_coding_t *line_coding)
+{
+    CDC_ACM_CHECK(cdc_hdl && line_coding, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+
+    CDC_ACM_ENTER_CRITICAL();
+    if (cdc_dev->shadow.line_coding_valid) {
+        *line_coding = cdc_dev->shadow.line_coding;
+        CDC_ACM_EXIT_CRITICAL();
+        return ESP_OK;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    return cdc_acm_host_line_coding_refresh(cdc_hdl, line_coding);
+}
+
+esp_err_t cdc_acm_host_line_coding_refresh(cdc_acm_dev_hdl_t cdc_hdl, cdc_acm_line_coding_t *line_coding)
+{
+    CDC_ACM_CHECK(line_coding, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+
+    ESP_RETURN_ON_ERROR(
+        send_cdc_request(cdc_dev, true, USB_CDC_REQ_GET_LINE_CODING, (uint8_t *)line_coding, sizeof(cdc_acm_line_coding_t), 0),
+        TAG,);
+    cdc_acm_line_coding_update(cdc_dev, line_coding);
+    ESP_LOGD(TAG, "Line Get: Rate: %"PRIu32", Stop bits: %d, Parity: %d, Databits: %d", line_coding->dwDTERate,
+             line_coding->bCharFormat, line_coding->bParityType, line_coding->bDataBits);
+    return ESP_OK;
+}
+
+esp_err_t cdc_acm_host_line_coding_set(cdc_acm_dev_hdl_t cdc_hdl, const cdc_acm_line_coding_t *line_coding)
+{
+    CDC_ACM_CHECK(cdc_hdl && line_coding, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    if (cdc_acm_line_coding_cached(cdc_dev, line_coding)) {
+        return ESP_OK;
+    }
+
+    ESP_RETURN_ON_ERROR(
+        send_cdc_request(cdc_dev, false, USB_CDC_REQ_SET_LINE_CODING, (uint8_t *)line_coding, sizeof(cdc_acm_line_coding_t), 0),
+        TAG,);
+    cdc_acm_line_coding_update(cdc_dev, line_coding);
+    ESP_LOGD(TAG, "Line Set: Rate: %"PRIu32", Stop bits: %d, Parity: %d, Databits: %d", line_coding->dwDTERate,
+             line_coding->bCharFormat, line_coding->bParityType, line_coding->bDataBits);
+    return ESP_OK;
+}
+
+esp_err_t cdc_acm_host_set_control_line_state(cdc_acm_dev_hdl_t cdc_hdl, bool dtr, bool rts)
+{
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    const uint16_t ctrl_bitmap = (uint16_t)dtr | ((uint16_t)rts << 1);
+    if (cdc_acm_ctrl_line_state_cached(cdc_dev, ctrl_bitmap)) {
+        return ESP_OK;
+    }
+
+    ESP_RETURN_ON_ERROR(
+        send_cdc_request(cdc_dev, false, USB_CDC_REQ_SET_CONTROL_LINE_STATE, NULL, 0, ctrl_bitmap),
+        TAG,);
+    cdc_acm_ctrl_line_state_update(cdc_dev, ctrl_bitmap);
+    ESP_LOGD(TAG, "Control Line Set: DTR: %d, RTS: %d", dtr, rts);
+    return ESP_OK;
+}
+
+esp_err_t cdc_acm_host_apply_port_settings(cdc_acm_dev_hdl_t cdc_hdl, const cdc_acm_line_coding_t *line_coding, bool dtr, bool rts)
+{
+    esp_err_t ret = ESP_OK;
+    CDC_ACM_CHECK(cdc_hdl && line_coding, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(cdc_dev->notif.intf_desc, ESP_ERR_NOT_SUPPORTED);
+    const uint8_t req_type = USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIP_INTERFACE | USB_BM_REQUEST_TYPE_DIR_OUT;
+    const uint16_t intf_num = cdc_dev->notif.intf_desc->bInterfaceNumber;
+    const uint16_t ctrl_bitmap = (uint16_t)dtr | ((uint16_t)rts << 1);
+
+    CDC_ACM_CHECK(!cdc_acm_in_driver_task(), ESP_ERR_INVALID_STATE);
+
+    // Both requests are sent back-to-back, without asynchronous requests in between
+    if (xSemaphoreTake(cdc_dev->ctrl_mux, pdMS_TO_TICKS(CDC_ACM_CTRL_TIMEOUT_MS)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if (!cdc_acm_line_coding_cached(cdc_dev, line_coding)) {
+        ESP_GOTO_ON_ERROR(
+            cdc_acm_ctrl_transfer_locked(cdc_dev, req_type, USB_CDC_REQ_SET_LINE_CODING, 0, intf_num, sizeof(cdc_acm_line_coding_t), (uint8_t *)line_coding),
+            unblock, TAG,);
+        cdc_acm_line_coding_update(cdc_dev, line_coding);
+    }
+    if (!cdc_acm_ctrl_line_state_cached(cdc_dev, ctrl_bitmap)) {
+        ESP_GOTO_ON_ERROR(
+            cdc_acm_ctrl_transfer_locked(cdc_dev, req_type, USB_CDC_REQ_SET_CONTROL_LINE_STATE, ctrl_bitmap, intf_num, 0, NULL),
+            unblock, TAG,);
+        cdc_acm_ctrl_line_state_update(cdc_dev, ctrl_bitmap);
+    }
+
+unblock:
+    xSemaphoreGive(cdc_dev->ctrl_mux);
+    cdc_acm_ctrl_async_kick(cdc_dev);
+    return ret;
+}
+
+esp_err_t cdc_acm_host_send_break(cdc_acm_dev_hdl_t cdc_hdl, uint16_t duration_ms)
+{
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    ESP_RETURN_ON_ERROR(
+        send_cdc_request(cdc_dev, false, USB_CDC_REQ_SEND_BREAK, NULL, 0, duration_ms),
+        TAG,);
+
+    // Block until break is deasserted
+    vTaskDelay(pdMS_TO_TICKS(duration_ms + 1));
+    return ESP_OK;
+}
+
+esp_err_t cdc_acm_host_send_custom_request(cdc_acm_dev_hdl_t cdc_hdl, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength, uint8_t *data)
+{
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    if (wLength > 0) {
+        CDC_ACM_CHECK(data, ESP_ERR_INVALID_ARG);
+    }
+    CDC_ACM_CHECK(wLength + sizeof(usb_setup_packet_t) <= cdc_dev->ctrl_transfer->data_buffer_size, ESP_ERR_INVALID_SIZE);
+    CDC_ACM_CHECK(!cdc_acm_in_driver_task(), ESP_ERR_INVALID_STATE);
+
+    // Take Mutex and fill the CTRL request
+    if (xSemaphoreTake(cdc_dev->ctrl_mux, pdMS_TO_TICKS(CDC_ACM_CTRL_TIMEOUT_MS)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    const esp_err_t ret = cdc_acm_ctrl_transfer_locked(cdc_dev, bmRequestType, bRequest, wValue, wIndex, wLength, data);
+    xSemaphoreGive(cdc_dev->ctrl_mux);
+    // Asynchronous requests queued while this request was in flight
+    cdc_acm_ctrl_async_kick(cdc_dev);
+    return ret;
+}
+
+/**
+ * @brief Send CTRL request and wait for its completion
+ *
+ * @note The caller must own the CTRL transfer (ctrl_mux)
+ * @return See cdc_acm_host_send_custom_request()
+ */
+static esp_err_t cdc_acm_ctrl_transfer_locked(cdc_dev_t *cdc_dev, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength, uint8_t *data)
+{
+    usb_setup_packet_t *req = (usb_setup_packet_t *)(cdc_dev->ctrl_transfer->data_buffer);
+    uint8_t *start_of_data = (uint8_t *)req + sizeof(usb_setup_packet_t);
+    req->bmRequestType = bmRequestType;
+    req->bRequest = bRequest;
+    req->wValue = wValue;
+    req->wIndex = wIndex;
+    req->wLength = wLength;
+
+    // For IN transfers we must transfer data ownership to CDC driver
+    const bool in_transfer = bmRequestType & USB_BM_REQUEST_TYPE_DIR_IN;
+    if (!in_transfer) {
+        memcpy(start_of_data, data, wLength);
+    }
+
+    cdc_dev->ctrl_transfer->num_bytes = wLength + sizeof(usb_setup_packet_t);
+    cdc_dev->ctrl_transfer->callback = ctrl_xfer_cb;
+    ESP_RETURN_ON_ERROR(
+        usb_host_transfer_submit_control(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->ctrl_transfer),
+        TAG, "CTRL transfer failed");
+
+    if (xSemaphoreTake(cdc_dev->ctrl_done, pdMS_TO_TICKS(CDC_ACM_CTRL_TIMEOUT_MS)) != pdTRUE) {
+        // Transfer was not finished, error in USB LIB. Reset the endpoint
+        cdc_acm_reset_transfer_endpoint(cdc_dev->dev_hdl, cdc_dev->ctrl_transfer);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    ESP_RETURN_ON_FALSE(cdc_dev->ctrl_transfer->status == USB_TRANSFER_STATUS_COMPLETED, ESP_ERR_INVALID_RESPONSE, TAG, "Control transfer error");
+    ESP_RETURN_ON_FALSE(cdc_dev->ctrl_transfer->actual_num_bytes == cdc_dev->ctrl_transfer->num_bytes, ESP_ERR_INVALID_RESPONSE, TAG, "Incorrect number of bytes transferred");
+
+    // For OUT transfers, we must transfer data ownership to user
+    if (in_transfer) {
+        memcpy(data, start_of_data, wLength);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t send_cdc_request(cdc_dev_t *cdc_dev, bool in_transfer, cdc_request_code_t request, uint8_t *data, uint16_t data_len, uint16_t value)
+{
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(cdc_dev->notif.intf_desc, ESP_ERR_NOT_SUPPORTED);
+
+    uint8_t req_type = USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
+    if (in_transfer) {
+        req_type |= USB_BM_REQUEST_TYPE_DIR_IN;
+    } else {
+        req_type |= USB_BM_REQUEST_TYPE_DIR_OUT;
+    }
+    return cdc_acm_host_send_custom_request(cdc_dev->hdl, req_type, request, value, cdc_dev->notif.intf_desc->bInterfaceNumber, data_len, data);
+}
+
+/**
+ * @brief Submit queued asynchronous CTRL requests
+ *
+ * The caller must own the CTRL transfer (ctrl_mux). The ownership is returned when a request is submitted
+ * and the queue is empty, so blocking requests and asynchronous requests queued meanwhile can proceed.
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_ctrl_async_submit_next(cdc_dev_t *cdc_dev)
+{
+    cdc_ctrl_req_t *req = &cdc_dev->ctrl_async.current;
+    while (1) {
+        CDC_ACM_ENTER_CRITICAL();
+        const bool closing = cdc_dev->ctrl_async.closing;
+        CDC_ACM_EXIT_CRITICAL();
+        if (!closing && (xQueueReceive(cdc_dev->ctrl_async.queue, req, 0) == pdTRUE)) {
+            usb_transfer_t *transfer = cdc_dev->ctrl_transfer;
+            memcpy(transfer->data_buffer, &req->setup, sizeof(usb_setup_packet_t));
+            if (!(req->setup.bmRequestType & USB_BM_REQUEST_TYPE_DIR_IN)) {
+                memcpy(transfer->data_buffer + sizeof(usb_setup_packet_t), req->data_ext ? req->data_ext : req->data, req->setup.wLength);
+                free(req->data_ext);
+                req->data_ext = NULL;
+            }
+            transfer->num_bytes = req->setup.wLength + sizeof(usb_setup_packet_t);
+            transfer->callback = ctrl_async_xfer_cb;
+            const esp_err_t ret = usb_host_transfer_submit_control(p_cdc_acm_obj->cdc_acm_client_hdl, transfer);
+            if (ret == ESP_OK) {
+                return; // ctrl_async_xfer_cb() continues with the next request
+            }
+            ESP_LOGE(TAG, "CTRL transfer failed");
+            cdc_acm_ctrl_async_pending_update(cdc_dev, &req->setup, false);
+            if (req->done_cb) {
+                req->done_cb(ret, NULL, 0, req->user_arg);
+            }
+            continue;
+        }
+
+        // Release the CTRL transfer, then check for requests queued after the queue was found empty
+        xSemaphoreGive(cdc_dev->ctrl_mux);
+        if (closing || (uxQueueMessagesWaiting(cdc_dev->ctrl_async.queue) == 0) || (xSemaphoreTake(cdc_dev->ctrl_mux, 0) != pdTRUE)) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Start submitting queued asynchronous CTRL requests, if the CTRL transfer is idle
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_ctrl_async_kick(cdc_dev_t *cdc_dev)
+{
+    if ((uxQueueMessagesWaiting(cdc_dev->ctrl_async.queue) > 0) && (xSemaphoreTake(cdc_dev->ctrl_mux, 0) == pdTRUE)) {
+        cdc_acm_ctrl_async_submit_next(cdc_dev);
+    }
+}
+
+/**
+ * @brief Wait for asynchronous CTRL request in flight and complete queued requests with ESP_ERR_INVALID_STATE
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_ctrl_async_stop(cdc_dev_t *cdc_dev)
+{
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_dev->ctrl_async.closing = true;
+    CDC_ACM_EXIT_CRITICAL();
+
+    if (xSemaphoreTake(cdc_dev->ctrl_mux, pdMS_TO_TICKS(CDC_ACM_CTRL_TIMEOUT_MS)) != pdTRUE) {
+        // Transfer was not finished, error in USB LIB. Reset the endpoint
+        cdc_acm_reset_transfer_endpoint(cdc_dev->dev_hdl, cdc_dev->ctrl_transfer);
+        if (xSemaphoreTake(cdc_dev->ctrl_mux, pdMS_TO_TICKS(CDC_ACM_CTRL_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGE(TAG, "CTRL transfer did not complete"); // Gracefully continue on error
+        }
+    }
+    cdc_ctrl_req_t req;
+    while (xQueueReceive(cdc_dev->ctrl_async.queue, &req, 0) == pdTRUE) {
+        free(req.data_ext);
+        cdc_acm_ctrl_async_pending_update(cdc_dev, &req.setup, false);
+        if (req.done_cb) {
+            req.done_cb(ESP_ERR_INVALID_STATE, NULL, 0, req.user_arg);
+        }
+    }
+}
+
+static void ctrl_async_xfer_cb(usb_transfer_t *transfer)
+{
+    ESP_LOGD(TAG, "ctrl async xfer cb");
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)transfer->context;
+    const cdc_ctrl_req_t *req = &cdc_dev->ctrl_async.current;
+    const bool in_transfer = req->setup.bmRequestType & USB_BM_REQUEST_TYPE_DIR_IN;
+    const uint8_t *data = transfer->data_buffer + sizeof(usb_setup_packet_t);
+    esp_err_t status = ESP_OK;
+    // Device can end data stage of IN request early, for example with a short encapsulated response
+    const bool length_ok = in_transfer ? (transfer->actual_num_bytes >= sizeof(usb_setup_packet_t)) && (transfer->actual_num_bytes <= transfer->num_bytes)
+                           : (transfer->actual_num_bytes == transfer->num_bytes);
+    if ((transfer->status != USB_TRANSFER_STATUS_COMPLETED) || !length_ok) {
+        ESP_LOGW(TAG, "Control transfer error");
+        status = ESP_ERR_INVALID_RESPONSE;
+    }
+    const size_t data_len = (status == ESP_OK) ? transfer->actual_num_bytes - sizeof(usb_setup_packet_t) : 0;
+
+    // Shadow copies of port settings are updated, same as with blocking requests
+    if ((status == ESP_OK) && ((req->setup.bmRequestType & USB_BM_REQUEST_TYPE_TYPE_MASK) == USB_BM_REQUEST_TYPE_TYPE_CLASS)) {
+        const bool line_coding_len = (req->setup.wLength == sizeof(cdc_acm_line_coding_t)) && (data_len == sizeof(cdc_acm_line_coding_t));
+        if ((req->setup.bRequest == USB_CDC_REQ_SET_LINE_CODING) && line_coding_len) {
+            cdc_acm_line_coding_update(cdc_dev, (const cdc_acm_line_coding_t *)req->data);
+        } else if ((req->setup.bRequest == USB_CDC_REQ_GET_LINE_CODING) && line_coding_len) {
+            cdc_acm_line_coding_update(cdc_dev, (const cdc_acm_line_coding_t *)data);
+        } else if (req->setup.bRequest == USB_CDC_REQ_SET_CONTROL_LINE_STATE) {
+            cdc_acm_ctrl_line_state_update(cdc_dev, req->setup.wValue);
+        }
+    }
+    cdc_acm_ctrl_async_pending_update(cdc_dev, &req->setup, false);
+
+    if (req->done_cb) {
+        if (in_transfer && (status == ESP_OK)) {
+            req->done_cb(status, data, data_len, req->user_arg);
+        } else {
+            req->done_cb(status, NULL, 0, req->user_arg);
+        }
+    }
+    cdc_acm_ctrl_async_submit_next(cdc_dev);
+}
+
+esp_err_t cdc_acm_host_send_custom_request_async(cdc_acm_dev_hdl_t cdc_hdl, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength,
+        const uint8_t *data, cdc_acm_ctrl_done_callback_t done_cb, void *user_arg)
+{
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    const bool in_transfer = bmRequestType & USB_BM_REQUEST_TYPE_DIR_IN;
+    if ((wLength > 0) && !in_transfer) {
+        CDC_ACM_CHECK(data, ESP_ERR_INVALID_ARG);
+    }
+    CDC_ACM_CHECK(wLength + sizeof(usb_setup_packet_t) <= cdc_dev->ctrl_transfer->data_buffer_size, ESP_ERR_INVALID_SIZE);
+
+    cdc_ctrl_req_t req = {
+        .setup = {
+            .bmRequestType = bmRequestType,
+            .bRequest = bRequest,
+            .wValue = wValue,
+            .wIndex = wIndex,
+            .wLength = wLength,
+        },
+        .done_cb = done_cb,
+        .user_arg = user_arg,
+    };
+    if (!in_transfer && (wLength > sizeof(req.data))) {
+        // Data larger than standard requests are kept on heap until the request is submitted
+        req.data_ext = malloc(wLength);
+        CDC_ACM_CHECK(req.data_ext, ESP_ERR_NO_MEM);
+        memcpy(req.data_ext, data, wLength);
+    } else if (!in_transfer) {
+        memcpy(req.data, data, wLength);
+    }
+    // Counted before it is queued, so it cannot finish before it is counted
+    cdc_acm_ctrl_async_pending_update(cdc_dev, &req.setup, true);
+    if (xQueueSend(cdc_dev->ctrl_async.queue, &req, 0) != pdTRUE) {
+        cdc_acm_ctrl_async_pending_update(cdc_dev, &req.setup, false);
+        free(req.data_ext);
+        return ESP_ERR_NO_MEM;
+    }
+    cdc_acm_ctrl_async_kick(cdc_dev);
+    return ESP_OK;
+}
+
+static esp_err_t send_cdc_request_async(cdc_dev_t *cdc_dev, bool in_transfer, cdc_request_code_t request, const uint8_t *data, uint16_t data_len, uint16_t value,
+                                        cdc_acm_ctrl_done_callback_t done_cb, void *user_arg)
+{
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(cdc_dev->notif.intf_desc, ESP_ERR_NOT_SUPPORTED);
+
+    uint8_t req_type = USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
+    if (in_transfer) {
+        req_type |= USB_BM_REQUEST_TYPE_DIR_IN;
+    } else {
+        req_type |= USB_BM_REQUEST_TYPE_DIR_OUT;
+    }
+    return cdc_acm_host_send_custom_request_async(cdc_dev->hdl, req_type, request, value, cdc_dev->notif.intf_desc->bInterfaceNumber, data_len, data,
+            done_cb, user_arg);
+}
+
+esp_err_t cdc_acm_host_line_coding_set_async(cdc_acm_dev_hdl_t cdc_hdl, const cdc_acm_line_coding_t *line_coding, cdc_acm_ctrl_done_callback_t done_cb, void *user_arg)
+{
+    CDC_ACM_CHECK(line_coding, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    if (cdc_acm_line_coding_cached(cdc_dev, line_coding)) {
+        if (done_cb) {
+            done_cb(ESP_OK, NULL, 0, user_arg);
+        }
+        return ESP_OK;
+    }
+    return send_cdc_request_async(cdc_dev, false, USB_CDC_REQ_SET_LINE_CODING, (const uint8_t *)line_coding, sizeof(cdc_acm_line_coding_t), 0,
+                                  done_cb, user_arg);
+}
+
+esp_err_t cdc_acm_host_line_coding_get_async(cdc_acm_dev_hdl_t cdc_hdl, cdc_acm_ctrl_done_callback_t done_cb, void *user_arg)
+{
+    CDC_ACM_CHECK(done_cb, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    return send_cdc_request_async(cdc_dev, true, USB_CDC_REQ_GET_LINE_CODING, NULL, sizeof(cdc_acm_line_coding_t), 0, done_cb, user_arg);
+}
+
+esp_err_t cdc_acm_host_set_control_line_state_async(cdc_acm_dev_hdl_t cdc_hdl, bool dtr, bool rts, cdc_acm_ctrl_done_callback_t done_cb, void *user_arg)
+{
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    const uint16_t ctrl_bitmap = (uint16_t)dtr | ((uint16_t)rts << 1);
+    if (cdc_acm_ctrl_line_state_cached(cdc_dev, ctrl_bitmap)) {
+        if (done_cb) {
+            done_cb(ESP_OK, NULL, 0, user_arg);
+        }
+        return ESP_OK;
+    }
+    return send_cdc_request_async(cdc_dev, false, USB_CDC_REQ_SET_CONTROL_LINE_STATE, NULL, 0, ctrl_bitmap, done_cb, user_arg);
+}
+
+esp_err_t cdc_acm_host_send_encapsulated_command(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, uint16_t data_len, cdc_acm_ctrl_done_callback_t done_cb, void *user_arg)
+{
+    CDC_ACM_CHECK(data && (data_len > 0), ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(data_len <= cdc_dev->ctrl_buffer_size, ESP_ERR_INVALID_SIZE);
+    return send_cdc_request_async(cdc_dev, false, USB_CDC_REQ_SEND_ENCAPSULATED_COMMAND, data, data_len, 0, done_cb, user_arg);
+}
+
+esp_err_t cdc_acm_host_stats_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_acm_host_stats_t *stats)
+{
+    CDC_ACM_CHECK(cdc_hdl && stats, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+
+    const uint32_t tx_queue_depth = cdc_dev->tx.queue ? uxQueueMessagesWaiting(cdc_dev->tx.queue) : 0;
+    CDC_ACM_ENTER_CRITICAL();
+    *stats = cdc_dev->stats;
+    CDC_ACM_EXIT_CRITICAL();
+    stats->tx_queue_depth = tx_queue_depth;
+    return ESP_OK;
+}
+
+esp_err_t cdc_acm_host_stats_reset(cdc_acm_dev_hdl_t cdc_hdl)
+{
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+
+    CDC_ACM_ENTER_CRITICAL();
+    const size_t in_xfer_size = cdc_dev->stats.in_xfer_size;
+    memset(&cdc_dev->stats, 0, sizeof(cdc_dev->stats));
+    cdc_dev->stats.in_xfer_size = in_xfer_size;
+    CDC_ACM_EXIT_CRITICAL();
+    return ESP_OK;
+}
+
+esp_err_t cdc_acm_host_pool_stats_get(cdc_acm_host_pool_stats_t *stats)
+{
+    CDC_ACM_CHECK(stats, ESP_ERR_INVALID_ARG);
+#if CONFIG_CDC_ACM_STATIC_POOL
+    CDC_ACM_ENTER_CRITICAL();
+    stats->size = CONFIG_CDC_ACM_STATIC_POOL_SIZE;
+    stats->in_use = cdc_acm_pool.in_use;
+    stats->high_water = cdc_acm_pool.high_water;
+    CDC_ACM_EXIT_CRITICAL();
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t cdc_acm_host_protocols_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_comm_protocol_t *comm, cdc_data_protocol_t *data)
+{
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+
+    if (comm != NULL) {
+        *comm = cdc_dev->comm_protocol;
+    }
+    if (data != NULL) {
+        *data = cdc_dev->data_protocol;
+    }
+    return ESP_OK;
+}
+
+esp_err_t cdc_acm_host_cdc_desc_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_desc_subtype_t desc_type, const usb_standard_desc_t **desc_out)
+{
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(desc_type < USB_CDC_DESC_SUBTYPE_MAX, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    const uint8_t func_idx = cdc_dev->cdc_func_desc_idx[desc_type];
+    if (func_idx == 0) {
+        *desc_out = NULL;
+        return ESP_ERR_NOT_FOUND;
+    }
+    *desc_out = (const usb_standard_desc_t *)((const uint8_t *)cdc_dev->config_desc + cdc_dev->cdc_func_desc[func_idx - 1].offset);
+    return ESP_OK;
+}
+
+esp_err_t cdc_acm_host_device_info_get(cdc_acm_dev_hdl_t cdc_hdl, usb_device_info_t *info)
+{
+    CDC_ACM_CHECK(cdc_hdl && info, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = cdc_acm_dev_get(cdc_hdl);
+    CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    return usb_host_device_info(cdc_dev->dev_hdl, info);
 }
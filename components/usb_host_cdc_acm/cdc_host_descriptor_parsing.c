@@ -23,22 +23,247 @@
 
 static const char *TAG = "cdc_acm_parsing";
 
+// Cache of parsed interfaces, so reconnected devices are not parsed again
+#define CDC_PARSE_CACHE_SIZE     (4) // Number of cached interfaces
+
+// Parsed interface with descriptors stored as offsets in Configuration descriptor. Offset 0 means no descriptor
+typedef struct {
+    bool valid;
+    uint32_t last_use;                  // Value of cache_use_cnt when the entry was last used
+    // Key
+    uint16_t idVendor;
+    uint16_t idProduct;
+    uint16_t bcdDevice;
+    uint8_t intf_idx;
+    uint16_t wTotalLength;
+    uint32_t config_hash;               // Hash of the whole Configuration descriptor
+    // Value
+    uint16_t notif_ep;
+    uint16_t in_ep;
+    uint16_t out_ep;
+    uint16_t notif_intf;
+    uint16_t data_intf;
+    uint8_t func_cnt;
+    cdc_func_desc_t func[CDC_FUNC_DESC_MAX];
+} cdc_parse_cache_entry_t;
+
+static cdc_parse_cache_entry_t parse_cache[CDC_PARSE_CACHE_SIZE];
+static uint32_t cache_use_cnt;
+
+// Index of Configuration descriptor, built in one pass so that opening any interface is a lookup
+#define CDC_PARSE_INDEX_INTF_MAX (64)  // Interface descriptors, including alternate settings
+#define CDC_PARSE_INDEX_EP_MAX   (128) // Endpoint descriptors
+#define CDC_PARSE_INDEX_IAD_MAX  (16)  // Interface Association descriptors
+#define CDC_PARSE_INDEX_FUNC_MAX (64)  // CDC functional descriptors right after Interface descriptors
+
+// Interface descriptor in the index. Descriptors are stored as offsets in Configuration descriptor
+typedef struct {
+    uint16_t offset;            // Offset of the Interface descriptor
+    uint8_t bInterfaceNumber;
+    uint8_t bAlternateSetting;
+    uint8_t ep_first;           // Index in ep[] of the first Endpoint descriptor after this interface
+    uint8_t func_first;         // Index in func[] of the first functional descriptor of this interface
+    uint8_t func_cnt;           // Number of functional descriptors right after this interface
+} cdc_parse_index_intf_t;
+
+typedef struct {
+    bool valid;
+    // Key
+    uint16_t wTotalLength;
+    uint32_t config_hash;               // Hash of the whole Configuration descriptor
+    // Value
+    uint8_t intf_cnt;
+    uint8_t ep_cnt;
+    uint8_t iad_cnt;
+    uint8_t func_cnt;
+    cdc_parse_index_intf_t intf[CDC_PARSE_INDEX_INTF_MAX]; // In order of appearance
+    uint16_t ep[CDC_PARSE_INDEX_EP_MAX];
+    uint16_t iad[CDC_PARSE_INDEX_IAD_MAX];
+    uint16_t func[CDC_PARSE_INDEX_FUNC_MAX];
+} cdc_parse_index_t;
+
+static cdc_parse_index_t config_index;
+
+/**
+ * @brief FNV-1a hash of Configuration descriptor
+ *
+ * @param[in] config_desc Pointer to Configuration descriptor
+ * @return Hash
+ */
+static uint32_t cdc_parse_config_hash(const usb_config_desc_t *config_desc)
+{
+    const uint8_t *bytes = (const uint8_t *)config_desc;
+    uint32_t hash = 2166136261U;
+    for (int i = 0; i < config_desc->wTotalLength; i++) {
+        hash = (hash ^ bytes[i]) * 16777619U;
+    }
+    return hash;
+}
+
+/**
+ * @brief Convert offset in Configuration descriptor to descriptor pointer
+ *
+ * @param[in] config_desc Pointer to Configuration descriptor
+ * @param[in] offset      Offset of the descriptor, 0 for no descriptor
+ * @return Pointer to the descriptor, NULL for offset 0
+ */
+static inline const void *cdc_parse_cache_ptr(const usb_config_desc_t *config_desc, uint16_t offset)
+{
+    return offset ? (const uint8_t *)config_desc + offset : NULL;
+}
+
+/**
+ * @brief Build index of Configuration descriptor
+ *
+ * Walks the Configuration descriptor once and records all Interface, Endpoint and IAD descriptors,
+ * and CDC functional descriptors that follow an Interface descriptor.
+ * The index is kept until a different Configuration descriptor is parsed.
+ *
+ * @param[in] config_desc Pointer to Configuration descriptor
+ * @param[in] config_hash Hash of the Configuration descriptor
+ * @return
+ *     - ESP_OK:                Success
+ *     - ESP_ERR_NOT_SUPPORTED: Configuration descriptor has too many descriptors for the index
+ */
+static esp_err_t cdc_parse_index_build(const usb_config_desc_t *config_desc, uint32_t config_hash)
+{
+    cdc_parse_index_t *index = &config_index;
+    if (index->valid && (index->wTotalLength == config_desc->wTotalLength) && (index->config_hash == config_hash)) {
+        return ESP_OK;
+    }
+
+    memset(index, 0, sizeof(cdc_parse_index_t));
+    const uint8_t *bytes = (const uint8_t *)config_desc;
+    bool in_func_run = false; // True while functional descriptors follow the last Interface descriptor
+    // The Configuration descriptor itself is skipped
+    for (int offset = config_desc->bLength; offset < config_desc->wTotalLength;) {
+        const usb_standard_desc_t *this_desc = (const usb_standard_desc_t *)(bytes + offset);
+        if ((this_desc->bLength == 0) || (offset + this_desc->bLength > config_desc->wTotalLength)) {
+            break; // Malformed or truncated descriptor
+        }
+        switch (this_desc->bDescriptorType) {
+        case USB_B_DESCRIPTOR_TYPE_INTERFACE: {
+            const usb_intf_desc_t *intf_desc = (const usb_intf_desc_t *)this_desc;
+            ESP_RETURN_ON_FALSE(index->intf_cnt < CDC_PARSE_INDEX_INTF_MAX, ESP_ERR_NOT_SUPPORTED, TAG, "Too many interfaces");
+            index->intf[index->intf_cnt++] = (cdc_parse_index_intf_t) {
+                .offset = offset,
+                .bInterfaceNumber = intf_desc->bInterfaceNumber,
+                .bAlternateSetting = intf_desc->bAlternateSetting,
+                .ep_first = index->ep_cnt,
+                .func_first = index->func_cnt,
+            };
+            in_func_run = true;
+            break;
+        }
+        case USB_B_DESCRIPTOR_TYPE_ENDPOINT:
+            ESP_RETURN_ON_FALSE(index->ep_cnt < CDC_PARSE_INDEX_EP_MAX, ESP_ERR_NOT_SUPPORTED, TAG, "Too many endpoints");
+            index->ep[index->ep_cnt++] = offset;
+            in_func_run = false;
+            break;
+        case USB_B_DESCRIPTOR_TYPE_INTERFACE_ASSOCIATION:
+            ESP_RETURN_ON_FALSE(index->iad_cnt < CDC_PARSE_INDEX_IAD_MAX, ESP_ERR_NOT_SUPPORTED, TAG, "Too many IADs");
+            index->iad[index->iad_cnt++] = offset;
+            in_func_run = false;
+            break;
+        case ((USB_CLASS_COMM << 4) | USB_B_DESCRIPTOR_TYPE_INTERFACE):
+            // CDC specific descriptors should be right after CDC-Communication interface descriptor
+            if (in_func_run) {
+                ESP_RETURN_ON_FALSE(index->func_cnt < CDC_PARSE_INDEX_FUNC_MAX, ESP_ERR_NOT_SUPPORTED, TAG, "Too many functional descriptors");
+                index->func[index->func_cnt++] = offset;
+                index->intf[index->intf_cnt - 1].func_cnt++;
+            }
+            break;
+        default:
+            in_func_run = false;
+            break;
+        }
+        offset += this_desc->bLength;
+    }
+
+    index->wTotalLength = config_desc->wTotalLength;
+    index->config_hash = config_hash;
+    index->valid = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief Find interface in the index
+ *
+ * Same lookup as usb_parse_interface_descriptor(): alternate settings are searched from the first
+ * Interface descriptor of bInterfaceNumber, until Interface descriptor of the next interface number.
+ *
+ * @param[in] bInterfaceNumber  Interface number
+ * @param[in] bAlternateSetting Alternate setting
+ * @return Index of the interface in config_index.intf[], -1 if not found
+ */
+static int cdc_parse_index_intf_find(uint8_t bInterfaceNumber, uint8_t bAlternateSetting)
+{
+    const cdc_parse_index_t *index = &config_index;
+    int i = 0;
+    while (i < index->intf_cnt && index->intf[i].bInterfaceNumber != bInterfaceNumber) {
+        i++;
+    }
+    for (; i < index->intf_cnt; i++) {
+        if (index->intf[i].bInterfaceNumber == bInterfaceNumber + 1) {
+            return -1; // We've walked past our target bInterfaceNumber
+        }
+        if (index->intf[i].bAlternateSetting == bAlternateSetting) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Get number of alternate settings of interface
+ *
+ * @param[in] bInterfaceNumber Interface number
+ * @return Number of alternate settings other than 0, -1 if the interface was not found
+ */
+static int cdc_parse_index_alternate_count(uint8_t bInterfaceNumber)
+{
+    const cdc_parse_index_t *index = &config_index;
+    const int first = cdc_parse_index_intf_find(bInterfaceNumber, 0);
+    if (first < 0) {
+        return -1;
+    }
+    int num_alt_setting = 0;
+    for (int i = first + 1; i < index->intf_cnt && index->intf[i].bInterfaceNumber == bInterfaceNumber; i++) {
+        num_alt_setting++;
+    }
+    return num_alt_setting;
+}
+
 /**
- * @brief Searches interface by index and verifies its CDC-compliance
+ * @brief Get endpoint of interface
+ *
+ * @param[in] config_desc Pointer to Configuration descriptor
+ * @param[in] intf        Index of the interface in config_index.intf[]
+ * @param[in] ep_idx      Index of the endpoint within the interface
+ * @return Pointer to Endpoint descriptor, NULL if the interface has fewer endpoints
+ */
+static const usb_ep_desc_t *cdc_parse_index_ep_get(const usb_config_desc_t *config_desc, int intf, int ep_idx)
+{
+    // Endpoints of this interface end where endpoints of the next Interface descriptor begin
+    const int ep_end = (intf + 1 < config_index.intf_cnt) ? config_index.intf[intf + 1].ep_first : config_index.ep_cnt;
+    const int i = config_index.intf[intf].ep_first + ep_idx;
+    return (i < ep_end) ? cdc_parse_cache_ptr(config_desc, config_index.ep[i]) : NULL;
+}
+
+/**
+ * @brief Verifies CDC-compliance of interface
  *
  * @param[in] device_desc Pointer to Device descriptor
  * @param[in] config_desc Pointer do Configuration descriptor
+ * @param[in] intf_desc   Pointer to the required interface descriptor
  * @param[in] intf_idx    Index of the required interface
  * @return true  The required interface is CDC compliant
  * @return false The required interface is NOT CDC compliant
  */
-static bool cdc_parse_is_cdc_compliant(const usb_device_desc_t *device_desc, const usb_config_desc_t *config_desc, uint8_t intf_idx)
+static bool cdc_parse_is_cdc_compliant(const usb_device_desc_t *device_desc, const usb_config_desc_t *config_desc, const usb_intf_desc_t *intf_desc, uint8_t intf_idx)
 {
-    int desc_offset = 0;
-
     if (device_desc->bDeviceClass == USB_CLASS_PER_INTERFACE ||
             device_desc->bDeviceClass == USB_CLASS_COMM) {
-        const usb_intf_desc_t *intf_desc = usb_parse_interface_descriptor(config_desc, intf_idx, 0, NULL);
         if (intf_desc->bInterfaceClass == USB_CLASS_COMM) {
             // 1. This is a Communication Device Class: Class defined in Interface descriptor
             return true;
@@ -49,81 +274,68 @@ static bool cdc_parse_is_cdc_compliant(const usb_device_desc_t *device_desc, con
             (device_desc->bDeviceProtocol == USB_DEVICE_PROTOCOL_IAD)) ||
             ((device_desc->bDeviceClass == USB_CLASS_PER_INTERFACE) && (device_desc->bDeviceSubClass == USB_SUBCLASS_NULL) &&
              (device_desc->bDeviceProtocol == USB_PROTOCOL_NULL))) {
-        const usb_standard_desc_t *this_desc = (const usb_standard_desc_t *)config_desc;
-        while ((this_desc = usb_parse_next_descriptor_of_type(this_desc, config_desc->wTotalLength, USB_B_DESCRIPTOR_TYPE_INTERFACE_ASSOCIATION, &desc_offset))) {
-            const usb_iad_desc_t *iad_desc = (const usb_iad_desc_t *)this_desc;
+        for (int i = 0; i < config_index.iad_cnt; i++) {
+            const usb_iad_desc_t *iad_desc = cdc_parse_cache_ptr(config_desc, config_index.iad[i]);
             if ((iad_desc->bFirstInterface == intf_idx) &&
                     (iad_desc->bInterfaceCount == 2) &&
                     (iad_desc->bFunctionClass == USB_CLASS_COMM)) {
                 // 2. This is a composite device, that uses Interface Association Descriptor
                 return true;
             }
-        };
+        }
     }
     return false;
 }
 
 /**
- * @brief Parse CDC functional descriptors
+ * @brief Get CDC functional descriptors
  *
- * @attention The driver must take care of memory freeing
- * @param[in] intf_desc   Pointer to Notification interface descriptor
- * @param[in] total_len   wTotalLength of the Configuration descriptor
- * @param[in] desc_offset Offset of the intf_desc in the Configuration descriptor in bytes
- * @param[out] desc_cnt   Number of Functional descriptors found
- * @return Pointer to array of pointers to Functional descriptors
+ * @param[in] config_desc Pointer do Configuration descriptor
+ * @param[in] intf        Index of the Notification interface in config_index.intf[]
+ * @param[out] info_ret   Parsed information, func and func_cnt are filled
  */
-static cdc_func_array_t *cdc_parse_functional_descriptors(const usb_intf_desc_t *intf_desc, uint16_t total_len, int desc_offset, int *desc_cnt)
+static void cdc_parse_functional_descriptors(const usb_config_desc_t *config_desc, int intf, cdc_parsed_info_t *info_ret)
 {
-    // CDC specific descriptors should be right after CDC-Communication interface descriptor
-    // Note: That's why we use usb_parse_next_descriptor instead of usb_parse_next_descriptor_of_type.
-    // The latter could return CDC specific descriptors that don't belong to this interface
-    int func_desc_cnt = 0;
-    int intf_offset = desc_offset;
-    const usb_standard_desc_t *cdc_desc = (const usb_standard_desc_t *)intf_desc;
-    while ((cdc_desc = usb_parse_next_descriptor(cdc_desc, total_len, &intf_offset))) {
-        if (cdc_desc->bDescriptorType != ((USB_CLASS_COMM << 4) | USB_B_DESCRIPTOR_TYPE_INTERFACE )) {
-            if (func_desc_cnt == 0) {
-                return NULL; // There are no CDC specific descriptors
-            } else {
-                break;       // We found all CDC specific descriptors
-            }
-        }
-        func_desc_cnt++;
+    const cdc_parse_index_intf_t *intf_entry = &config_index.intf[intf];
+    int func_desc_cnt = intf_entry->func_cnt;
+    if (func_desc_cnt > CDC_FUNC_DESC_MAX) {
+        ESP_LOGW(TAG, "Interface has %d functional descriptors, only first %d are used", func_desc_cnt, CDC_FUNC_DESC_MAX);
+        func_desc_cnt = CDC_FUNC_DESC_MAX;
     }
 
-    // Allocate memory for the functional descriptors pointers
-    cdc_func_array_t *func_desc = malloc(func_desc_cnt * (sizeof(usb_standard_desc_t *)));
-    if (!func_desc) {
-        ESP_LOGD(TAG, "Out of mem for functional descriptors");
-        return NULL;
-    }
-
-    // Save the descriptors
-    intf_offset = desc_offset; // Reset the offset counter
-    cdc_desc = (const usb_standard_desc_t *)intf_desc;
     for (int i = 0; i < func_desc_cnt; i++) {
-        cdc_desc = (const usb_standard_desc_t *)usb_parse_next_descriptor(cdc_desc, total_len, &intf_offset);
-        (*func_desc)[i] = cdc_desc;
+        const uint16_t offset = config_index.func[intf_entry->func_first + i];
+        const cdc_header_desc_t *func_desc = cdc_parse_cache_ptr(config_desc, offset);
+        info_ret->func[i].offset = offset;
+        info_ret->func[i].subtype = func_desc->bDescriptorSubtype;
     }
-    *desc_cnt = func_desc_cnt;
-    return func_desc;
+    info_ret->func_cnt = func_desc_cnt;
 }
 
-esp_err_t cdc_parse_interface_descriptor(const usb_device_desc_t *device_desc, const usb_config_desc_t *config_desc, uint8_t intf_idx, cdc_parsed_info_t *info_ret)
+/**
+ * @brief Parse CDC interface descriptor using the index of Configuration descriptor
+ *
+ * @param[in] device_desc Pointer to Device descriptor
+ * @param[in] config_desc Pointer do Configuration descriptor
+ * @param[in] config_hash Hash of the Configuration descriptor
+ * @param[in] intf_idx    Index of the required interface
+ * @param[out] info_ret   Array of parsed information, see cdc_parsed_info_t
+ * @return see cdc_parse_interface_descriptor()
+ */
+static esp_err_t cdc_parse_interface_indexed(const usb_device_desc_t *device_desc, const usb_config_desc_t *config_desc, uint32_t config_hash, uint8_t intf_idx, cdc_parsed_info_t *info_ret)
 {
-    int desc_offset = 0;
-
     memset(info_ret, 0, sizeof(cdc_parsed_info_t));
-    const usb_intf_desc_t *first_intf_desc = usb_parse_interface_descriptor(config_desc, intf_idx, 0, &desc_offset);
+    ESP_RETURN_ON_ERROR(cdc_parse_index_build(config_desc, config_hash), TAG, "Could not index Configuration descriptor");
+
+    const int first_intf = cdc_parse_index_intf_find(intf_idx, 0);
     ESP_RETURN_ON_FALSE(
-        first_intf_desc,
+        first_intf >= 0,
         ESP_ERR_NOT_FOUND, TAG, "Required interface no %d was not found.", intf_idx);
+    const usb_intf_desc_t *first_intf_desc = cdc_parse_cache_ptr(config_desc, config_index.intf[first_intf].offset);
 
-    int temp_offset = desc_offset;
     for (int i = 0; i < first_intf_desc->bNumEndpoints; i++) {
-        const usb_ep_desc_t *this_ep = usb_parse_endpoint_descriptor_by_index(first_intf_desc, i, config_desc->wTotalLength, &desc_offset);
-        assert(this_ep);
+        const usb_ep_desc_t *this_ep = cdc_parse_index_ep_get(config_desc, first_intf, i);
+        ESP_RETURN_ON_FALSE(this_ep, ESP_ERR_NOT_FOUND, TAG, "Interface no %d has fewer endpoints than bNumEndpoints", intf_idx);
 
         if (USB_EP_DESC_GET_XFERTYPE(this_ep) == USB_TRANSFER_TYPE_INTR) {
             info_ret->notif_intf = first_intf_desc;
@@ -136,13 +348,12 @@ esp_err_t cdc_parse_interface_descriptor(const usb_device_desc_t *device_desc, c
                 info_ret->out_ep = this_ep;
             }
         }
-        desc_offset = temp_offset;
     }
 
-    const bool cdc_compliant = cdc_parse_is_cdc_compliant(device_desc, config_desc, intf_idx);
+    const bool cdc_compliant = cdc_parse_is_cdc_compliant(device_desc, config_desc, first_intf_desc, intf_idx);
     if (cdc_compliant) {
         info_ret->notif_intf = first_intf_desc; // We make sure that intf_desc is set for CDC compliant devices that use EP0 as notification element
-        info_ret->func = cdc_parse_functional_descriptors(first_intf_desc, config_desc->wTotalLength, desc_offset, &info_ret->func_cnt);
+        cdc_parse_functional_descriptors(config_desc, first_intf, info_ret);
     }
 
     if (!info_ret->data_intf && cdc_compliant) {
@@ -150,14 +361,17 @@ esp_err_t cdc_parse_interface_descriptor(const usb_device_desc_t *device_desc, c
         // Some devices offer alternate settings for data interface:
         // First interface with 0 endpoints (default control pipe only) and second with standard 2 endpoints for full-duplex data
         // We always select interface with 2 bulk endpoints
-        const int num_of_alternate = usb_parse_interface_number_of_alternate(config_desc, intf_idx + 1);
+        const int num_of_alternate = cdc_parse_index_alternate_count(intf_idx + 1);
         for (int i = 0; i < num_of_alternate + 1; i++) {
-            const usb_intf_desc_t *second_intf_desc = usb_parse_interface_descriptor(config_desc, intf_idx + 1, i, &desc_offset);
-            temp_offset = desc_offset;
-            if (second_intf_desc && second_intf_desc->bNumEndpoints == 2) {
-                for (int i = 0; i < second_intf_desc->bNumEndpoints; i++) {
-                    const usb_ep_desc_t *this_ep = usb_parse_endpoint_descriptor_by_index(second_intf_desc, i, config_desc->wTotalLength, &desc_offset);
-                    assert(this_ep);
+            const int second_intf = cdc_parse_index_intf_find(intf_idx + 1, i);
+            if (second_intf < 0) {
+                continue;
+            }
+            const usb_intf_desc_t *second_intf_desc = cdc_parse_cache_ptr(config_desc, config_index.intf[second_intf].offset);
+            if (second_intf_desc->bNumEndpoints == 2) {
+                for (int j = 0; j < second_intf_desc->bNumEndpoints; j++) {
+                    const usb_ep_desc_t *this_ep = cdc_parse_index_ep_get(config_desc, second_intf, j);
+                    ESP_RETURN_ON_FALSE(this_ep, ESP_ERR_NOT_FOUND, TAG, "Interface no %d has fewer endpoints than bNumEndpoints", intf_idx + 1);
                     if (USB_EP_DESC_GET_XFERTYPE(this_ep) == USB_TRANSFER_TYPE_BULK) {
                         info_ret->data_intf = second_intf_desc;
                         if (USB_EP_DESC_GET_EP_DIR(this_ep)) {
@@ -166,7 +380,6 @@ esp_err_t cdc_parse_interface_descriptor(const usb_device_desc_t *device_desc, c
                             info_ret->out_ep = this_ep;
                         }
                     }
-                    desc_offset = temp_offset;
                 }
                 break;
             }
@@ -177,6 +390,87 @@ esp_err_t cdc_parse_interface_descriptor(const usb_device_desc_t *device_desc, c
     return (info_ret->in_ep && info_ret->out_ep) ? ESP_OK : ESP_ERR_NOT_FOUND;
 }
 
+esp_err_t cdc_parse_interface_descriptor(const usb_device_desc_t *device_desc, const usb_config_desc_t *config_desc, uint8_t intf_idx, cdc_parsed_info_t *info_ret)
+{
+    return cdc_parse_interface_indexed(device_desc, config_desc, cdc_parse_config_hash(config_desc), intf_idx, info_ret);
+}
+
+/**
+ * @brief Convert descriptor pointer to offset in Configuration descriptor
+ *
+ * @param[in] config_desc Pointer to Configuration descriptor
+ * @param[in] desc        Pointer to the descriptor, can be NULL
+ * @return Offset of the descriptor, 0 for NULL
+ */
+static inline uint16_t cdc_parse_cache_offset(const usb_config_desc_t *config_desc, const void *desc)
+{
+    return desc ? (uint16_t)((const uint8_t *)desc - (const uint8_t *)config_desc) : 0;
+}
+
+esp_err_t cdc_parse_interface_descriptor_cached(const usb_device_desc_t *device_desc, const usb_config_desc_t *config_desc, uint8_t intf_idx, cdc_parsed_info_t *info_ret)
+{
+    const uint32_t config_hash = cdc_parse_config_hash(config_desc);
+    cdc_parse_cache_entry_t *entry = NULL;
+    cdc_parse_cache_entry_t *lru = &parse_cache[0];
+    for (int i = 0; i < CDC_PARSE_CACHE_SIZE; i++) {
+        cdc_parse_cache_entry_t *this_entry = &parse_cache[i];
+        if (this_entry->valid &&
+                (this_entry->idVendor == device_desc->idVendor) &&
+                (this_entry->idProduct == device_desc->idProduct) &&
+                (this_entry->bcdDevice == device_desc->bcdDevice) &&
+                (this_entry->intf_idx == intf_idx) &&
+                (this_entry->wTotalLength == config_desc->wTotalLength) &&
+                (this_entry->config_hash == config_hash)) {
+            entry = this_entry;
+            break;
+        }
+        if (!this_entry->valid || (lru->valid && (this_entry->last_use < lru->last_use))) {
+            lru = this_entry;
+        }
+    }
+
+    if (entry) {
+        // Cache hit: only rebuild the pointers
+        memset(info_ret, 0, sizeof(cdc_parsed_info_t));
+        memcpy(info_ret->func, entry->func, entry->func_cnt * sizeof(cdc_func_desc_t));
+        info_ret->func_cnt = entry->func_cnt;
+        info_ret->notif_ep = cdc_parse_cache_ptr(config_desc, entry->notif_ep);
+        info_ret->in_ep = cdc_parse_cache_ptr(config_desc, entry->in_ep);
+        info_ret->out_ep = cdc_parse_cache_ptr(config_desc, entry->out_ep);
+        info_ret->notif_intf = cdc_parse_cache_ptr(config_desc, entry->notif_intf);
+        info_ret->data_intf = cdc_parse_cache_ptr(config_desc, entry->data_intf);
+        entry->last_use = ++cache_use_cnt;
+        return ESP_OK;
+    }
+
+    // Cache miss: parse the descriptors and replace the least recently used entry
+    ESP_RETURN_ON_ERROR(cdc_parse_interface_indexed(device_desc, config_desc, config_hash, intf_idx, info_ret), TAG,);
+    *lru = (cdc_parse_cache_entry_t) {
+        .valid = true,
+        .last_use = ++cache_use_cnt,
+        .idVendor = device_desc->idVendor,
+        .idProduct = device_desc->idProduct,
+        .bcdDevice = device_desc->bcdDevice,
+        .intf_idx = intf_idx,
+        .wTotalLength = config_desc->wTotalLength,
+        .config_hash = config_hash,
+        .notif_ep = cdc_parse_cache_offset(config_desc, info_ret->notif_ep),
+        .in_ep = cdc_parse_cache_offset(config_desc, info_ret->in_ep),
+        .out_ep = cdc_parse_cache_offset(config_desc, info_ret->out_ep),
+        .notif_intf = cdc_parse_cache_offset(config_desc, info_ret->notif_intf),
+        .data_intf = cdc_parse_cache_offset(config_desc, info_ret->data_intf),
+        .func_cnt = info_ret->func_cnt,
+    };
+    memcpy(lru->func, info_ret->func, info_ret->func_cnt * sizeof(cdc_func_desc_t));
+    return ESP_OK;
+}
+
+void cdc_parse_cache_clear(void)
+{
+    memset(parse_cache, 0, sizeof(parse_cache));
+    config_index.valid = false;
+}
+
 void cdc_print_desc(const usb_standard_desc_t *_desc)
 {
     if (_desc->bDescriptorType != ((USB_CLASS_COMM << 4) | USB_B_DESCRIPTOR_TYPE_INTERFACE )) {
@@ -0,0 +1,115 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "cdc_host_rx_ring.h"
+
+// Indexes run in range <0, 2 * size) so that a full ring can be distinguished from an empty one
+static inline size_t ring_advance(const cdc_rx_ring_t *ring, size_t idx, size_t len)
+{
+    idx += len;
+    return (idx >= 2 * ring->size) ? idx - 2 * ring->size : idx;
+}
+
+static inline size_t ring_used(const cdc_rx_ring_t *ring, size_t head, size_t tail)
+{
+    return (head >= tail) ? head - tail : head + 2 * ring->size - tail;
+}
+
+esp_err_t cdc_rx_ring_init(cdc_rx_ring_t *ring, size_t size, bool linear, uint8_t *storage)
+{
+    if (size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ring->buf_owned = (storage == NULL);
+    ring->buf = storage ? storage : malloc(linear ? 2 * size : size);
+    if (ring->buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ring->size = size;
+    ring->linear = linear;
+    ring->linear_len = 0;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return ESP_OK;
+}
+
+void cdc_rx_ring_deinit(cdc_rx_ring_t *ring)
+{
+    if (ring->buf_owned) {
+        free(ring->buf);
+    }
+    ring->buf = NULL;
+    ring->size = 0;
+}
+
+size_t cdc_rx_ring_write(cdc_rx_ring_t *ring, const uint8_t *data, size_t len)
+{
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    const size_t space = ring->size - ring_used(ring, head, tail);
+    if (len > space) {
+        len = space;
+    }
+
+    // Copy in up to two parts, if the data wrap around the end of the ring
+    const size_t offset = head % ring->size;
+    const size_t first = (len < ring->size - offset) ? len : ring->size - offset;
+    memcpy(ring->buf + offset, data, first);
+    memcpy(ring->buf, data + first, len - first);
+
+    atomic_store_explicit(&ring->head, ring_advance(ring, head, len), memory_order_release);
+    return len;
+}
+
+size_t cdc_rx_ring_peek(cdc_rx_ring_t *ring, const uint8_t **data)
+{
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    const size_t used = ring_used(ring, head, tail);
+    const size_t offset = tail % ring->size;
+
+    *data = ring->buf + offset;
+    return (used < ring->size - offset) ? used : ring->size - offset;
+}
+
+size_t cdc_rx_ring_peek_all(cdc_rx_ring_t *ring, const uint8_t **data)
+{
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    const size_t used = ring_used(ring, head, tail);
+    const size_t offset = tail % ring->size;
+
+    // Unread data at the start of the ring are not overwritten by the producer, so they can be copied without locking
+    if (used > ring->size - offset) {
+        const size_t wrapped = used - (ring->size - offset);
+        if (wrapped > ring->linear_len) {
+            memcpy(ring->buf + ring->size + ring->linear_len, ring->buf + ring->linear_len, wrapped - ring->linear_len);
+            ring->linear_len = wrapped;
+        }
+    }
+
+    *data = ring->buf + offset;
+    return used;
+}
+
+void cdc_rx_ring_consume(cdc_rx_ring_t *ring, size_t len)
+{
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (len >= ring->size - tail % ring->size) {
+        // The copy behind the end of the ring is no longer needed
+        ring->linear_len = 0;
+    }
+    atomic_store_explicit(&ring->tail, ring_advance(ring, tail, len), memory_order_release);
+}
+
+size_t cdc_rx_ring_used(cdc_rx_ring_t *ring)
+{
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return ring_used(ring, head, tail);
+}
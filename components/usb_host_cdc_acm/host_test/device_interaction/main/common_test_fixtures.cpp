@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <catch2/catch_test_macros.hpp>
+#include "sdkconfig.h"
 #include "usb/cdc_acm_host.h"
 #include "mock_add_usb_device.h"
 #include "common_test_fixtures.hpp"
@@ -30,6 +31,9 @@ typedef struct {
     struct {
         usb_transfer_t *out_xfer;
         usb_transfer_t *in_xfer;
+        uint8_t in_xfer_num;
+        uint8_t in_xfer_spare_num;
+        uint8_t out_xfer_num;
         uint8_t in_bEndpointAddress;
         uint8_t out_bEndpointAddress;
     } data;
@@ -85,15 +89,21 @@ static esp_err_t _test_create_cmock_expectations(uint8_t dev_address, uint8_t in
     // Check, if IN data transfer is allocated
     if (dev_config->in_buffer_size) {
         cdc_dev_expects->data.in_xfer = reinterpret_cast<usb_transfer_t *>(&data_in_xfer);
+        cdc_dev_expects->data.in_xfer_num = (dev_config->in_transfer_count == 0) ? 1 : dev_config->in_transfer_count;
+        cdc_dev_expects->data.in_xfer_spare_num = dev_config->rx_loan_count;
     } else {
         cdc_dev_expects->data.in_xfer = nullptr;
+        cdc_dev_expects->data.in_xfer_num = 0;
+        cdc_dev_expects->data.in_xfer_spare_num = 0;
     }
 
     // Check if OUT data transfer is allocated
     if (dev_config->out_buffer_size) {
         cdc_dev_expects->data.out_xfer = reinterpret_cast<usb_transfer_t *>(&data_out_xfer);
+        cdc_dev_expects->data.out_xfer_num = (dev_config->out_transfer_count == 0) ? 1 : dev_config->out_transfer_count;
     } else {
         cdc_dev_expects->data.out_xfer = nullptr;
+        cdc_dev_expects->data.out_xfer_num = 0;
     }
 
     p_cdc_dev_expects = cdc_dev_expects;
@@ -131,6 +141,11 @@ esp_err_t test_cdc_acm_host_uninstall(void)
 
     _test_delete_cmock_expectations();
 
+#if CONFIG_CDC_ACM_STATIC_POOL
+    // Free transfers kept by the static pool
+    test_usb_host_transfer_free(0);
+#endif
+
     // Call the real function, cdc_acm_host_uninstall()
     return cdc_acm_host_uninstall();
 }
@@ -166,26 +181,10 @@ esp_err_t test_cdc_acm_host_open(uint8_t dev_address, uint16_t vid, uint16_t pid
     usb_host_get_active_config_descriptor_ExpectAnyArgsAndReturn(ESP_OK);
     usb_host_get_active_config_descriptor_AddCallback(usb_host_get_active_config_descriptor_mock_callback);
 
-    // Setup control transfer
-    usb_host_transfer_alloc_ExpectAnyArgsAndReturn(ESP_OK);
-
-    // Setup Notif transfer
-    if (p_cdc_dev_expects->notif.xfer) {
-        usb_host_transfer_alloc_ExpectAnyArgsAndReturn(ESP_OK);
-    }
-
-    //  Setup IN data transfer
-    if (dev_config->in_buffer_size) {
-        usb_host_transfer_alloc_ExpectAnyArgsAndReturn(ESP_OK);
-    }
-
-    // Setup OUT bulk transfer
-    if (dev_config->out_buffer_size) {
-        usb_host_transfer_alloc_ExpectAnyArgsAndReturn(ESP_OK);
-    }
-
-    // Register callback
-    usb_host_transfer_alloc_AddCallback(usb_host_transfer_alloc_mock_callback);
+    // Setup control transfer, Notif transfer, IN data transfers, spare IN data transfers and OUT bulk transfers
+    test_usb_host_transfer_alloc(1 + (p_cdc_dev_expects->notif.xfer ? 1 : 0)
+                                 + p_cdc_dev_expects->data.in_xfer_num + p_cdc_dev_expects->data.in_xfer_spare_num
+                                 + p_cdc_dev_expects->data.out_xfer_num);
 
     // Call cdc_acm_start
 
@@ -193,6 +192,11 @@ esp_err_t test_cdc_acm_host_open(uint8_t dev_address, uint16_t vid, uint16_t pid
     // Make sure that the interface_index has been claimed
     test_usb_host_interface_claim(interface_index);
 
+    // Submit the remaining IN data transfers
+    for (int i = 1; i < p_cdc_dev_expects->data.in_xfer_num; i++) {
+        usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+    }
+
     // Claim notification interface (if supported)
     if (p_cdc_dev_expects->notif.xfer) {
         test_usb_host_interface_claim(interface_index);
@@ -225,28 +229,22 @@ esp_err_t test_cdc_acm_host_close(cdc_acm_dev_hdl_t *cdc_hdl, uint8_t interface_
     usb_host_interface_release_IgnoreArg_dev_hdl();
 
 
-    // Free notif transfer
+    // Free notif transfer, in transfers, spare in transfers, out transfers
+    // and ctrl transfer (in cdc_acm_device_remove)
+    int xfer_num = 1;
     if (p_cdc_dev_expects->notif.xfer) {
-        usb_host_transfer_free_ExpectAnyArgsAndReturn(ESP_OK);
+        xfer_num++;
         p_cdc_dev_expects->notif.xfer = nullptr;
     }
-
-    // Free in transfer
     if (p_cdc_dev_expects->data.in_xfer) {
-        usb_host_transfer_free_ExpectAnyArgsAndReturn(ESP_OK);
+        xfer_num += p_cdc_dev_expects->data.in_xfer_num + p_cdc_dev_expects->data.in_xfer_spare_num;
         p_cdc_dev_expects->data.in_xfer = nullptr;
     }
-
-    // Free out transfer
     if (p_cdc_dev_expects->data.out_xfer) {
-        usb_host_transfer_free_ExpectAnyArgsAndReturn(ESP_OK);
+        xfer_num += p_cdc_dev_expects->data.out_xfer_num;
         p_cdc_dev_expects->data.out_xfer = nullptr;
     }
-
-    // Call cdc_acm_device_remove
-    // Free ctrl transfer
-    usb_host_transfer_free_ExpectAnyArgsAndReturn(ESP_OK);
-    usb_host_transfer_free_AddCallback(usb_host_transfer_free_mock_callback);
+    test_usb_host_transfer_free(xfer_num);
 
     usb_host_device_close_ExpectAnyArgsAndReturn(ESP_OK);
 
@@ -254,6 +252,14 @@ esp_err_t test_cdc_acm_host_close(cdc_acm_dev_hdl_t *cdc_hdl, uint8_t interface_
     return cdc_acm_host_close(*cdc_hdl);
 }
 
+static usb_transfer_t *timed_out_xfer = nullptr; // OUT transfer that never completes, until the endpoint is reset
+
+static esp_err_t _submit_timeout_record_callback(usb_transfer_t *transfer, int call_count)
+{
+    timed_out_xfer = transfer;
+    return usb_host_transfer_submit_timeout_mock_callback(transfer, call_count);
+}
+
 esp_err_t test_cdc_acm_host_data_tx_blocking(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, uint32_t timeout_ms, mock_usb_transfer_response_t transfer_response)
 {
     usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
@@ -271,7 +277,7 @@ esp_err_t test_cdc_acm_host_data_tx_blocking(cdc_acm_dev_hdl_t cdc_hdl, const ui
     }
     case MOCK_USB_TRANSFER_TIMEOUT: {
         // Make the submitted transfer to be timed out
-        usb_host_transfer_submit_AddCallback(usb_host_transfer_submit_timeout_mock_callback);
+        usb_host_transfer_submit_AddCallback(_submit_timeout_record_callback);
         // Reset out endpoint
         test_cdc_acm_reset_transfer_endpoint(p_cdc_dev_expects->data.out_bEndpointAddress);
         break;
@@ -281,7 +287,16 @@ esp_err_t test_cdc_acm_host_data_tx_blocking(cdc_acm_dev_hdl_t cdc_hdl, const ui
     }
 
     // Call the real function cdc_acm_host_data_tx_blocking()
-    return cdc_acm_host_data_tx_blocking(cdc_hdl, data, data_len, timeout_ms);
+    const esp_err_t ret = cdc_acm_host_data_tx_blocking(cdc_hdl, data, data_len, timeout_ms);
+
+    // Endpoint reset returns the timed out transfer to the driver as canceled
+    if (timed_out_xfer) {
+        timed_out_xfer->status = USB_TRANSFER_STATUS_CANCELED;
+        timed_out_xfer->actual_num_bytes = 0;
+        timed_out_xfer->callback(timed_out_xfer);
+        timed_out_xfer = nullptr;
+    }
+    return ret;
 }
 
 esp_err_t test_cdc_acm_reset_transfer_endpoint(uint8_t ep_address)
@@ -309,3 +324,31 @@ esp_err_t test_usb_host_interface_claim(uint8_t interface_index)
 
     return ESP_OK;
 }
+
+esp_err_t test_usb_host_transfer_alloc(int xfer_num)
+{
+#if CONFIG_CDC_ACM_STATIC_POOL
+    // Transfers kept by the static pool are reused, the driver allocates only the missing ones
+    usb_host_transfer_alloc_Stub(usb_host_transfer_alloc_mock_callback);
+#else
+    for (int i = 0; i < xfer_num; i++) {
+        usb_host_transfer_alloc_ExpectAnyArgsAndReturn(ESP_OK);
+    }
+    usb_host_transfer_alloc_AddCallback(usb_host_transfer_alloc_mock_callback);
+#endif
+    return ESP_OK;
+}
+
+esp_err_t test_usb_host_transfer_free(int xfer_num)
+{
+#if CONFIG_CDC_ACM_STATIC_POOL
+    // Transfers are kept by the static pool on close and freed on driver uninstall
+    usb_host_transfer_free_Stub(usb_host_transfer_free_mock_callback);
+#else
+    for (int i = 0; i < xfer_num; i++) {
+        usb_host_transfer_free_ExpectAnyArgsAndReturn(ESP_OK);
+    }
+    usb_host_transfer_free_AddCallback(usb_host_transfer_free_mock_callback);
+#endif
+    return ESP_OK;
+}
@@ -134,3 +134,29 @@ esp_err_t test_cdc_acm_reset_transfer_endpoint(uint8_t ep_address);
  *   - ESP_OK: Interface claim successful
  */
 esp_err_t test_usb_host_interface_claim(uint8_t interface_index);
+
+/**
+ * @brief Host test fixture function, allocate USB transfers
+ *
+ * Expect xfer_num calls of usb_host_transfer_alloc().
+ * With CONFIG_CDC_ACM_STATIC_POOL the number of calls is not checked, because the driver reuses transfers kept by the pool
+ *
+ * @param xfer_num[in] Number of transfers to be allocated
+ *
+ * @return:
+ *   - ESP_OK: Expectations created
+ */
+esp_err_t test_usb_host_transfer_alloc(int xfer_num);
+
+/**
+ * @brief Host test fixture function, free USB transfers
+ *
+ * Expect xfer_num calls of usb_host_transfer_free().
+ * With CONFIG_CDC_ACM_STATIC_POOL the number of calls is not checked, because the transfers are kept by the pool
+ *
+ * @param xfer_num[in] Number of transfers to be freed
+ *
+ * @return:
+ *   - ESP_OK: Expectations created
+ */
+esp_err_t test_usb_host_transfer_free(int xfer_num);
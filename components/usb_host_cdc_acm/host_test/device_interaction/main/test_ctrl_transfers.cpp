@@ -0,0 +1,405 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "descriptors/cdc_descriptors.hpp"
+#include "usb/cdc_acm_host.h"
+#include "usb/usb_types_cdc.h"
+#include "mock_add_usb_device.h"
+#include "common_test_fixtures.hpp"
+
+extern "C" {
+#include "Mockusb_host.h"
+}
+
+static std::deque<usb_transfer_t *> ctrl_flight;   // Submitted CTRL transfers, in order of submission
+static std::vector<uint8_t> ctrl_requests;          // bRequest of submitted CTRL transfers
+static std::vector<esp_err_t> ctrl_status;          // Statuses reported to the CTRL completion callback
+static std::vector<std::vector<uint8_t>> ctrl_data; // Data reported to the CTRL completion callback
+
+/**
+ * @brief Record submitted CTRL transfers instead of completing them
+ */
+static esp_err_t _submit_control_record_callback(usb_host_client_handle_t client_hdl, usb_transfer_t *transfer, int call_count)
+{
+    const usb_setup_packet_t *setup = (const usb_setup_packet_t *)transfer->data_buffer;
+    ctrl_flight.push_back(transfer);
+    ctrl_requests.push_back(setup->bRequest);
+    return ESP_OK;
+}
+
+/**
+ * @brief Emulate a device that accepts every CTRL request
+ */
+static esp_err_t _submit_control_complete_callback(usb_host_client_handle_t client_hdl, usb_transfer_t *transfer, int call_count)
+{
+    const usb_setup_packet_t *setup = (const usb_setup_packet_t *)transfer->data_buffer;
+    ctrl_requests.push_back(setup->bRequest);
+    transfer->status = USB_TRANSFER_STATUS_COMPLETED;
+    transfer->actual_num_bytes = transfer->num_bytes;
+    transfer->callback(transfer);
+    return ESP_OK;
+}
+
+static void _ctrl_done_cb(esp_err_t status, const uint8_t *data, size_t data_len, void *user_arg)
+{
+    ctrl_status.push_back(status);
+    ctrl_data.emplace_back(data, data + data_len);
+}
+
+/**
+ * @brief Complete the oldest submitted CTRL transfer
+ *
+ * @param[in] status   Status of the transfer
+ * @param[in] data     Data stage of IN request, can be NULL
+ * @param[in] data_len Length of data
+ */
+static void _complete_ctrl_transfer(usb_transfer_status_t status, const void *data, size_t data_len)
+{
+    REQUIRE_FALSE(ctrl_flight.empty());
+    usb_transfer_t *transfer = ctrl_flight.front();
+    ctrl_flight.pop_front();
+
+    if (data) {
+        memcpy(transfer->data_buffer + sizeof(usb_setup_packet_t), data, data_len);
+    }
+    transfer->status = status;
+    if (status != USB_TRANSFER_STATUS_COMPLETED) {
+        transfer->actual_num_bytes = 0;
+    } else {
+        transfer->actual_num_bytes = data ? sizeof(usb_setup_packet_t) + data_len : transfer->num_bytes;
+    }
+    transfer->callback(transfer);
+}
+
+static usb_transfer_t *notif_xfer = nullptr; // Notification transfer of the opened device
+
+/**
+ * @brief Record submitted notification transfer
+ */
+static esp_err_t _submit_notif_record_callback(usb_transfer_t *transfer, int call_count)
+{
+    if (transfer->bEndpointAddress == 0x81) { // CH340 notification endpoint
+        notif_xfer = transfer;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Emulate notification without data from the device
+ *
+ * @param[in] code Notification code
+ */
+static void _notify(cdc_notification_code_t code)
+{
+    REQUIRE(notif_xfer != nullptr);
+    cdc_notification_t *notif = (cdc_notification_t *)notif_xfer->data_buffer;
+    memset(notif, 0, sizeof(cdc_notification_t));
+    notif->bmRequestType = 0xA1;
+    notif->bNotificationCode = code;
+    notif_xfer->status = USB_TRANSFER_STATUS_COMPLETED;
+    notif_xfer->actual_num_bytes = sizeof(cdc_notification_t);
+
+    usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK); // Notification transfer is submitted again
+    notif_xfer->callback(notif_xfer);
+}
+
+SCENARIO("Asynchronous CTRL requests")
+{
+    SECTION("Add mocked device") {
+        usb_host_mock_dev_list_init();
+
+        // CH340 (FS descriptor), it has a notification endpoint, so it accepts CDC requests
+        REQUIRE(ESP_OK == usb_host_mock_add_device(9, (const usb_device_desc_t *)ch340_device_desc,
+                (const usb_config_desc_t *)ch340_config_desc));
+    }
+
+    GIVEN("Mocked device is added to the device list") {
+        REQUIRE(ESP_OK == test_cdc_acm_host_install(nullptr));
+
+        cdc_acm_dev_hdl_t dev = nullptr;
+        const cdc_acm_host_device_config_t dev_config = {
+            .connection_timeout_ms = 1000,
+            .out_buffer_size = 64,
+            .in_buffer_size = 64,
+            .event_cb = nullptr,
+            .data_cb = nullptr,
+            .user_arg = nullptr,
+            .encap_response_cb = _ctrl_done_cb,
+        };
+        const uint16_t vid = 0x1A86, pid = 0x7523;
+        const uint8_t device_address = 9, interface_index = 0;
+
+        ctrl_flight.clear();
+        ctrl_requests.clear();
+        ctrl_status.clear();
+        ctrl_data.clear();
+        notif_xfer = nullptr;
+        usb_host_transfer_submit_AddCallback(_submit_notif_record_callback);
+        REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+        REQUIRE(dev != nullptr);
+
+        SECTION("Queued requests are sent back-to-back") {
+            usb_host_transfer_submit_control_AddCallback(_submit_control_record_callback);
+            const cdc_acm_line_coding_t line_coding = {
+                .dwDTERate = 9600,
+                .bCharFormat = 0,
+                .bParityType = 0,
+                .bDataBits = 8,
+            };
+            for (int i = 0; i < 3; i++) {
+                usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            }
+            REQUIRE(ESP_OK == cdc_acm_host_line_coding_set_async(dev, &line_coding, _ctrl_done_cb, nullptr));
+            REQUIRE(ESP_OK == cdc_acm_host_set_control_line_state_async(dev, true, true, _ctrl_done_cb, nullptr));
+            REQUIRE(ESP_OK == cdc_acm_host_line_coding_get_async(dev, _ctrl_done_cb, nullptr));
+
+            // Only one request is in flight, the next one is submitted from the completion callback
+            REQUIRE(ctrl_flight.size() == 1);
+            REQUIRE(ctrl_requests == std::vector<uint8_t>({USB_CDC_REQ_SET_LINE_CODING}));
+            _complete_ctrl_transfer(USB_TRANSFER_STATUS_COMPLETED, nullptr, 0);
+            REQUIRE(ctrl_requests == std::vector<uint8_t>({USB_CDC_REQ_SET_LINE_CODING, USB_CDC_REQ_SET_CONTROL_LINE_STATE}));
+
+            // Failed request does not stop the queue
+            _complete_ctrl_transfer(USB_TRANSFER_STATUS_STALL, nullptr, 0);
+            REQUIRE(ctrl_requests.size() == 3);
+            REQUIRE(ctrl_requests[2] == USB_CDC_REQ_GET_LINE_CODING);
+
+            // Data of IN request are passed to the callback
+            _complete_ctrl_transfer(USB_TRANSFER_STATUS_COMPLETED, &line_coding, sizeof(line_coding));
+            REQUIRE(ctrl_status == std::vector<esp_err_t>({ESP_OK, ESP_ERR_INVALID_RESPONSE, ESP_OK}));
+            REQUIRE(ctrl_data[0].empty());
+            REQUIRE(ctrl_data[2] == std::vector<uint8_t>((const uint8_t *)&line_coding, (const uint8_t *)&line_coding + sizeof(line_coding)));
+            REQUIRE(ctrl_flight.empty());
+
+            // Blocking requests use the same CTRL transfer
+            usb_host_transfer_submit_control_AddCallback(_submit_control_complete_callback);
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_set_control_line_state(dev, false, false));
+        }
+
+        SECTION("Full request queue") {
+            usb_host_transfer_submit_control_AddCallback(_submit_control_record_callback);
+            const uint8_t vendor_data[] = {0x01, 0x02};
+            const int request_num = 9; // One request in flight and full queue
+            for (int i = 0; i < request_num; i++) {
+                usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+                REQUIRE(ESP_OK == cdc_acm_host_send_custom_request_async(dev, 0x40, i, 0, 0, sizeof(vendor_data), vendor_data, _ctrl_done_cb, nullptr));
+            }
+            REQUIRE(ESP_ERR_NO_MEM == cdc_acm_host_send_custom_request_async(dev, 0x40, 0, 0, 0, sizeof(vendor_data), vendor_data, _ctrl_done_cb, nullptr));
+            REQUIRE(ESP_ERR_INVALID_SIZE == cdc_acm_host_send_custom_request_async(dev, 0x40, 0, 0, 0, 100, vendor_data, _ctrl_done_cb, nullptr));
+
+            for (int i = 0; i < request_num; i++) {
+                _complete_ctrl_transfer(USB_TRANSFER_STATUS_COMPLETED, nullptr, 0);
+            }
+            REQUIRE(ctrl_status.size() == request_num);
+            for (int i = 0; i < request_num; i++) {
+                REQUIRE(ctrl_requests[i] == i);
+            }
+        }
+
+        SECTION("Unchanged port settings are not sent asynchronously") {
+            usb_host_transfer_submit_control_AddCallback(_submit_control_record_callback);
+            const cdc_acm_line_coding_t line_coding = {
+                .dwDTERate = 115200,
+                .bCharFormat = 0,
+                .bParityType = 0,
+                .bDataBits = 8,
+            };
+            cdc_acm_line_coding_t line_coding_2 = line_coding;
+            line_coding_2.dwDTERate = 9600;
+
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_line_coding_set_async(dev, &line_coding, _ctrl_done_cb, nullptr));
+            _complete_ctrl_transfer(USB_TRANSFER_STATUS_COMPLETED, nullptr, 0);
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_set_control_line_state_async(dev, true, false, _ctrl_done_cb, nullptr));
+            _complete_ctrl_transfer(USB_TRANSFER_STATUS_COMPLETED, nullptr, 0);
+
+            // Identical settings complete immediately, without a request
+            REQUIRE(ESP_OK == cdc_acm_host_line_coding_set_async(dev, &line_coding, _ctrl_done_cb, nullptr));
+            REQUIRE(ESP_OK == cdc_acm_host_set_control_line_state_async(dev, true, false, _ctrl_done_cb, nullptr));
+            REQUIRE(ctrl_flight.empty());
+            REQUIRE(ctrl_requests == std::vector<uint8_t>({USB_CDC_REQ_SET_LINE_CODING, USB_CDC_REQ_SET_CONTROL_LINE_STATE}));
+            REQUIRE(ctrl_status == std::vector<esp_err_t>({ESP_OK, ESP_OK, ESP_OK, ESP_OK}));
+
+            // Setting equal to the shadow copy is sent while another change is queued, so it is not lost
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_line_coding_set_async(dev, &line_coding_2, _ctrl_done_cb, nullptr));
+            REQUIRE(ESP_OK == cdc_acm_host_line_coding_set_async(dev, &line_coding, _ctrl_done_cb, nullptr));
+            _complete_ctrl_transfer(USB_TRANSFER_STATUS_COMPLETED, nullptr, 0);
+            _complete_ctrl_transfer(USB_TRANSFER_STATUS_COMPLETED, nullptr, 0);
+            REQUIRE(ctrl_requests.size() == 4);
+            REQUIRE(ctrl_requests[3] == USB_CDC_REQ_SET_LINE_CODING);
+
+            cdc_acm_line_coding_t line_coding_ret = {};
+            REQUIRE(ESP_OK == cdc_acm_host_line_coding_get(dev, &line_coding_ret));
+            REQUIRE(memcmp(&line_coding, &line_coding_ret, sizeof(line_coding)) == 0);
+        }
+
+        SECTION("Port settings are cached") {
+            usb_host_transfer_submit_control_AddCallback(_submit_control_complete_callback);
+            const cdc_acm_line_coding_t line_coding = {
+                .dwDTERate = 115200,
+                .bCharFormat = 0,
+                .bParityType = 0,
+                .bDataBits = 8,
+            };
+            cdc_acm_line_coding_t line_coding_ret = {};
+
+            // Identical SET is skipped, GET returns the shadow copy
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_line_coding_set(dev, &line_coding));
+            REQUIRE(ESP_OK == cdc_acm_host_line_coding_set(dev, &line_coding));
+            REQUIRE(ESP_OK == cdc_acm_host_line_coding_get(dev, &line_coding_ret));
+            REQUIRE(memcmp(&line_coding, &line_coding_ret, sizeof(line_coding)) == 0);
+            REQUIRE(ctrl_requests == std::vector<uint8_t>({USB_CDC_REQ_SET_LINE_CODING}));
+
+            // Refresh always reads the device
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_line_coding_refresh(dev, &line_coding_ret));
+            REQUIRE(ctrl_requests.size() == 2);
+            REQUIRE(ctrl_requests[1] == USB_CDC_REQ_GET_LINE_CODING);
+
+            // Only the changed setting is sent
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_apply_port_settings(dev, &line_coding, true, false));
+            REQUIRE(ESP_OK == cdc_acm_host_apply_port_settings(dev, &line_coding, true, false));
+            REQUIRE(ESP_OK == cdc_acm_host_set_control_line_state(dev, true, false));
+            REQUIRE(ctrl_requests.size() == 3);
+            REQUIRE(ctrl_requests[2] == USB_CDC_REQ_SET_CONTROL_LINE_STATE);
+        }
+
+        SECTION("Encapsulated response is fetched on notification") {
+            usb_host_transfer_submit_control_AddCallback(_submit_control_record_callback);
+            const char command[] = "AT\r";
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_send_encapsulated_command(dev, (const uint8_t *)command, strlen(command), _ctrl_done_cb, nullptr));
+            REQUIRE(ctrl_requests == std::vector<uint8_t>({USB_CDC_REQ_SEND_ENCAPSULATED_COMMAND}));
+            _complete_ctrl_transfer(USB_TRANSFER_STATUS_COMPLETED, nullptr, 0);
+
+            // Nothing is requested until the device signals the response
+            REQUIRE(ctrl_flight.empty());
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            _notify(USB_CDC_NOTIF_RESPONSE_AVAILABLE);
+            REQUIRE(ctrl_requests == std::vector<uint8_t>({USB_CDC_REQ_SEND_ENCAPSULATED_COMMAND, USB_CDC_REQ_GET_ENCAPSULATED_RESPONSE}));
+
+            // Short response is passed to the response callback
+            const char response[] = "\r\nOK\r\n";
+            _complete_ctrl_transfer(USB_TRANSFER_STATUS_COMPLETED, response, strlen(response));
+            REQUIRE(ctrl_status == std::vector<esp_err_t>({ESP_OK, ESP_OK}));
+            REQUIRE(ctrl_data[0].empty());
+            REQUIRE(ctrl_data[1] == std::vector<uint8_t>(response, response + strlen(response)));
+
+            REQUIRE(ESP_ERR_INVALID_SIZE == cdc_acm_host_send_encapsulated_command(dev, (const uint8_t *)command, CDC_ACM_ENCAP_MAX_SIZE + 1, _ctrl_done_cb, nullptr));
+        }
+
+        SECTION("Encapsulated response longer than CTRL buffer is reported as truncated") {
+            usb_host_transfer_submit_control_AddCallback(_submit_control_record_callback);
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            _notify(USB_CDC_NOTIF_RESPONSE_AVAILABLE);
+            REQUIRE(ctrl_flight.size() == 1);
+            // One byte more than the buffer is requested, so a longer response can be detected
+            REQUIRE(((const usb_setup_packet_t *)ctrl_flight.front()->data_buffer)->wLength == CDC_ACM_ENCAP_MAX_SIZE + 1);
+
+            std::vector<uint8_t> response(CDC_ACM_ENCAP_MAX_SIZE + 1);
+            for (size_t i = 0; i < response.size(); i++) {
+                response[i] = (uint8_t)i;
+            }
+            _complete_ctrl_transfer(USB_TRANSFER_STATUS_COMPLETED, response.data(), response.size());
+            REQUIRE(ctrl_status == std::vector<esp_err_t>({ESP_ERR_INVALID_SIZE}));
+            REQUIRE(ctrl_data[0] == std::vector<uint8_t>(response.begin(), response.begin() + CDC_ACM_ENCAP_MAX_SIZE));
+
+            // Response that fills the buffer exactly is complete
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            _notify(USB_CDC_NOTIF_RESPONSE_AVAILABLE);
+            _complete_ctrl_transfer(USB_TRANSFER_STATUS_COMPLETED, response.data(), CDC_ACM_ENCAP_MAX_SIZE);
+            REQUIRE(ctrl_status == std::vector<esp_err_t>({ESP_ERR_INVALID_SIZE, ESP_OK}));
+            REQUIRE(ctrl_data[1].size() == CDC_ACM_ENCAP_MAX_SIZE);
+        }
+
+        usb_host_transfer_submit_control_AddCallback(nullptr);
+        usb_host_transfer_submit_AddCallback(nullptr);
+        REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        REQUIRE(ESP_OK == test_cdc_acm_host_uninstall());
+    }
+}
+
+SCENARIO("Encapsulated command and response larger than default CTRL buffer")
+{
+    SECTION("Add mocked device") {
+        usb_host_mock_dev_list_init();
+
+        REQUIRE(ESP_OK == usb_host_mock_add_device(9, (const usb_device_desc_t *)ch340_device_desc,
+                (const usb_config_desc_t *)ch340_config_desc));
+    }
+
+    GIVEN("Mocked device is opened with ctrl_buffer_size set") {
+        REQUIRE(ESP_OK == test_cdc_acm_host_install(nullptr));
+
+        cdc_acm_dev_hdl_t dev = nullptr;
+        const uint16_t ctrl_buffer_size = 200;
+        const cdc_acm_host_device_config_t dev_config = {
+            .connection_timeout_ms = 1000,
+            .out_buffer_size = 64,
+            .in_buffer_size = 64,
+            .event_cb = nullptr,
+            .data_cb = nullptr,
+            .user_arg = nullptr,
+            .encap_response_cb = _ctrl_done_cb,
+            .ctrl_buffer_size = ctrl_buffer_size,
+        };
+        const uint16_t vid = 0x1A86, pid = 0x7523;
+        const uint8_t device_address = 9, interface_index = 0;
+
+        ctrl_flight.clear();
+        ctrl_requests.clear();
+        ctrl_status.clear();
+        ctrl_data.clear();
+        notif_xfer = nullptr;
+        usb_host_transfer_submit_AddCallback(_submit_notif_record_callback);
+        REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+        REQUIRE(dev != nullptr);
+
+        SECTION("Long command and response are passed whole") {
+            usb_host_transfer_submit_control_AddCallback(_submit_control_record_callback);
+            std::vector<uint8_t> command(150);
+            for (size_t i = 0; i < command.size(); i++) {
+                command[i] = (uint8_t)(i + 1);
+            }
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_send_encapsulated_command(dev, command.data(), command.size(), _ctrl_done_cb, nullptr));
+            REQUIRE(ctrl_flight.size() == 1);
+            const uint8_t *sent = ctrl_flight.front()->data_buffer + sizeof(usb_setup_packet_t);
+            REQUIRE(std::vector<uint8_t>(sent, sent + command.size()) == command);
+            _complete_ctrl_transfer(USB_TRANSFER_STATUS_COMPLETED, nullptr, 0);
+
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            _notify(USB_CDC_NOTIF_RESPONSE_AVAILABLE);
+            REQUIRE(((const usb_setup_packet_t *)ctrl_flight.front()->data_buffer)->wLength == ctrl_buffer_size + 1);
+            const std::vector<uint8_t> response(ctrl_buffer_size, 'R');
+            _complete_ctrl_transfer(USB_TRANSFER_STATUS_COMPLETED, response.data(), response.size());
+            REQUIRE(ctrl_status == std::vector<esp_err_t>({ESP_OK, ESP_OK}));
+            REQUIRE(ctrl_data[1] == response);
+
+            command.resize(ctrl_buffer_size + 1);
+            REQUIRE(ESP_ERR_INVALID_SIZE == cdc_acm_host_send_encapsulated_command(dev, command.data(), command.size(), _ctrl_done_cb, nullptr));
+        }
+
+        usb_host_transfer_submit_control_AddCallback(nullptr);
+        usb_host_transfer_submit_AddCallback(nullptr);
+        REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        REQUIRE(ESP_OK == test_cdc_acm_host_uninstall());
+    }
+}
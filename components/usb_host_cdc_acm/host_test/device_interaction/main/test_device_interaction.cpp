@@ -62,12 +62,26 @@ static void _add_mocked_devices(void)
 static void _submit_mock_transfer(cdc_acm_dev_hdl_t *dev)
 {
     const uint8_t tx_buf[] = "HELLO";
+    cdc_acm_host_stats_t stats;
     // Submit transfer successfully
     REQUIRE(ESP_OK == test_cdc_acm_host_data_tx_blocking(*dev, tx_buf, sizeof(tx_buf), 200, MOCK_USB_TRANSFER_SUCCESS));
+    REQUIRE(ESP_OK == cdc_acm_host_stats_get(*dev, &stats));
+    REQUIRE(stats.tx_transfers == 1);
+    REQUIRE(stats.tx_bytes == sizeof(tx_buf));
     // Submit transfer which will fail to submit
     REQUIRE(ESP_ERR_INVALID_RESPONSE == test_cdc_acm_host_data_tx_blocking(*dev, tx_buf, sizeof(tx_buf), 200, MOCK_USB_TRANSFER_ERROR));
     // Submit transfer which times out
     REQUIRE(ESP_ERR_TIMEOUT == test_cdc_acm_host_data_tx_blocking(*dev, tx_buf, sizeof(tx_buf), 200, MOCK_USB_TRANSFER_TIMEOUT));
+    REQUIRE(ESP_OK == cdc_acm_host_stats_get(*dev, &stats));
+    REQUIRE(stats.tx_timeouts == 1);
+
+    // Reset the statistics
+    REQUIRE(ESP_OK == cdc_acm_host_stats_reset(*dev));
+    REQUIRE(ESP_OK == cdc_acm_host_stats_get(*dev, &stats));
+    REQUIRE(stats.tx_transfers == 0);
+    REQUIRE(stats.tx_bytes == 0);
+    REQUIRE(stats.tx_timeouts == 0);
+    REQUIRE(stats.xfer_errors == 0);
 }
 
 SCENARIO("Interact with mocked USB devices")
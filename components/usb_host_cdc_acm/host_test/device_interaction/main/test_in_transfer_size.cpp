@@ -0,0 +1,175 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <catch2/catch_test_macros.hpp>
+
+#include "descriptors/cdc_descriptors.hpp"
+#include "usb/cdc_acm_host.h"
+#include "mock_add_usb_device.h"
+#include "common_test_fixtures.hpp"
+
+extern "C" {
+#include "Mockusb_host.h"
+}
+
+static std::deque<usb_transfer_t *> in_queue; // Submitted IN transfers, in order of submission
+static size_t rx_bytes;                       // Number of bytes delivered to the user
+
+static esp_err_t _submit_queue_callback(usb_transfer_t *transfer, int call_count)
+{
+    if (transfer->bEndpointAddress & 0x80) {
+        in_queue.push_back(transfer);
+    }
+    return ESP_OK;
+}
+
+static bool _rx_count_cb(const uint8_t *data, size_t data_len, void *user_arg)
+{
+    rx_bytes += data_len;
+    return true;
+}
+
+/**
+ * @brief Emulate a device that has 'pending' bytes to send
+ *
+ * The oldest submitted IN transfer is completed with as much data as it requested, or with the rest of pending data.
+ *
+ * @param[in] pending Number of bytes the device has ready to send
+ * @return Number of bytes sent in the transfer
+ */
+static size_t _device_send(size_t pending)
+{
+    REQUIRE_FALSE(in_queue.empty());
+    usb_transfer_t *transfer = in_queue.front();
+    in_queue.pop_front();
+
+    transfer->actual_num_bytes = (pending < (size_t)transfer->num_bytes) ? pending : transfer->num_bytes;
+    memset(transfer->data_buffer, 0x55, transfer->actual_num_bytes);
+    transfer->status = USB_TRANSFER_STATUS_COMPLETED;
+    usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+    transfer->callback(transfer);
+    return transfer->actual_num_bytes;
+}
+
+/**
+ * @brief Send 'total' bytes of bulk traffic and return the number of IN transfers that were needed
+ */
+static unsigned _bulk_traffic(size_t total)
+{
+    unsigned xfers = 0;
+    while (total) {
+        total -= _device_send(total);
+        xfers++;
+    }
+    return xfers;
+}
+
+SCENARIO("Adaptive IN transfer size")
+{
+    SECTION("Add mocked device") {
+        usb_host_mock_dev_list_init();
+
+        // CP210x (FS descriptor)
+        REQUIRE(ESP_OK == usb_host_mock_add_device(6, (const usb_device_desc_t *)cp210x_device_desc,
+                (const usb_config_desc_t *)cp210x_config_desc));
+    }
+
+    GIVEN("Mocked device is added to the device list") {
+        REQUIRE(ESP_OK == test_cdc_acm_host_install(nullptr));
+
+        cdc_acm_dev_hdl_t dev = nullptr;
+        cdc_acm_host_device_config_t dev_config = {
+            .connection_timeout_ms = 1000,
+            .out_buffer_size = 100,
+            .in_buffer_size = 512,
+            .event_cb = nullptr,
+            .data_cb = _rx_count_cb,
+            .user_arg = nullptr,
+        };
+        const uint16_t vid = 0x10C4, pid = 0xEA60;
+        const uint8_t device_address = 6, interface_index = 0;
+        const size_t mps = 64; // CP210x bulk IN endpoint Maximum Packet Size
+        const size_t bulk_len = 16 * 1024;
+        cdc_acm_host_stats_t stats;
+
+        SECTION("Fixed IN transfer size requests the whole buffer") {
+            in_queue.clear();
+            rx_bytes = 0;
+            usb_host_transfer_submit_AddCallback(_submit_queue_callback);
+
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            REQUIRE(in_queue.front()->num_bytes == 512);
+
+            const unsigned xfers = _bulk_traffic(bulk_len);
+            printf("Fixed IN transfer size: %u transfers for %u bytes of bulk traffic\n", xfers, (unsigned)bulk_len);
+            REQUIRE(xfers == bulk_len / 512);
+            REQUIRE(rx_bytes == bulk_len);
+
+            REQUIRE(ESP_OK == cdc_acm_host_stats_get(dev, &stats));
+            REQUIRE(stats.in_xfer_size == 512);
+            REQUIRE(stats.in_xfer_size_grow == 0);
+            REQUIRE(stats.in_xfer_size_shrink == 0);
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Adaptive IN transfer size follows the traffic") {
+            in_queue.clear();
+            rx_bytes = 0;
+            usb_host_transfer_submit_AddCallback(_submit_queue_callback);
+
+            dev_config.in_adaptive_size = true;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            REQUIRE(in_queue.front()->num_bytes == mps);
+
+            // Sparse traffic: short replies keep the transfers at Maximum Packet Size
+            for (int i = 0; i < 20; i++) {
+                REQUIRE(_device_send(8) == 8);
+            }
+            REQUIRE(ESP_OK == cdc_acm_host_stats_get(dev, &stats));
+            REQUIRE(stats.in_xfer_size == mps);
+            REQUIRE(stats.in_xfer_size_grow == 0);
+
+            // Sustained traffic: transfers grow to the whole buffer, 64 -> 128 -> 256 -> 512
+            const unsigned xfers = _bulk_traffic(bulk_len);
+            printf("Adaptive IN transfer size: %u transfers for %u bytes of bulk traffic\n", xfers, (unsigned)bulk_len);
+            REQUIRE(ESP_OK == cdc_acm_host_stats_get(dev, &stats));
+            REQUIRE(stats.in_xfer_size == 512);
+            REQUIRE(stats.in_xfer_size_grow == 3);
+            // Ramp-up costs only a few extra transfers compared to fixed size
+            REQUIRE(xfers <= bulk_len / 512 + 6);
+
+            // Single transfer of the other size does not change the size
+            REQUIRE(_device_send(8) == 8);
+            REQUIRE(ESP_OK == cdc_acm_host_stats_get(dev, &stats));
+            REQUIRE(stats.in_xfer_size == 512);
+
+            // Traffic is sparse again: transfers shrink back to Maximum Packet Size
+            for (int i = 0; i < 20; i++) {
+                _device_send(8);
+            }
+            REQUIRE(ESP_OK == cdc_acm_host_stats_get(dev, &stats));
+            REQUIRE(stats.in_xfer_size == mps);
+            REQUIRE(stats.in_xfer_size_shrink == 3);
+            REQUIRE(rx_bytes == 20 * 8 + bulk_len + 21 * 8);
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Invalid arguments") {
+            REQUIRE(ESP_ERR_INVALID_ARG == cdc_acm_host_stats_get(nullptr, &stats));
+        }
+
+        REQUIRE(ESP_OK == test_cdc_acm_host_uninstall());
+    }
+}
@@ -5,8 +5,12 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+#include <map>
 #include <catch2/catch_test_macros.hpp>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "descriptors/cdc_descriptors.hpp"
 #include "usb/cdc_acm_host.h"
 #include "mock_add_usb_device.h"
@@ -33,6 +37,76 @@ static void _add_mocked_devices(void)
 }
 
 
+static usb_host_client_event_cb_t client_event_cb = nullptr; // Event callback registered by CDC-ACM driver
+static void *client_event_cb_arg = nullptr;
+
+/**
+ * @brief Record event callback of the registered USB Host client, so the test can deliver USB Host events
+ */
+static esp_err_t _client_register_record_callback(const usb_host_client_config_t *client_config, usb_host_client_handle_t *client_hdl_ret, int call_count)
+{
+    client_event_cb = client_config->async.client_event_callback;
+    client_event_cb_arg = client_config->async.callback_arg;
+    return usb_host_client_register_mock_callback(client_config, client_hdl_ret, call_count);
+}
+
+/**
+ * @brief Connect CP210x device: add it to mocked devices list and deliver USB_HOST_CLIENT_EVENT_NEW_DEV
+ */
+static esp_err_t _connect_mocked_device(void)
+{
+    const esp_err_t ret = usb_host_mock_add_device(5, (const usb_device_desc_t *)cp210x_device_desc,
+                          (const usb_config_desc_t *)cp210x_config_desc);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    usb_host_client_event_msg_t event_msg = {};
+    event_msg.event = USB_HOST_CLIENT_EVENT_NEW_DEV;
+    event_msg.new_dev.address = 5;
+    client_event_cb(&event_msg, client_event_cb_arg);
+    return ESP_OK;
+}
+
+/**
+ * @brief Connect CP210x device while the test task waits in cdc_acm_host_open()
+ */
+static void _connect_device_task(void *arg)
+{
+    vTaskDelay(pdMS_TO_TICKS(50));
+    _connect_mocked_device();
+    vTaskDelete(NULL);
+}
+
+static std::map<usb_device_handle_t, uint8_t> opened_addrs; // Address of each opened mocked device
+
+/**
+ * @brief Open mocked device and record its address, so usb_host_device_info() can tell the devices apart
+ */
+static esp_err_t _device_open_record_callback(usb_host_client_handle_t client_hdl, uint8_t dev_addr, usb_device_handle_t *dev_hdl_ret, int call_count)
+{
+    const esp_err_t ret = usb_host_device_open_mock_callback(client_hdl, dev_addr, dev_hdl_ret, call_count);
+    if (ret == ESP_OK) {
+        opened_addrs[*dev_hdl_ret] = dev_addr;
+    }
+    return ret;
+}
+
+// Serial number string descriptors (UTF-16LE) of mocked devices at addresses 5 and 6
+static const uint8_t serial_a1_desc[] = {6, USB_B_DESCRIPTOR_TYPE_STRING, 'A', 0, '1', 0};
+static const uint8_t serial_b2_desc[] = {6, USB_B_DESCRIPTOR_TYPE_STRING, 'B', 0, '2', 0};
+
+static esp_err_t _device_info_serial_callback(usb_device_handle_t dev_hdl, usb_device_info_t *dev_info, int call_count)
+{
+    const auto it = opened_addrs.find(dev_hdl);
+    if (it == opened_addrs.end()) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(dev_info, 0, sizeof(usb_device_info_t));
+    dev_info->dev_addr = it->second;
+    dev_info->str_desc_serial_num = (const usb_str_desc_t *)((it->second == 5) ? serial_a1_desc : serial_b2_desc);
+    return ESP_OK;
+}
+
 SCENARIO("Test mocked device opening and closing")
 {
     // We will put device adding to the SECTION, to run it just once, not repeatedly for all the following SECTIONs
@@ -144,14 +218,8 @@ SCENARIO("Test mocked device opening and closing")
             usb_host_get_active_config_descriptor_ExpectAnyArgsAndReturn(ESP_OK);
             usb_host_get_active_config_descriptor_AddCallback(usb_host_get_active_config_descriptor_mock_callback);
 
-            // Setup control transfer
-            usb_host_transfer_alloc_ExpectAnyArgsAndReturn(ESP_OK);
-            //  Setup IN data transfer
-            usb_host_transfer_alloc_ExpectAnyArgsAndReturn(ESP_OK);
-            // Setup OUT bulk transfer
-            usb_host_transfer_alloc_ExpectAnyArgsAndReturn(ESP_OK);
-            // Register callback
-            usb_host_transfer_alloc_AddCallback(usb_host_transfer_alloc_mock_callback);
+            // Setup control transfer, IN data transfer and OUT bulk transfer
+            test_usb_host_transfer_alloc(3);
 
             // Call cdc_acm_start
 
@@ -173,14 +241,8 @@ SCENARIO("Test mocked device opening and closing")
             usb_host_interface_release_IgnoreArg_client_hdl();  // Ignore all function parameters, except interface_idx
             usb_host_interface_release_IgnoreArg_dev_hdl();
 
-            // Free in transfer
-            usb_host_transfer_free_ExpectAnyArgsAndReturn(ESP_OK);
-            // Free out transfer
-            usb_host_transfer_free_ExpectAnyArgsAndReturn(ESP_OK);
-
-            // Call cdc_acm_device_remove, free ctrl transfer
-            usb_host_transfer_free_ExpectAnyArgsAndReturn(ESP_OK);
-            usb_host_transfer_free_AddCallback(usb_host_transfer_free_mock_callback);
+            // Free in transfer, out transfer and ctrl transfer (in cdc_acm_device_remove)
+            test_usb_host_transfer_free(3);
 
             usb_host_device_close_ExpectAnyArgsAndReturn(ESP_OK);
 
@@ -188,7 +250,189 @@ SCENARIO("Test mocked device opening and closing")
             REQUIRE(ESP_OK == cdc_acm_host_close(dev));
         }
 
+        SECTION("Handle of closed device is rejected after the device is opened again") {
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(5, vid, pid, interface_index, &dev_config, &dev));
+            const cdc_acm_dev_hdl_t old_dev = dev;
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+
+            // The new device can take the same place in the device table, but not the same handle
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(5, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != old_dev);
+
+            cdc_acm_host_stats_t stats;
+            const uint8_t data[] = {0x55};
+            REQUIRE(ESP_ERR_INVALID_ARG == cdc_acm_host_stats_get(old_dev, &stats));
+            REQUIRE(ESP_ERR_INVALID_ARG == cdc_acm_host_data_tx_blocking(old_dev, data, sizeof(data), 10));
+            REQUIRE(ESP_OK == cdc_acm_host_close(old_dev)); // Closing a closed device does nothing
+
+            // The new device is not affected
+            REQUIRE(ESP_OK == cdc_acm_host_stats_get(dev, &stats));
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
         // Uninstall CDC-ACM driver
         REQUIRE(ESP_OK == test_cdc_acm_host_uninstall());
     }
 }
+
+SCENARIO("Test mocked device connected while cdc_acm_host_open() waits")
+{
+    // No device is connected at the beginning of the test
+    usb_host_mock_dev_list_init();
+
+    // Install CDC-ACM driver, record its USB Host client event callback
+    usb_host_client_register_ExpectAnyArgsAndReturn(ESP_OK);
+    usb_host_client_register_AddCallback(_client_register_record_callback);
+    usb_host_client_handle_events_ExpectAnyArgsAndReturn(ESP_OK);
+    usb_host_client_handle_events_AddCallback(usb_host_client_handle_events_mock_callback);
+    REQUIRE(ESP_OK == cdc_acm_host_install(nullptr));
+    REQUIRE(client_event_cb != nullptr);
+
+    cdc_acm_dev_hdl_t dev = nullptr;
+    cdc_acm_host_device_config_t dev_config = {
+        .connection_timeout_ms = 1000,
+        .out_buffer_size = 100,
+        .in_buffer_size = 100,
+        .event_cb = nullptr,
+        .data_cb = nullptr,
+        .user_arg = nullptr,
+    };
+    const uint16_t vid = 0x10C4, pid = 0xEA60;
+    const uint8_t interface_index = 0;
+    const uint8_t in_ep = 0x82;
+
+    // List of connected devices is checked only once, it is empty
+    int num_of_devices = 0;
+    usb_host_device_addr_list_fill_ExpectAnyArgsAndReturn(ESP_OK);
+    usb_host_device_addr_list_fill_ReturnThruPtr_num_dev_ret(&num_of_devices);
+
+    SECTION("Device is opened from USB_HOST_CLIENT_EVENT_NEW_DEV") {
+        // The new device is opened and matched in the event callback
+        usb_host_device_open_ExpectAnyArgsAndReturn(ESP_OK);
+        usb_host_device_open_AddCallback(usb_host_device_open_mock_callback);
+        usb_host_get_device_descriptor_ExpectAnyArgsAndReturn(ESP_OK);
+
+        // cdc_acm_host_open() continues with the handed over device
+        usb_host_get_device_descriptor_ExpectAnyArgsAndReturn(ESP_OK);
+        usb_host_get_device_descriptor_AddCallback(usb_host_get_device_descriptor_mock_callback);
+        usb_host_get_active_config_descriptor_ExpectAnyArgsAndReturn(ESP_OK);
+        usb_host_get_active_config_descriptor_AddCallback(usb_host_get_active_config_descriptor_mock_callback);
+        test_usb_host_transfer_alloc(3);
+        test_usb_host_interface_claim(interface_index);
+
+        REQUIRE(pdPASS == xTaskCreate(_connect_device_task, "connect", 4096, nullptr, 5, nullptr));
+        const TickType_t start = xTaskGetTickCount();
+        REQUIRE(ESP_OK == cdc_acm_host_open(vid, pid, interface_index, &dev_config, &dev));
+        REQUIRE(nullptr != dev);
+
+        // The device was not found by polling, cdc_acm_host_open() returned right after the event
+        REQUIRE(xTaskGetTickCount() - start < pdMS_TO_TICKS(dev_config.connection_timeout_ms / 2));
+
+        // Close the device
+        test_cdc_acm_reset_transfer_endpoint(in_ep);
+        usb_host_interface_release_ExpectAndReturn(nullptr, nullptr, interface_index, ESP_OK);
+        usb_host_interface_release_IgnoreArg_client_hdl();
+        usb_host_interface_release_IgnoreArg_dev_hdl();
+        test_usb_host_transfer_free(3);
+        usb_host_device_close_ExpectAnyArgsAndReturn(ESP_OK);
+        usb_host_device_close_AddCallback(usb_host_device_close_mock_callback);
+        REQUIRE(ESP_OK == cdc_acm_host_close(dev));
+    }
+
+    SECTION("Timeout stops waiting for new devices") {
+        dev_config.connection_timeout_ms = 50;
+        const TickType_t start = xTaskGetTickCount();
+        REQUIRE(ESP_ERR_NOT_FOUND == cdc_acm_host_open(vid, pid, interface_index, &dev_config, &dev));
+        REQUIRE(nullptr == dev);
+        REQUIRE(xTaskGetTickCount() - start >= pdMS_TO_TICKS(dev_config.connection_timeout_ms));
+
+        // Nobody waits for the device anymore, the driver does not even open it (usb_host_device_open() is not expected)
+        REQUIRE(ESP_OK == _connect_mocked_device());
+
+        // The device is found in the list of connected devices by the next cdc_acm_host_open()
+        dev_config.connection_timeout_ms = 1000;
+        REQUIRE(ESP_OK == test_cdc_acm_host_open(5, vid, pid, interface_index, &dev_config, &dev));
+        REQUIRE(nullptr != dev);
+        REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+    }
+
+    // Uninstall CDC-ACM driver
+    REQUIRE(ESP_OK == test_cdc_acm_host_uninstall());
+}
+
+SCENARIO("Test opening one of two mocked devices with equal VID/PID by serial number")
+{
+    // Two CP210x devices with different serial numbers
+    usb_host_mock_dev_list_init();
+    REQUIRE(ESP_OK == usb_host_mock_add_device(5, (const usb_device_desc_t *)cp210x_device_desc,
+            (const usb_config_desc_t *)cp210x_config_desc));
+    REQUIRE(ESP_OK == usb_host_mock_add_device(6, (const usb_device_desc_t *)cp210x_device_desc,
+            (const usb_config_desc_t *)cp210x_config_desc));
+
+    REQUIRE(ESP_OK == test_cdc_acm_host_install(nullptr));
+    opened_addrs.clear();
+    usb_host_device_info_Stub(_device_info_serial_callback);
+
+    cdc_acm_dev_hdl_t dev = nullptr;
+    cdc_acm_host_device_config_t dev_config = {
+        .connection_timeout_ms = 1, // Set small connection timeout, so the usb_host_device_addr_list_fill() is called only once
+        .out_buffer_size = 100,
+        .in_buffer_size = 100,
+        .event_cb = nullptr,
+        .data_cb = nullptr,
+        .user_arg = nullptr,
+    };
+    const uint16_t vid = 0x10C4, pid = 0xEA60;
+    const uint8_t interface_index = 0;
+    const uint8_t in_ep = 0x82;
+
+    // Both devices are opened and checked
+    usb_host_device_addr_list_fill_ExpectAnyArgsAndReturn(ESP_OK);
+    usb_host_device_addr_list_fill_AddCallback(usb_host_device_addr_list_fill_mock_callback);
+    for (int i = 0; i < 2; i++) {
+        usb_host_device_open_ExpectAnyArgsAndReturn(ESP_OK);
+        usb_host_get_device_descriptor_ExpectAnyArgsAndReturn(ESP_OK);
+    }
+    usb_host_device_open_AddCallback(_device_open_record_callback);
+    usb_host_get_device_descriptor_AddCallback(usb_host_get_device_descriptor_mock_callback);
+    usb_host_device_close_AddCallback(usb_host_device_close_mock_callback);
+
+    SECTION("The second device is opened, the first one has a different serial number") {
+        dev_config.serial_number = "B2";
+        usb_host_device_close_ExpectAnyArgsAndReturn(ESP_OK);
+
+        usb_host_get_device_descriptor_ExpectAnyArgsAndReturn(ESP_OK);
+        usb_host_get_active_config_descriptor_ExpectAnyArgsAndReturn(ESP_OK);
+        usb_host_get_active_config_descriptor_AddCallback(usb_host_get_active_config_descriptor_mock_callback);
+        test_usb_host_transfer_alloc(3);
+        test_usb_host_interface_claim(interface_index);
+
+        REQUIRE(ESP_OK == cdc_acm_host_open(vid, pid, interface_index, &dev_config, &dev));
+        REQUIRE(nullptr != dev);
+
+        usb_device_info_t dev_info;
+        REQUIRE(ESP_OK == cdc_acm_host_device_info_get(dev, &dev_info));
+        REQUIRE(dev_info.dev_addr == 6);
+
+        // Close the device
+        test_cdc_acm_reset_transfer_endpoint(in_ep);
+        usb_host_interface_release_ExpectAndReturn(nullptr, nullptr, interface_index, ESP_OK);
+        usb_host_interface_release_IgnoreArg_client_hdl();
+        usb_host_interface_release_IgnoreArg_dev_hdl();
+        test_usb_host_transfer_free(3);
+        usb_host_device_close_ExpectAnyArgsAndReturn(ESP_OK);
+        REQUIRE(ESP_OK == cdc_acm_host_close(dev));
+    }
+
+    SECTION("No device has the requested serial number") {
+        dev_config.serial_number = "C3";
+        usb_host_device_close_ExpectAnyArgsAndReturn(ESP_OK);
+        usb_host_device_close_ExpectAnyArgsAndReturn(ESP_OK);
+
+        REQUIRE(ESP_ERR_NOT_FOUND == cdc_acm_host_open(vid, pid, interface_index, &dev_config, &dev));
+        REQUIRE(nullptr == dev);
+    }
+
+    usb_host_device_info_Stub(nullptr);
+    REQUIRE(ESP_OK == test_cdc_acm_host_uninstall());
+}
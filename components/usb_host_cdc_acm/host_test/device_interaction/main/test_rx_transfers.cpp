@@ -0,0 +1,499 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "descriptors/cdc_descriptors.hpp"
+#include "usb/cdc_acm_host.h"
+#include "mock_add_usb_device.h"
+#include "common_test_fixtures.hpp"
+
+extern "C" {
+#include "Mockusb_host.h"
+}
+
+static std::deque<usb_transfer_t *> in_flight;  // Submitted IN transfers, in order of submission
+static std::vector<uint8_t> rx_data;            // Data delivered to the user, in order of delivery
+static std::vector<size_t> in_flight_during_cb; // Number of IN transfers in flight, sampled in the data callback
+
+/**
+ * @brief Record submitted IN transfers instead of completing them
+ *
+ * The transfers are completed later by _complete_in_transfer(), to emulate a device that sends data at its own pace
+ */
+static esp_err_t _submit_record_callback(usb_transfer_t *transfer, int call_count)
+{
+    if (transfer->bEndpointAddress & 0x80) {
+        in_flight.push_back(transfer);
+    }
+    return ESP_OK;
+}
+
+static bool _rx_cb(const uint8_t *data, size_t data_len, void *user_arg)
+{
+    in_flight_during_cb.push_back(in_flight.size());
+    rx_data.insert(rx_data.end(), data, data + data_len);
+    return true;
+}
+
+static int overrun_events = 0; // Number of CDC_ACM_HOST_SERIAL_STATE events with bOverRun set
+
+/**
+ * @brief Data callback that declines odd bytes, asking for them to be appended to the next data
+ */
+static bool _rx_decline_odd_cb(const uint8_t *data, size_t data_len, void *user_arg)
+{
+    if (data[0] & 1) {
+        return false;
+    }
+    rx_data.insert(rx_data.end(), data, data + data_len);
+    return true;
+}
+
+static void _overrun_event_cb(const cdc_acm_host_dev_event_data_t *event, void *user_ctx)
+{
+    if (event->type == CDC_ACM_HOST_SERIAL_STATE && event->data.serial_state.bOverRun) {
+        overrun_events++;
+    }
+}
+
+static bool rx_accept = false;                        // Return value of _rx_append_cb
+static std::vector<std::vector<uint8_t>> rx_offered; // Data passed to _rx_append_cb, one item per call
+
+/**
+ * @brief Data callback that asks for the data to be appended to the next data until the test allows processing
+ */
+static bool _rx_append_cb(const uint8_t *data, size_t data_len, void *user_arg)
+{
+    rx_offered.emplace_back(data, data + data_len);
+    return rx_accept;
+}
+
+static std::vector<std::string> rx_messages; // Messages delivered to _rx_message_cb
+
+/**
+ * @brief Data callback of a framed protocol, asks for more data until the message ends with ';'
+ */
+static bool _rx_message_cb(const uint8_t *data, size_t data_len, void *user_arg)
+{
+    if (data[data_len - 1] != ';') {
+        return false;
+    }
+    rx_messages.emplace_back((const char *)data, data_len);
+    return true;
+}
+
+static SemaphoreHandle_t rx_cb_release = nullptr; // Counting semaphore, one token is needed for each call of _rx_slow_cb
+
+/**
+ * @brief Data callback of a slow consumer, blocks until the test releases it
+ */
+static bool _rx_slow_cb(const uint8_t *data, size_t data_len, void *user_arg)
+{
+    xSemaphoreTake(rx_cb_release, portMAX_DELAY);
+    rx_data.insert(rx_data.end(), data, data + data_len);
+    return true;
+}
+
+static cdc_acm_dev_hdl_t hold_dev = nullptr;     // Device whose RX buffers are held in _rx_hold_cb
+static std::vector<const uint8_t *> held;        // RX buffers held by _rx_hold_cb
+static std::vector<esp_err_t> hold_results;      // Return values of cdc_acm_host_rx_buffer_hold()
+
+/**
+ * @brief Data callback of a zero-copy consumer, holds the received buffers instead of copying them
+ */
+static bool _rx_hold_cb(const uint8_t *data, size_t data_len, void *user_arg)
+{
+    const esp_err_t ret = cdc_acm_host_rx_buffer_hold(hold_dev, data);
+    hold_results.push_back(ret);
+    if (ret == ESP_OK) {
+        held.push_back(data);
+    }
+    return true;
+}
+
+/**
+ * @brief Complete the oldest submitted IN transfer with one byte of data
+ *
+ * @param[in] value           Data byte received from the mocked device
+ * @param[in] expect_resubmit The driver is expected to submit the transfer again (reception is not paused)
+ */
+static void _complete_in_transfer(uint8_t value, bool expect_resubmit = true)
+{
+    REQUIRE_FALSE(in_flight.empty());
+    usb_transfer_t *transfer = in_flight.front();
+    in_flight.pop_front();
+
+    transfer->data_buffer[0] = value;
+    transfer->actual_num_bytes = 1;
+    transfer->status = USB_TRANSFER_STATUS_COMPLETED;
+
+    // The transfer is resubmitted by the driver after the data callback returns
+    if (expect_resubmit) {
+        usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+    }
+    transfer->callback(transfer);
+}
+
+SCENARIO("Multiple bulk IN transfers in flight")
+{
+    SECTION("Add mocked device") {
+        usb_host_mock_dev_list_init();
+
+        // CP210x (FS descriptor)
+        REQUIRE(ESP_OK == usb_host_mock_add_device(6, (const usb_device_desc_t *)cp210x_device_desc,
+                (const usb_config_desc_t *)cp210x_config_desc));
+    }
+
+    GIVEN("Mocked device is added to the device list") {
+        REQUIRE(ESP_OK == test_cdc_acm_host_install(nullptr));
+
+        cdc_acm_dev_hdl_t dev = nullptr;
+        cdc_acm_host_device_config_t dev_config = {
+            .connection_timeout_ms = 1000,
+            .out_buffer_size = 100,
+            .in_buffer_size = 64,
+            .event_cb = nullptr,
+            .data_cb = _rx_cb,
+            .user_arg = nullptr,
+            .in_transfer_count = 4,
+        };
+        const uint16_t vid = 0x10C4, pid = 0xEA60;
+        const uint8_t device_address = 6, interface_index = 0;
+
+        SECTION("Fail to open CDC-ACM Device: too many IN transfers") {
+            dev_config.in_transfer_count = 9;
+            REQUIRE(ESP_ERR_INVALID_ARG == cdc_acm_host_open(vid, pid, interface_index, &dev_config, &dev));
+        }
+
+        SECTION("Fail to open CDC-ACM Device: flow control without RX ring and more IN transfers") {
+            dev_config.rx_high_water = 1;
+            REQUIRE(ESP_ERR_INVALID_ARG == cdc_acm_host_open(vid, pid, interface_index, &dev_config, &dev));
+        }
+
+        SECTION("Data are delivered in order while other transfers keep the endpoint busy") {
+            in_flight.clear();
+            rx_data.clear();
+            in_flight_during_cb.clear();
+            usb_host_transfer_submit_AddCallback(_submit_record_callback);
+
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            REQUIRE(in_flight.size() == dev_config.in_transfer_count);
+
+            for (uint8_t i = 0; i < 10; i++) {
+                _complete_in_transfer(i);
+            }
+
+            // All transfers are submitted again and no data were lost or reordered
+            REQUIRE(in_flight.size() == dev_config.in_transfer_count);
+            REQUIRE(rx_data == std::vector<uint8_t>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+            for (size_t in_flight_cnt : in_flight_during_cb) {
+                REQUIRE(in_flight_cnt == dev_config.in_transfer_count - 1U);
+            }
+
+            // Every transfer carried one byte in a short packet
+            cdc_acm_host_stats_t stats;
+            REQUIRE(ESP_OK == cdc_acm_host_stats_get(dev, &stats));
+            REQUIRE(stats.rx_transfers == 10);
+            REQUIRE(stats.rx_bytes == 10);
+            REQUIRE(stats.rx_short_transfers == 10);
+            REQUIRE(stats.rx_overruns == 0);
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Data declined by data callback are reported as overrun with multiple IN transfers") {
+            in_flight.clear();
+            rx_data.clear();
+            overrun_events = 0;
+            usb_host_transfer_submit_AddCallback(_submit_record_callback);
+
+            dev_config.data_cb = _rx_decline_odd_cb;
+            dev_config.event_cb = _overrun_event_cb;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+
+            for (uint8_t i = 0; i < 6; i++) {
+                _complete_in_transfer(i);
+            }
+
+            // Declined data cannot be appended, they are dropped and the user is told about it
+            REQUIRE(in_flight.size() == dev_config.in_transfer_count);
+            REQUIRE(rx_data == std::vector<uint8_t>({0, 2, 4}));
+            REQUIRE(overrun_events == 3);
+            cdc_acm_host_stats_t stats;
+            REQUIRE(ESP_OK == cdc_acm_host_stats_get(dev, &stats));
+            REQUIRE(stats.rx_overruns == 3);
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Slow data callback does not stall IN transfers if RX task is used") {
+            in_flight.clear();
+            rx_data.clear();
+            rx_cb_release = xSemaphoreCreateCounting(100, 0);
+            REQUIRE(rx_cb_release != nullptr);
+            usb_host_transfer_submit_AddCallback(_submit_record_callback);
+
+            dev_config.data_cb = _rx_slow_cb;
+            dev_config.rx_ring_size = 64;
+            dev_config.rx_task_priority = 5;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+
+            // The data callback is blocked, but all transfers are completed and resubmitted
+            for (uint8_t i = 0; i < 10; i++) {
+                _complete_in_transfer(i);
+            }
+            REQUIRE(in_flight.size() == dev_config.in_transfer_count);
+
+            // Unblock the data callback and wait until the RX task delivers all data
+            for (int i = 0; i < 100; i++) {
+                xSemaphoreGive(rx_cb_release);
+            }
+            for (int i = 0; (i < 100) && (rx_data.size() < 10); i++) {
+                vTaskDelay(pdMS_TO_TICKS(10));
+            }
+            REQUIRE(rx_data == std::vector<uint8_t>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+            vSemaphoreDelete(rx_cb_release);
+        }
+
+        SECTION("Message refused at the end of RX ring is delivered in one piece") {
+            in_flight.clear();
+            rx_messages.clear();
+            overrun_events = 0;
+            usb_host_transfer_submit_AddCallback(_submit_record_callback);
+
+            dev_config.data_cb = _rx_message_cb;
+            dev_config.event_cb = _overrun_event_cb;
+            dev_config.in_transfer_count = 1;
+            dev_config.rx_ring_size = 8;
+            dev_config.rx_task_priority = 5;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+
+            for (char c : std::string("abcde;")) {
+                _complete_in_transfer(c);
+            }
+            for (int i = 0; (i < 100) && (rx_messages.size() < 1); i++) {
+                vTaskDelay(pdMS_TO_TICKS(10));
+            }
+
+            // The next message starts at the end of the ring and is refused there, then continues at its start
+            _complete_in_transfer('1');
+            _complete_in_transfer('2');
+            vTaskDelay(pdMS_TO_TICKS(20));
+            for (char c : std::string("34;")) {
+                _complete_in_transfer(c);
+            }
+            for (int i = 0; (i < 100) && (rx_messages.size() < 2); i++) {
+                vTaskDelay(pdMS_TO_TICKS(10));
+            }
+            REQUIRE(rx_messages == std::vector<std::string>({"abcde;", "1234;"}));
+            REQUIRE(overrun_events == 0);
+
+            // Refused data are dropped only when they fill the whole ring
+            for (char c : std::string("ABCDEFGH")) {
+                _complete_in_transfer(c);
+            }
+            for (int i = 0; (i < 100) && (overrun_events < 1); i++) {
+                vTaskDelay(pdMS_TO_TICKS(10));
+            }
+            REQUIRE(overrun_events == 1);
+            REQUIRE(rx_messages.size() == 2);
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Received buffers can be held and released") {
+            in_flight.clear();
+            held.clear();
+            hold_results.clear();
+            usb_host_transfer_submit_AddCallback(_submit_record_callback);
+
+            dev_config.data_cb = _rx_hold_cb;
+            dev_config.in_transfer_count = 1;
+            dev_config.rx_loan_count = 2;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            hold_dev = dev;
+
+            // Buffers cannot be held outside of data callback
+            REQUIRE(ESP_ERR_INVALID_STATE == cdc_acm_host_rx_buffer_hold(dev, in_flight.front()->data_buffer));
+
+            // Two buffers are held, the third one must be copied by the user
+            for (uint8_t i = 0; i < 3; i++) {
+                _complete_in_transfer(i);
+            }
+            REQUIRE(hold_results == std::vector<esp_err_t>({ESP_OK, ESP_OK, ESP_ERR_NO_MEM}));
+            REQUIRE(held.size() == 2);
+            REQUIRE(held[0] != held[1]);
+
+            // Held buffers are not submitted again, so their content is preserved
+            REQUIRE(in_flight.size() == 1);
+            REQUIRE(in_flight.front()->data_buffer != held[0]);
+            REQUIRE(in_flight.front()->data_buffer != held[1]);
+            REQUIRE(held[0][0] == 0);
+            REQUIRE(held[1][0] == 1);
+
+            // Released buffer can be held again
+            REQUIRE(ESP_OK == cdc_acm_host_rx_buffer_release(dev, held[0]));
+            REQUIRE(ESP_ERR_NOT_FOUND == cdc_acm_host_rx_buffer_release(dev, held[0]));
+            _complete_in_transfer(3);
+            REQUIRE(hold_results.back() == ESP_OK);
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Received data can be read in pull mode") {
+            in_flight.clear();
+            usb_host_transfer_submit_AddCallback(_submit_record_callback);
+
+            dev_config.data_cb = nullptr;
+            dev_config.rx_ring_size = 64;
+            dev_config.rx_trigger_level = 3;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+
+            uint8_t buf[16];
+            size_t rx_len;
+            REQUIRE(ESP_ERR_TIMEOUT == cdc_acm_host_data_rx(dev, buf, sizeof(buf), &rx_len, 10));
+            REQUIRE(rx_len == 0);
+
+            // Trigger level is not reached, the data received so far are returned on timeout
+            _complete_in_transfer(0);
+            _complete_in_transfer(1);
+            REQUIRE(ESP_OK == cdc_acm_host_data_rx(dev, buf, sizeof(buf), &rx_len, 10));
+            REQUIRE(rx_len == 2);
+            REQUIRE((buf[0] == 0 && buf[1] == 1));
+
+            // Multiple USB packets are drained in one call
+            for (uint8_t i = 2; i < 7; i++) {
+                _complete_in_transfer(i);
+            }
+            REQUIRE(ESP_OK == cdc_acm_host_data_rx(dev, buf, sizeof(buf), &rx_len, 0));
+            REQUIRE(rx_len == 5);
+            REQUIRE(buf[4] == 6);
+
+            // Number of received bytes must be returned to the user
+            REQUIRE(ESP_ERR_INVALID_ARG == cdc_acm_host_data_rx(dev, buf, sizeof(buf), nullptr, 0));
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("IN polling is paused instead of dropping data") {
+            in_flight.clear();
+            usb_host_transfer_submit_AddCallback(_submit_record_callback);
+
+            dev_config.data_cb = nullptr;
+            dev_config.in_transfer_count = 1;
+            dev_config.rx_ring_size = 64;
+            dev_config.rx_high_water = 4;
+            dev_config.rx_low_water = 1;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+
+            // High-water mark is reached, the transfer is parked
+            for (uint8_t i = 0; i < 3; i++) {
+                _complete_in_transfer(i);
+            }
+            _complete_in_transfer(3, false);
+            REQUIRE(in_flight.empty());
+
+            // Polling resumes only after the ring drains to low-water mark
+            uint8_t buf[16];
+            size_t rx_len;
+            REQUIRE(ESP_OK == cdc_acm_host_data_rx(dev, buf, 2, &rx_len, 0));
+            REQUIRE(in_flight.empty());
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_data_rx(dev, buf, sizeof(buf), &rx_len, 0));
+            REQUIRE(rx_len == 2);
+            REQUIRE(in_flight.size() == 1);
+
+            // Reception paused by the user
+            REQUIRE(ESP_OK == cdc_acm_host_rx_pause(dev));
+            _complete_in_transfer(4, false);
+            REQUIRE(in_flight.empty());
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_rx_resume(dev));
+            REQUIRE(in_flight.size() == 1);
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Data in full RX append buffer survive pause and resume") {
+            in_flight.clear();
+            rx_offered.clear();
+            rx_accept = false;
+            usb_host_transfer_submit_AddCallback(_submit_record_callback);
+
+            dev_config.data_cb = _rx_append_cb;
+            dev_config.in_transfer_count = 1;
+            dev_config.in_buffer_size = 128;
+            dev_config.rx_high_water = 1;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+
+            // First byte is not processed, the next data are appended after it
+            _complete_in_transfer(0xA5);
+            REQUIRE(in_flight.size() == 1);
+
+            // Full packet fills the append buffer, IN polling is paused
+            usb_transfer_t *transfer = in_flight.front();
+            in_flight.pop_front();
+            memset(transfer->data_buffer, 0x5A, 64);
+            transfer->actual_num_bytes = 64;
+            transfer->status = USB_TRANSFER_STATUS_COMPLETED;
+            transfer->callback(transfer);
+            REQUIRE(in_flight.empty());
+            REQUIRE(rx_offered.size() == 2);
+
+            std::vector<uint8_t> expected(65, 0x5A);
+            expected[0] = 0xA5;
+
+            // The data are still not processed, they are kept and reception stays paused
+            REQUIRE(ESP_ERR_INVALID_STATE == cdc_acm_host_rx_resume(dev));
+            REQUIRE(in_flight.empty());
+            REQUIRE(rx_offered.size() == 3);
+            REQUIRE(rx_offered.back() == expected);
+
+            // All buffered data are delivered again before reception resumes
+            rx_accept = true;
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_rx_resume(dev));
+            REQUIRE(in_flight.size() == 1);
+            REQUIRE(rx_offered.size() == 4);
+            REQUIRE(rx_offered.back() == expected);
+
+            // The append buffer was flushed
+            _complete_in_transfer(0x01);
+            REQUIRE(rx_offered.back() == std::vector<uint8_t>({0x01}));
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        REQUIRE(ESP_OK == test_cdc_acm_host_uninstall());
+    }
+}
@@ -0,0 +1,138 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <catch2/catch_test_macros.hpp>
+
+#include "sdkconfig.h"
+#include "descriptors/cdc_descriptors.hpp"
+#include "usb/cdc_acm_host.h"
+#include "mock_add_usb_device.h"
+#include "common_test_fixtures.hpp"
+
+extern "C" {
+#include "Mockusb_host.h"
+}
+
+#if CONFIG_CDC_ACM_STATIC_POOL
+
+static usb_transfer_t *submitted_in_xfer = nullptr; // Last submitted IN transfer
+
+static esp_err_t _submit_record_in_callback(usb_transfer_t *transfer, int call_count)
+{
+    if (transfer->bEndpointAddress & 0x80) {
+        submitted_in_xfer = transfer;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Test static device pool
+ *
+ * Build with sdkconfig.ci.static_pool. The pool has one device, so it is exhausted by one mocked device
+ */
+SCENARIO("Static device pool")
+{
+    SECTION("Add mocked device") {
+        usb_host_mock_dev_list_init();
+
+        // CP210x (FS descriptor)
+        REQUIRE(ESP_OK == usb_host_mock_add_device(5, (const usb_device_desc_t *)cp210x_device_desc,
+                (const usb_config_desc_t *)cp210x_config_desc));
+    }
+
+    GIVEN("Mocked device is added to the device list") {
+        REQUIRE(ESP_OK == test_cdc_acm_host_install(nullptr));
+
+        cdc_acm_dev_hdl_t dev = nullptr;
+        const cdc_acm_host_device_config_t dev_config = {
+            .connection_timeout_ms = 1000,
+            .out_buffer_size = 64,
+            .in_buffer_size = 64,
+            .event_cb = nullptr,
+            .data_cb = nullptr,
+            .user_arg = nullptr,
+        };
+        const uint16_t vid = 0x10C4, pid = 0xEA60;
+        const uint8_t device_address = 5, interface_index = 0;
+
+        cdc_acm_host_pool_stats_t pool_stats;
+        REQUIRE(ESP_OK == cdc_acm_host_pool_stats_get(&pool_stats));
+        REQUIRE(pool_stats.size == 1);
+        REQUIRE(pool_stats.in_use == 0);
+        REQUIRE(pool_stats.high_water == 0);
+
+        SECTION("Fail to open CDC-ACM Device: pool is exhausted") {
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+
+            // No USB Host Library function is called, the pool is checked first
+            cdc_acm_dev_hdl_t dev_2 = nullptr;
+            REQUIRE(ESP_ERR_NO_MEM == cdc_acm_host_open(vid, pid, interface_index, &dev_config, &dev_2));
+            REQUIRE(dev_2 == nullptr);
+
+            REQUIRE(ESP_OK == cdc_acm_host_pool_stats_get(&pool_stats));
+            REQUIRE(pool_stats.in_use == 1);
+            REQUIRE(pool_stats.high_water == 1);
+
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Fail to open CDC-ACM Device: RX ring or TX queue larger than reserved in the pool") {
+            // No USB Host Library function is called, the config is checked first
+            cdc_acm_host_device_config_t large_config = dev_config;
+            large_config.rx_ring_size = CONFIG_CDC_ACM_STATIC_POOL_RX_RING_SIZE + 1;
+            REQUIRE(ESP_ERR_NOT_SUPPORTED == cdc_acm_host_open(vid, pid, interface_index, &large_config, &dev));
+            large_config.rx_ring_size = 0;
+            large_config.tx_queue_len = CONFIG_CDC_ACM_STATIC_POOL_TX_QUEUE_LEN + 1;
+            REQUIRE(ESP_ERR_NOT_SUPPORTED == cdc_acm_host_open(vid, pid, interface_index, &large_config, &dev));
+            REQUIRE(dev == nullptr);
+
+            REQUIRE(ESP_OK == cdc_acm_host_pool_stats_get(&pool_stats));
+            REQUIRE(pool_stats.in_use == 0);
+        }
+
+        SECTION("Closed device returns its slot and transfers to the pool") {
+            submitted_in_xfer = nullptr;
+            usb_host_transfer_submit_AddCallback(_submit_record_in_callback);
+
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            usb_transfer_t *first_in_xfer = submitted_in_xfer;
+            REQUIRE(first_in_xfer != nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+
+            REQUIRE(ESP_OK == cdc_acm_host_pool_stats_get(&pool_stats));
+            REQUIRE(pool_stats.in_use == 0);
+            REQUIRE(pool_stats.high_water == 1);
+
+            // The only slot is taken again, together with the transfers it kept
+            submitted_in_xfer = nullptr;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            REQUIRE(submitted_in_xfer == first_in_xfer);
+
+            REQUIRE(ESP_OK == cdc_acm_host_pool_stats_get(&pool_stats));
+            REQUIRE(pool_stats.in_use == 1);
+            REQUIRE(pool_stats.high_water == 1);
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        REQUIRE(ESP_OK == test_cdc_acm_host_uninstall());
+    }
+}
+
+#else
+
+SCENARIO("Static device pool is disabled")
+{
+    cdc_acm_host_pool_stats_t pool_stats;
+    REQUIRE(ESP_ERR_NOT_SUPPORTED == cdc_acm_host_pool_stats_get(&pool_stats));
+}
+
+#endif // CONFIG_CDC_ACM_STATIC_POOL
@@ -0,0 +1,648 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "descriptors/cdc_descriptors.hpp"
+#include "usb/cdc_acm_host.h"
+#include "mock_add_usb_device.h"
+#include "common_test_fixtures.hpp"
+
+extern "C" {
+#include "Mockusb_host.h"
+}
+
+static std::deque<usb_transfer_t *> out_flight; // Submitted OUT transfers, in order of submission
+static std::vector<esp_err_t> tx_status;        // Statuses reported to the TX completion callback
+static std::vector<size_t> tx_len;              // Lengths reported to the TX completion callback
+
+/**
+ * @brief Record submitted OUT transfers instead of completing them
+ */
+static esp_err_t _submit_record_out_callback(usb_transfer_t *transfer, int call_count)
+{
+    if (!(transfer->bEndpointAddress & 0x80)) {
+        out_flight.push_back(transfer);
+    }
+    return ESP_OK;
+}
+
+static void _tx_done_cb(esp_err_t status, size_t data_len, void *user_arg)
+{
+    tx_status.push_back(status);
+    tx_len.push_back(data_len);
+}
+
+/**
+ * @brief Complete the oldest submitted OUT transfer
+ *
+ * @param[in] status Status of the transfer
+ */
+static void _complete_out_transfer(usb_transfer_status_t status)
+{
+    REQUIRE_FALSE(out_flight.empty());
+    usb_transfer_t *transfer = out_flight.front();
+    out_flight.pop_front();
+
+    transfer->status = status;
+    transfer->actual_num_bytes = (status == USB_TRANSFER_STATUS_COMPLETED) ? transfer->num_bytes : 0;
+    transfer->callback(transfer);
+}
+
+static std::vector<int> chunk_len;      // Lengths of submitted OUT transfers
+static std::vector<int> chunk_flags;    // Flags of submitted OUT transfers
+static std::vector<uint8_t> chunk_data; // Content of submitted OUT transfers
+static size_t chunk_depth_max;          // Maximum number of OUT transfers in flight
+static size_t chunk_depth;              // Number of OUT transfers in flight before the mocked device completes them
+
+/**
+ * @brief Emulate a device that completes OUT transfers only when 'chunk_depth' of them are in flight, or the write ends
+ */
+static esp_err_t _submit_pipeline_callback(usb_transfer_t *transfer, int call_count)
+{
+    if (transfer->bEndpointAddress & 0x80) {
+        return ESP_OK;
+    }
+    out_flight.push_back(transfer);
+    chunk_len.push_back(transfer->num_bytes);
+    chunk_flags.push_back(transfer->flags);
+    chunk_data.insert(chunk_data.end(), transfer->data_buffer, transfer->data_buffer + transfer->num_bytes);
+    chunk_depth_max = (out_flight.size() > chunk_depth_max) ? out_flight.size() : chunk_depth_max;
+    if ((out_flight.size() == chunk_depth) || (transfer->flags & USB_TRANSFER_FLAG_ZERO_PACK)) {
+        while (!out_flight.empty()) {
+            _complete_out_transfer(USB_TRANSFER_STATUS_COMPLETED);
+        }
+    }
+    return ESP_OK;
+}
+
+static std::vector<std::vector<uint8_t>> sent; // Content of OUT transfers completed by _submit_complete_callback
+
+/**
+ * @brief Emulate a device that completes every OUT transfer immediately
+ */
+static esp_err_t _submit_complete_callback(usb_transfer_t *transfer, int call_count)
+{
+    if (transfer->bEndpointAddress & 0x80) {
+        return ESP_OK;
+    }
+    sent.emplace_back(transfer->data_buffer, transfer->data_buffer + transfer->num_bytes);
+    transfer->status = USB_TRANSFER_STATUS_COMPLETED;
+    transfer->actual_num_bytes = transfer->num_bytes;
+    transfer->callback(transfer);
+    return ESP_OK;
+}
+
+/**
+ * @brief Emulate a device that accepts every CTRL request
+ */
+static esp_err_t _submit_control_complete_callback(usb_host_client_handle_t client_hdl, usb_transfer_t *transfer, int call_count)
+{
+    transfer->status = USB_TRANSFER_STATUS_COMPLETED;
+    transfer->actual_num_bytes = transfer->num_bytes;
+    transfer->callback(transfer);
+    return ESP_OK;
+}
+
+static usb_transfer_t *stale_out_xfer = nullptr; // OUT transfer of timed out blocking write
+static bool stale_out_returned;                   // stale_out_xfer was returned to the driver
+
+/**
+ * @brief Emulate late completion of canceled OUT transfer
+ *
+ * The first OUT transfer never completes. It is returned to the driver as canceled right before the next OUT transfer completes
+ */
+static esp_err_t _submit_late_cancel_callback(usb_transfer_t *transfer, int call_count)
+{
+    if (transfer->bEndpointAddress & 0x80) {
+        return ESP_OK;
+    }
+    if (!stale_out_xfer) {
+        stale_out_xfer = transfer;
+        return ESP_OK;
+    }
+    if (!stale_out_returned) {
+        stale_out_returned = true;
+        stale_out_xfer->status = USB_TRANSFER_STATUS_CANCELED;
+        stale_out_xfer->actual_num_bytes = 0;
+        stale_out_xfer->callback(stale_out_xfer);
+    }
+    return _submit_complete_callback(transfer, call_count);
+}
+
+static cdc_acm_dev_hdl_t queue_dev;  // Device used by _blocked_tx_task and _close_task
+static esp_err_t blocked_tx_ret;     // Return value of cdc_acm_host_data_tx_queue() in _blocked_tx_task
+static bool blocked_tx_returned;     // _blocked_tx_task returned from cdc_acm_host_data_tx_queue()
+static esp_err_t close_ret;          // Return value of test_cdc_acm_host_close() in _close_task
+static bool close_returned;          // _close_task returned from test_cdc_acm_host_close()
+
+/**
+ * @brief Queue data to full TX queue with BLOCK policy
+ */
+static void _blocked_tx_task(void *arg)
+{
+    static const uint8_t tx_buf[] = "XYZ";
+    blocked_tx_ret = cdc_acm_host_data_tx_queue(queue_dev, tx_buf, sizeof(tx_buf), _tx_done_cb, nullptr, 5000);
+    blocked_tx_returned = true;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Close the device from another task, so the test can complete transfers meanwhile
+ */
+static void _close_task(void *arg)
+{
+    close_ret = test_cdc_acm_host_close(&queue_dev, 0);
+    close_returned = true;
+    vTaskDelete(NULL);
+}
+
+static TickType_t probe_timer_tick; // Tick count when _probe_timer_cb ran
+
+static void _probe_timer_cb(TimerHandle_t timer)
+{
+    probe_timer_tick = xTaskGetTickCount();
+}
+
+static std::vector<uint8_t> _bytes(const char *str)
+{
+    return std::vector<uint8_t>(str, str + strlen(str));
+}
+
+SCENARIO("Asynchronous bulk OUT transfers")
+{
+    SECTION("Add mocked device") {
+        usb_host_mock_dev_list_init();
+
+        // CP210x (FS descriptor)
+        REQUIRE(ESP_OK == usb_host_mock_add_device(7, (const usb_device_desc_t *)cp210x_device_desc,
+                (const usb_config_desc_t *)cp210x_config_desc));
+
+        // CH340 (FS descriptor), it has a notification endpoint, so it accepts CDC requests
+        REQUIRE(ESP_OK == usb_host_mock_add_device(8, (const usb_device_desc_t *)ch340_device_desc,
+                (const usb_config_desc_t *)ch340_config_desc));
+    }
+
+    GIVEN("Mocked device is added to the device list") {
+        REQUIRE(ESP_OK == test_cdc_acm_host_install(nullptr));
+
+        cdc_acm_dev_hdl_t dev = nullptr;
+        cdc_acm_host_device_config_t dev_config = {
+            .connection_timeout_ms = 1000,
+            .out_buffer_size = 64,
+            .in_buffer_size = 64,
+            .event_cb = nullptr,
+            .data_cb = nullptr,
+            .user_arg = nullptr,
+        };
+        dev_config.out_transfer_count = 3;
+        const uint16_t vid = 0x10C4, pid = 0xEA60;
+        const uint8_t device_address = 7, interface_index = 0;
+
+        SECTION("Fail to open CDC-ACM Device: too many OUT transfers") {
+            dev_config.out_transfer_count = 9;
+            REQUIRE(ESP_ERR_INVALID_ARG == cdc_acm_host_open(vid, pid, interface_index, &dev_config, &dev));
+        }
+
+        SECTION("Multiple OUT transfers are in flight") {
+            out_flight.clear();
+            tx_status.clear();
+            tx_len.clear();
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            usb_host_transfer_submit_AddCallback(_submit_record_out_callback);
+
+            const uint8_t tx_buf[] = "HELLO";
+            for (size_t i = 1; i <= dev_config.out_transfer_count; i++) {
+                usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+                REQUIRE(ESP_OK == cdc_acm_host_data_tx_async(dev, tx_buf, i, _tx_done_cb, nullptr));
+            }
+            REQUIRE(out_flight.size() == dev_config.out_transfer_count);
+            REQUIRE(tx_status.empty());
+
+            // All transfers are in flight, the caller is not blocked
+            REQUIRE(ESP_ERR_NO_MEM == cdc_acm_host_data_tx_async(dev, tx_buf, sizeof(tx_buf), _tx_done_cb, nullptr));
+            REQUIRE(ESP_ERR_INVALID_SIZE == cdc_acm_host_data_tx_async(dev, tx_buf, 65, _tx_done_cb, nullptr));
+
+            // Completed transfer can be reused
+            _complete_out_transfer(USB_TRANSFER_STATUS_COMPLETED);
+            REQUIRE(tx_status == std::vector<esp_err_t>({ESP_OK}));
+            REQUIRE(tx_len == std::vector<size_t>({1}));
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_async(dev, tx_buf, sizeof(tx_buf), nullptr, nullptr));
+
+            // Completion is reported in order of submission, errors are reported too
+            _complete_out_transfer(USB_TRANSFER_STATUS_COMPLETED);
+            _complete_out_transfer(USB_TRANSFER_STATUS_STALL);
+            _complete_out_transfer(USB_TRANSFER_STATUS_COMPLETED);
+            REQUIRE(tx_status == std::vector<esp_err_t>({ESP_OK, ESP_OK, ESP_ERR_INVALID_RESPONSE}));
+            REQUIRE(tx_len == std::vector<size_t>({1, 2, 0}));
+
+            cdc_acm_host_stats_t stats;
+            REQUIRE(ESP_OK == cdc_acm_host_stats_get(dev, &stats));
+            REQUIRE(stats.tx_transfers == 3);
+            REQUIRE(stats.tx_bytes == 1 + 2 + sizeof(tx_buf));
+            REQUIRE(stats.xfer_stalls == 1);
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Large write is split into pipelined chunks") {
+            out_flight.clear();
+            chunk_len.clear();
+            chunk_flags.clear();
+            chunk_depth_max = 0;
+            chunk_depth = dev_config.out_transfer_count;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            usb_host_transfer_submit_AddCallback(_submit_pipeline_callback);
+
+            uint8_t tx_buf[200];
+            memset(tx_buf, 0xAA, sizeof(tx_buf));
+            for (int i = 0; i < 4; i++) {
+                usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            }
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_blocking(dev, tx_buf, sizeof(tx_buf), 100));
+            REQUIRE(chunk_len == std::vector<int>({64, 64, 64, 8}));
+            REQUIRE(chunk_depth_max == dev_config.out_transfer_count);
+            // Only the last chunk may be terminated by a zero-length packet
+            REQUIRE(chunk_flags == std::vector<int>({0, 0, 0, USB_TRANSFER_FLAG_ZERO_PACK}));
+
+            // Write of whole packets ends with zero-length packet flag
+            chunk_len.clear();
+            chunk_flags.clear();
+            for (int i = 0; i < 2; i++) {
+                usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            }
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_blocking(dev, tx_buf, 128, 100));
+            REQUIRE(chunk_len == std::vector<int>({64, 64}));
+            REQUIRE(chunk_flags == std::vector<int>({0, USB_TRANSFER_FLAG_ZERO_PACK}));
+
+            // Scatter-gather list is sent as one write
+            chunk_len.clear();
+            chunk_flags.clear();
+            chunk_data.clear();
+            const uint8_t prefix[] = {'A', 'T'};
+            const uint8_t terminator[] = {'\r'};
+            const cdc_iovec_t iov[] = {
+                {prefix, sizeof(prefix)},
+                {tx_buf, 100},
+                {nullptr, 0},
+                {terminator, sizeof(terminator)},
+            };
+            std::vector<uint8_t> expected(prefix, prefix + sizeof(prefix));
+            expected.insert(expected.end(), tx_buf, tx_buf + 100);
+            expected.insert(expected.end(), terminator, terminator + sizeof(terminator));
+            for (int i = 0; i < 2; i++) {
+                usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            }
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_iov(dev, iov, 4, 100));
+            REQUIRE(chunk_len == std::vector<int>({64, 39}));
+            REQUIRE(chunk_data == expected);
+            REQUIRE(ESP_ERR_INVALID_ARG == cdc_acm_host_data_tx_iov(dev, &iov[2], 1, 100));
+
+            // Coalescing and TX queue were not enabled
+            REQUIRE(ESP_ERR_NOT_SUPPORTED == cdc_acm_host_data_tx_coalesced(dev, tx_buf, 1, 0));
+            REQUIRE(ESP_ERR_NOT_SUPPORTED == cdc_acm_host_data_tx_queue(dev, tx_buf, 1, nullptr, nullptr, 0));
+
+            // Asynchronous writes are limited to one OUT buffer
+            REQUIRE(ESP_ERR_INVALID_SIZE == cdc_acm_host_data_tx_async(dev, tx_buf, sizeof(tx_buf), nullptr, nullptr));
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Data are written directly to OUT transfer buffer") {
+            sent.clear();
+            dev_config.out_transfer_count = 2;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            usb_host_transfer_submit_AddCallback(_submit_complete_callback);
+
+            uint8_t *buf = nullptr;
+            size_t cap = 0;
+            REQUIRE(ESP_ERR_INVALID_STATE == cdc_acm_host_tx_commit(dev, 1));
+            REQUIRE(ESP_OK == cdc_acm_host_tx_acquire(dev, &buf, &cap, 0));
+            REQUIRE(buf != nullptr);
+            REQUIRE(cap >= dev_config.out_buffer_size);
+
+            // Only one buffer can be acquired at a time
+            uint8_t *buf2 = nullptr;
+            REQUIRE(ESP_ERR_INVALID_STATE == cdc_acm_host_tx_acquire(dev, &buf2, &cap, 0));
+
+            memcpy(buf, "FA;", 3);
+            REQUIRE(ESP_ERR_INVALID_SIZE == cdc_acm_host_tx_commit(dev, cap + 1));
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_tx_commit(dev, 3));
+            REQUIRE(sent == std::vector<std::vector<uint8_t>>({_bytes("FA;")}));
+
+            // Empty commit releases the buffer without sending
+            REQUIRE(ESP_OK == cdc_acm_host_tx_acquire(dev, &buf, &cap, 0));
+            REQUIRE(ESP_OK == cdc_acm_host_tx_commit(dev, 0));
+            REQUIRE(sent.size() == 1);
+
+            // Acquired buffer is dropped on close
+            REQUIRE(ESP_OK == cdc_acm_host_tx_acquire(dev, &buf, &cap, 0));
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Short writes are coalesced") {
+            sent.clear();
+            dev_config.out_transfer_count = 1;
+            dev_config.tx_coalesce_ms = 20;
+            dev_config.tx_flush_on_delimiter = true;
+            dev_config.tx_delimiter = ';';
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            usb_host_transfer_submit_AddCallback(_submit_complete_callback);
+
+            // Delimiter flushes the data written so far, the rest waits for the next write
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_coalesced(dev, (const uint8_t *)"A", 1, 0));
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_coalesced(dev, (const uint8_t *)"B", 1, 0));
+            REQUIRE(sent.empty());
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_coalesced(dev, (const uint8_t *)"C;D", 3, 0));
+            REQUIRE(sent == std::vector<std::vector<uint8_t>>({_bytes("ABC;")}));
+
+            // Data without delimiter are sent at the deadline
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            vTaskDelay(pdMS_TO_TICKS(100));
+            REQUIRE(sent.size() == 2);
+            REQUIRE(sent[1] == _bytes("D"));
+
+            // Full OUT buffer is sent immediately
+            uint8_t tx_buf[70];
+            memset(tx_buf, 'x', sizeof(tx_buf));
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_coalesced(dev, tx_buf, sizeof(tx_buf), 0));
+            REQUIRE(sent.size() == 3);
+            REQUIRE(sent[2].size() == 64);
+
+            cdc_acm_host_stats_t stats;
+            REQUIRE(ESP_OK == cdc_acm_host_stats_get(dev, &stats));
+            REQUIRE(stats.tx_coalesced_writes == 4);
+            REQUIRE(stats.tx_coalesce_flushes == 3);
+            REQUIRE(stats.tx_coalesce_latency_max_ms >= 20);
+
+            // Pending data are dropped on close
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+            REQUIRE(sent.size() == 3);
+        }
+
+        SECTION("Coalescing deadline does not block timer service when OUT transfers are exhausted") {
+            out_flight.clear();
+            dev_config.out_transfer_count = 2;
+            dev_config.tx_coalesce_ms = 20;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            usb_host_transfer_submit_AddCallback(_submit_record_out_callback);
+
+            // First OUT transfer is pending in the coalescing buffer, second one is in flight
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_coalesced(dev, (const uint8_t *)"A", 1, 0));
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_async(dev, (const uint8_t *)"B", 1, nullptr, nullptr));
+            vTaskDelay(1); // Let the timer service task start the deadline timer
+
+            // Stay above the timer service task until the deadline has passed, so the deadline timer
+            // expires while the next write holds the coalescing buffer and waits for an idle OUT transfer
+            probe_timer_tick = 0;
+            TimerHandle_t probe_timer = xTimerCreate("probe", pdMS_TO_TICKS(50), pdFALSE, nullptr, _probe_timer_cb);
+            REQUIRE(probe_timer != nullptr);
+            REQUIRE(pdPASS == xTimerStart(probe_timer, 0));
+            const UBaseType_t priority = uxTaskPriorityGet(nullptr);
+            vTaskPrioritySet(nullptr, configTIMER_TASK_PRIORITY + 1);
+            const TickType_t write_start = xTaskGetTickCount();
+            while (xTaskGetTickCount() - write_start < pdMS_TO_TICKS(30)) {
+            }
+
+            uint8_t tx_buf[64];
+            memset(tx_buf, 'x', sizeof(tx_buf));
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_ERR_TIMEOUT == cdc_acm_host_data_tx_coalesced(dev, tx_buf, sizeof(tx_buf), 300));
+            vTaskPrioritySet(nullptr, priority);
+
+            // Other timers kept running while the write was blocked
+            REQUIRE(probe_timer_tick != 0);
+            REQUIRE(probe_timer_tick - write_start < pdMS_TO_TICKS(200));
+            xTimerDelete(probe_timer, portMAX_DELAY);
+
+            // The full coalescing buffer was sent
+            REQUIRE(out_flight.size() == 2);
+            REQUIRE(out_flight.back()->num_bytes == 64);
+            while (!out_flight.empty()) {
+                _complete_out_transfer(USB_TRANSFER_STATUS_COMPLETED);
+            }
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Queued writes are sent by TX task") {
+            out_flight.clear();
+            tx_status.clear();
+            tx_len.clear();
+            dev_config.tx_queue_len = 2;
+            dev_config.tx_queue_full_policy = CDC_ACM_TX_QUEUE_DROP_OLDEST;
+            dev_config.tx_task_priority = 5;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            usb_host_transfer_submit_AddCallback(_submit_record_out_callback);
+
+            // TX task takes the first item and waits for its OUT transfer, the caller is not blocked
+            const uint8_t tx_buf[] = "ABCD";
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_queue(dev, tx_buf, 1, _tx_done_cb, nullptr, 0));
+            vTaskDelay(pdMS_TO_TICKS(10));
+            REQUIRE(out_flight.size() == 1);
+
+            // Full queue drops the oldest item
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_queue(dev, tx_buf, 2, _tx_done_cb, nullptr, 0));
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_queue(dev, tx_buf, 3, _tx_done_cb, nullptr, 0));
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_queue(dev, tx_buf, 4, _tx_done_cb, nullptr, 0));
+            REQUIRE(tx_status == std::vector<esp_err_t>({ESP_ERR_NO_MEM}));
+
+            cdc_acm_host_stats_t stats;
+            REQUIRE(ESP_OK == cdc_acm_host_stats_get(dev, &stats));
+            REQUIRE(stats.tx_queue_depth == 2);
+            REQUIRE(stats.tx_queue_depth_max == 2);
+            REQUIRE(stats.tx_queue_drops == 1);
+
+            // Remaining items are sent in order
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            for (int i = 0; i < 3; i++) {
+                _complete_out_transfer(USB_TRANSFER_STATUS_COMPLETED);
+                vTaskDelay(pdMS_TO_TICKS(10));
+            }
+            REQUIRE(out_flight.empty());
+            REQUIRE(tx_status == std::vector<esp_err_t>({ESP_ERR_NO_MEM, ESP_OK, ESP_OK, ESP_OK}));
+            REQUIRE(tx_len == std::vector<size_t>({0, 1, 3, 4}));
+            REQUIRE(ESP_OK == cdc_acm_host_stats_get(dev, &stats));
+            REQUIRE(stats.tx_queue_depth == 0);
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Close releases writer blocked on full TX queue") {
+            out_flight.clear();
+            tx_status.clear();
+            tx_len.clear();
+            blocked_tx_returned = false;
+            close_returned = false;
+            dev_config.tx_queue_len = 1;
+            dev_config.tx_queue_full_policy = CDC_ACM_TX_QUEUE_BLOCK;
+            dev_config.tx_task_priority = 5;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &queue_dev));
+            REQUIRE(queue_dev != nullptr);
+            usb_host_transfer_submit_AddCallback(_submit_record_out_callback);
+
+            // TX task waits for the first OUT transfer, the second item fills the queue and the third writer blocks
+            const uint8_t tx_buf[] = "ABCD";
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_queue(queue_dev, tx_buf, 1, _tx_done_cb, nullptr, 0));
+            vTaskDelay(pdMS_TO_TICKS(10));
+            REQUIRE(out_flight.size() == 1);
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_queue(queue_dev, tx_buf, 2, _tx_done_cb, nullptr, 0));
+            REQUIRE(pdPASS == xTaskCreate(_blocked_tx_task, "blocked_tx", 4096, nullptr, 5, nullptr));
+            vTaskDelay(pdMS_TO_TICKS(10));
+            REQUIRE_FALSE(blocked_tx_returned);
+
+            // Close lets the blocked writer through and fails the queued items without sending them
+            REQUIRE(pdPASS == xTaskCreate(_close_task, "close", 4096, nullptr, 5, nullptr));
+            vTaskDelay(pdMS_TO_TICKS(10));
+            REQUIRE(blocked_tx_returned);
+            REQUIRE(blocked_tx_ret == ESP_OK);
+            REQUIRE(tx_status == std::vector<esp_err_t>({ESP_ERR_INVALID_STATE, ESP_ERR_INVALID_STATE}));
+            REQUIRE(out_flight.size() == 1);
+
+            // Close waits for the item being sent by TX task
+            REQUIRE_FALSE(close_returned);
+            _complete_out_transfer(USB_TRANSFER_STATUS_COMPLETED);
+            vTaskDelay(pdMS_TO_TICKS(10));
+            REQUIRE(close_returned);
+            REQUIRE(close_ret == ESP_OK);
+            REQUIRE(tx_status == std::vector<esp_err_t>({ESP_ERR_INVALID_STATE, ESP_ERR_INVALID_STATE, ESP_OK}));
+            REQUIRE(tx_len == std::vector<size_t>({0, 0, 1}));
+            usb_host_transfer_submit_AddCallback(nullptr);
+        }
+
+        SECTION("Late completion of timed out blocking write does not affect the next write") {
+            sent.clear();
+            stale_out_xfer = nullptr;
+            stale_out_returned = false;
+            dev_config.out_transfer_count = 2;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            usb_host_transfer_submit_AddCallback(_submit_late_cancel_callback);
+
+            // The device does not respond, the endpoint is reset, but the canceled transfer is not returned yet
+            const uint8_t tx_buf[] = "HELLO";
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            test_cdc_acm_reset_transfer_endpoint(0x02);
+            REQUIRE(ESP_ERR_TIMEOUT == cdc_acm_host_data_tx_blocking(dev, tx_buf, sizeof(tx_buf), 20));
+            REQUIRE(stale_out_xfer != nullptr);
+
+            // The canceled transfer completes while the next write waits for its own transfer
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_blocking(dev, tx_buf, sizeof(tx_buf), 100));
+            REQUIRE(stale_out_returned);
+            REQUIRE(sent == std::vector<std::vector<uint8_t>>({std::vector<uint8_t>(tx_buf, tx_buf + sizeof(tx_buf))}));
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Timed out blocking write does not cancel transfers of other TX functions") {
+            out_flight.clear();
+            tx_status.clear();
+            tx_len.clear();
+            dev_config.out_transfer_count = 2;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            usb_host_transfer_submit_AddCallback(_submit_record_out_callback);
+
+            const uint8_t tx_buf[] = "HELLO";
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_async(dev, tx_buf, sizeof(tx_buf), _tx_done_cb, nullptr));
+
+            // The device does not respond, the endpoint is not reset while the asynchronous transfer is in flight
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_ERR_TIMEOUT == cdc_acm_host_data_tx_blocking(dev, tx_buf, sizeof(tx_buf), 20));
+            REQUIRE(out_flight.size() == 2);
+            REQUIRE(tx_status.empty());
+
+            // Asynchronous transfer completes normally, late completion of the blocking write is not reported
+            _complete_out_transfer(USB_TRANSFER_STATUS_COMPLETED);
+            _complete_out_transfer(USB_TRANSFER_STATUS_COMPLETED);
+            REQUIRE(tx_status == std::vector<esp_err_t>({ESP_OK}));
+            REQUIRE(tx_len == std::vector<size_t>({sizeof(tx_buf)}));
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        SECTION("Blocking writes are paced to UART rate") {
+            sent.clear();
+            dev_config.out_transfer_count = 1;
+            dev_config.tx_pacing = true;
+            dev_config.tx_pacing_fifo_size = 64;
+            REQUIRE(ESP_OK == test_cdc_acm_host_open(8, 0x1A86, 0x7523, interface_index, &dev_config, &dev));
+            REQUIRE(dev != nullptr);
+            usb_host_transfer_submit_AddCallback(_submit_complete_callback);
+            usb_host_transfer_submit_control_AddCallback(_submit_control_complete_callback);
+
+            uint8_t tx_buf[64];
+            memset(tx_buf, 'x', sizeof(tx_buf));
+
+            // Without line coding the rate is unknown, data are not paced
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_blocking(dev, tx_buf, sizeof(tx_buf), 100));
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_blocking(dev, tx_buf, sizeof(tx_buf), 100));
+
+            // 9600 8N1 sends 960 bytes per second, the second write waits until the first one leaves the FIFO
+            cdc_acm_line_coding_t line_coding = {
+                .dwDTERate = 9600,
+                .bCharFormat = 0,
+                .bParityType = 0,
+                .bDataBits = 8,
+            };
+            usb_host_transfer_submit_control_ExpectAnyArgsAndReturn(ESP_OK);
+            REQUIRE(ESP_OK == cdc_acm_host_line_coding_set(dev, &line_coding));
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+            const TickType_t start = xTaskGetTickCount();
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_blocking(dev, tx_buf, sizeof(tx_buf), 200));
+            REQUIRE(ESP_OK == cdc_acm_host_data_tx_blocking(dev, tx_buf, sizeof(tx_buf), 200));
+            REQUIRE(xTaskGetTickCount() - start >= pdMS_TO_TICKS(60));
+            REQUIRE(sent.size() == 4);
+
+            // Pacing delay longer than the timeout fails immediately
+            REQUIRE(ESP_ERR_TIMEOUT == cdc_acm_host_data_tx_blocking(dev, tx_buf, sizeof(tx_buf), 10));
+
+            cdc_acm_host_stats_t stats;
+            REQUIRE(ESP_OK == cdc_acm_host_stats_get(dev, &stats));
+            REQUIRE(stats.tx_pace_waits == 1);
+            REQUIRE(stats.tx_pace_wait_ms >= 60);
+
+            usb_host_transfer_submit_AddCallback(nullptr);
+            usb_host_transfer_submit_control_AddCallback(nullptr);
+            REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+        }
+
+        REQUIRE(ESP_OK == test_cdc_acm_host_uninstall());
+    }
+}
@@ -21,8 +21,8 @@
     REQUIRE((parsed_result).data_intf != nullptr); \
     REQUIRE((parsed_result).in_ep != nullptr); \
     REQUIRE((parsed_result).out_ep != nullptr); \
-    REQUIRE((parsed_result).func != nullptr); \
-    REQUIRE((parsed_result).func_cnt == nb_of_cdc_specific);
+    REQUIRE((parsed_result).func_cnt == nb_of_cdc_specific); \
+    REQUIRE((parsed_result).func[0].offset != 0);
 
 /**
  * @brief Helper to check parsing result of CDC non-compliant devices
@@ -36,7 +36,6 @@
     REQUIRE((parsed_result).data_intf != nullptr); \
     REQUIRE((parsed_result).in_ep != nullptr); \
     REQUIRE((parsed_result).out_ep != nullptr); \
-    REQUIRE((parsed_result).func == nullptr); \
     REQUIRE((parsed_result).func_cnt == 0);
 
 /**
@@ -51,5 +50,4 @@
     REQUIRE((parsed_result).data_intf != nullptr); \
     REQUIRE((parsed_result).in_ep != nullptr); \
     REQUIRE((parsed_result).out_ep != nullptr); \
-    REQUIRE((parsed_result).func == nullptr); \
     REQUIRE((parsed_result).func_cnt == 0);
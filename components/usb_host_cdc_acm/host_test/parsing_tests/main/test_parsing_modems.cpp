@@ -5,6 +5,7 @@
  */
 
 #include <stdio.h>
+#include <vector>
 #include <catch2/catch_test_macros.hpp>
 #include "usb/usb_helpers.h"
 
@@ -259,3 +260,91 @@ SCENARIO("Modems descriptor parsing: A7672E", "[modem][A7672E]")
         }
     }
 }
+
+SCENARIO("Modems descriptor parsing: interleaved devices", "[modem][BG96][7600E]")
+{
+    GIVEN("Quactel BG96 FS and SimCom 7600E FS") {
+        const usb_device_desc_t *bg96_dev_desc = (const usb_device_desc_t *)bg96_device_desc_fs_hs;
+        const usb_config_desc_t *bg96_cfg_desc = (const usb_config_desc_t *)bg96_config_desc_fs;
+        const usb_device_desc_t *sim_dev_desc = (const usb_device_desc_t *)sim7600e_device_desc_fs_hs;
+        const usb_config_desc_t *sim_cfg_desc = (const usb_config_desc_t *)sim7600e_config_desc_fs;
+
+        // Parsing another Configuration descriptor in between must not change the result
+        SECTION("Interface 2") {
+            cdc_parsed_info_t first_result = {};
+            cdc_parsed_info_t other_result = {};
+            cdc_parsed_info_t second_result = {};
+            esp_err_t ret = cdc_parse_interface_descriptor(bg96_dev_desc, bg96_cfg_desc, 2, &first_result);
+            REQUIRE_CDC_NONCOMPLIANT_WITH_NOTIFICATION(ret, first_result);
+            ret = cdc_parse_interface_descriptor(sim_dev_desc, sim_cfg_desc, 2, &other_result);
+            REQUIRE_CDC_NONCOMPLIANT_WITH_NOTIFICATION(ret, other_result);
+            ret = cdc_parse_interface_descriptor(bg96_dev_desc, bg96_cfg_desc, 2, &second_result);
+            REQUIRE_CDC_NONCOMPLIANT_WITH_NOTIFICATION(ret, second_result);
+
+            REQUIRE((const uint8_t *)other_result.data_intf > (const uint8_t *)sim_cfg_desc);
+            REQUIRE((const uint8_t *)other_result.data_intf < (const uint8_t *)sim_cfg_desc + sim_cfg_desc->wTotalLength);
+            REQUIRE(second_result.notif_intf == first_result.notif_intf);
+            REQUIRE(second_result.notif_ep == first_result.notif_ep);
+            REQUIRE(second_result.data_intf == first_result.data_intf);
+            REQUIRE(second_result.in_ep == first_result.in_ep);
+            REQUIRE(second_result.out_ep == first_result.out_ep);
+        }
+    }
+}
+
+/**
+ * @brief Find Interface descriptor in Configuration descriptor
+ *
+ * @param[in] cfg              Configuration descriptor
+ * @param[in] bInterfaceNumber Interface number, alternate setting 0 is returned
+ * @return Offset of the Interface descriptor, 0 if not found
+ */
+static size_t _find_interface(const std::vector<uint8_t> &cfg, uint8_t bInterfaceNumber)
+{
+    for (size_t offset = 0; offset + 3 < cfg.size() && cfg[offset] != 0; offset += cfg[offset]) {
+        if (cfg[offset + 1] == USB_B_DESCRIPTOR_TYPE_INTERFACE && cfg[offset + 2] == bInterfaceNumber && cfg[offset + 3] == 0) {
+            return offset;
+        }
+    }
+    return 0;
+}
+
+SCENARIO("Modems descriptor parsing: malformed descriptors", "[modem][BG96]")
+{
+    GIVEN("Quactel BG96 FS with modified Configuration descriptor") {
+        const usb_device_desc_t *dev_desc = (const usb_device_desc_t *)bg96_device_desc_fs_hs;
+        std::vector<uint8_t> cfg(bg96_config_desc_fs, bg96_config_desc_fs + sizeof(bg96_config_desc_fs));
+
+        SECTION("Truncated trailing Interface descriptor is ignored") {
+            // Interface descriptor of interface 5 claims 9 bytes, only 4 are within wTotalLength
+            const uint8_t truncated_intf[] = {0x09, USB_B_DESCRIPTOR_TYPE_INTERFACE, 0x05, 0x00};
+            cfg.insert(cfg.end(), truncated_intf, truncated_intf + sizeof(truncated_intf));
+            usb_config_desc_t *cfg_desc = (usb_config_desc_t *)cfg.data();
+            cfg_desc->wTotalLength = cfg.size();
+
+            cdc_parsed_info_t parsed_result = {};
+            esp_err_t ret = cdc_parse_interface_descriptor(dev_desc, cfg_desc, 5, &parsed_result);
+            REQUIRE(ret == ESP_ERR_NOT_FOUND);
+
+            // Descriptors before the truncated one are parsed
+            ret = cdc_parse_interface_descriptor(dev_desc, cfg_desc, 2, &parsed_result);
+            REQUIRE_CDC_NONCOMPLIANT_WITH_NOTIFICATION(ret, parsed_result);
+        }
+
+        SECTION("Endpoints of the next interface are not used") {
+            // Interface 0 claims one endpoint more than it has
+            const size_t intf_offset = _find_interface(cfg, 0);
+            REQUIRE(intf_offset != 0);
+            cfg[intf_offset + 4]++; // bNumEndpoints
+            const usb_config_desc_t *cfg_desc = (const usb_config_desc_t *)cfg.data();
+
+            cdc_parsed_info_t parsed_result = {};
+            esp_err_t ret = cdc_parse_interface_descriptor(dev_desc, cfg_desc, 0, &parsed_result);
+            REQUIRE(ret == ESP_ERR_NOT_FOUND);
+
+            // Other interfaces are not affected
+            ret = cdc_parse_interface_descriptor(dev_desc, cfg_desc, 1, &parsed_result);
+            REQUIRE_CDC_NONCOMPLIANT(ret, parsed_result);
+        }
+    }
+}
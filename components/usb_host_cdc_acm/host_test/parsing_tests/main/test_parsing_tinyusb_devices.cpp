@@ -5,6 +5,9 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
 #include <catch2/catch_test_macros.hpp>
 #include "usb/usb_helpers.h"
 
@@ -82,3 +85,43 @@ SCENARIO("TinyUSB devices descriptor parsing", "[tinyusb]")
         }
     }
 }
+
+SCENARIO("Parsing cache", "[cache]")
+{
+    GIVEN("TinyUSB single FS") {
+        const usb_device_desc_t *dev_desc = (const usb_device_desc_t *)tusb_serial_device_device_desc_fs_hs;
+        const usb_config_desc_t *cfg_desc = (const usb_config_desc_t *)tusb_serial_device_config_desc_fs;
+        cdc_parse_cache_clear();
+
+        cdc_parsed_info_t parsed_result = {};
+        esp_err_t ret = cdc_parse_interface_descriptor_cached(dev_desc, cfg_desc, 0, &parsed_result);
+        REQUIRE_CDC_COMPLIANT(ret, parsed_result, 4);
+
+        SECTION("Reconnected device is rebuilt from cache") {
+            // Copy of the Configuration descriptor emulates the same device connected again
+            std::vector<uint8_t> cfg_copy(sizeof(tusb_serial_device_config_desc_fs));
+            memcpy(cfg_copy.data(), tusb_serial_device_config_desc_fs, cfg_copy.size());
+            const usb_config_desc_t *cfg_desc_copy = (const usb_config_desc_t *)cfg_copy.data();
+            const ptrdiff_t shift = cfg_copy.data() - tusb_serial_device_config_desc_fs;
+
+            cdc_parsed_info_t cached_result = {};
+            ret = cdc_parse_interface_descriptor_cached(dev_desc, cfg_desc_copy, 0, &cached_result);
+            REQUIRE_CDC_COMPLIANT(ret, cached_result, 4);
+            REQUIRE((const uint8_t *)cached_result.notif_ep == (const uint8_t *)parsed_result.notif_ep + shift);
+            REQUIRE((const uint8_t *)cached_result.in_ep == (const uint8_t *)parsed_result.in_ep + shift);
+            REQUIRE((const uint8_t *)cached_result.out_ep == (const uint8_t *)parsed_result.out_ep + shift);
+            REQUIRE((const uint8_t *)cached_result.notif_intf == (const uint8_t *)parsed_result.notif_intf + shift);
+            REQUIRE((const uint8_t *)cached_result.data_intf == (const uint8_t *)parsed_result.data_intf + shift);
+            for (int i = 0; i < cached_result.func_cnt; i++) {
+                REQUIRE(cached_result.func[i].offset == parsed_result.func[i].offset);
+                REQUIRE(cached_result.func[i].subtype == parsed_result.func[i].subtype);
+            }
+        }
+
+        SECTION("Other interface is not taken from cache") {
+            cdc_parsed_info_t other_result = {};
+            ret = cdc_parse_interface_descriptor_cached(dev_desc, cfg_desc, 2, &other_result);
+            REQUIRE(ESP_ERR_NOT_FOUND == ret);
+        }
+    }
+}
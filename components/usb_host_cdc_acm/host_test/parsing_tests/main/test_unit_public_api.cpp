@@ -24,6 +24,7 @@ int task_handle_ptr;
 // Ensure task_handle is non nullptr, as it is used in ReturnThruPtr type of Cmock function
 TaskHandle_t task_handle = reinterpret_cast<TaskHandle_t>(&task_handle_ptr);
 int sem;
+int open_sem;
 int event_group;
 
 
@@ -53,6 +54,8 @@ SCENARIO("CDC-ACM Host install/uninstall")
             // Because of missing Freertos Mocks
             // Create a semaphore, return the semaphore handle (Queue Handle in this scenario), so the semaphore is created successfully
             xQueueCreateMutex_ExpectAnyArgsAndReturn(reinterpret_cast<QueueHandle_t>(&sem));
+            // Create a binary semaphore for device open, return the semaphore handle, so it is created successfully
+            xQueueGenericCreate_ExpectAnyArgsAndReturn(reinterpret_cast<QueueHandle_t>(&open_sem));
             // Create a task, return pdTRUE, so the task is created successfully
             xTaskCreatePinnedToCore_ExpectAnyArgsAndReturn(pdTRUE);
             // Return task handle by pointer
@@ -60,6 +63,7 @@ SCENARIO("CDC-ACM Host install/uninstall")
 
             // goto err: (xEventGroupCreate returned nullptr), delete the queue and the task
             vQueueDelete_Expect(reinterpret_cast<QueueHandle_t>(&sem));
+            vQueueDelete_Expect(reinterpret_cast<QueueHandle_t>(&open_sem));
             vTaskDelete_Expect(task_handle);
 
             // Call the DUT function, expect ESP_ERR_NO_MEM
@@ -76,6 +80,8 @@ SCENARIO("CDC-ACM Host install/uninstall")
             // Because of missing Freertos Mocks
             // Create a semaphore, return the semaphore handle (Queue Handle in this scenario), so the semaphore is created successfully
             xQueueCreateMutex_ExpectAnyArgsAndReturn(reinterpret_cast<QueueHandle_t>(&sem));
+            // Create a binary semaphore for device open, return the semaphore handle, so it is created successfully
+            xQueueGenericCreate_ExpectAnyArgsAndReturn(reinterpret_cast<QueueHandle_t>(&open_sem));
             // Create a task, return pdTRUE, so the task is created successfully
             vPortEnterCritical_Expect();
             vPortExitCritical_Expect();
@@ -127,6 +133,7 @@ SCENARIO("CDC-ACM Host install/uninstall")
             vEventGroupDelete_Expect(reinterpret_cast<EventGroupHandle_t>(&event_group));
             xQueueGenericSend_ExpectAnyArgsAndReturn(pdTRUE);
             vQueueDelete_Expect(reinterpret_cast<QueueHandle_t>(&sem));
+            vQueueDelete_Expect(reinterpret_cast<QueueHandle_t>(&open_sem));
 
             // Call the DUT function, expect ESP_OK
             REQUIRE(ESP_OK == cdc_acm_host_uninstall());
@@ -15,6 +15,9 @@
 #define CDC_HOST_ANY_VID (0)
 #define CDC_HOST_ANY_PID (0)
 
+// Default maximum size of encapsulated command and response, see ctrl_buffer_size in cdc_acm_host_device_config_t
+#define CDC_ACM_ENCAP_MAX_SIZE (56)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -63,10 +66,40 @@ typedef void (*cdc_acm_new_dev_callback_t)(usb_device_handle_t usb_dev);
  * @param[in] data_len Length of received data in bytes
  * @param[in] user_arg User's argument passed to open function
  * @return true        Received data was processed     -> Flush RX buffer
- * @return false       Received data was NOT processed -> Append new data to the buffer
+ * @return false       Received data was NOT processed -> Append new data to the buffer.
+ *                     Not supported with in_transfer_count > 1 and no RX ring: the data are then dropped
+ *                     and reported as overrun (CDC_ACM_HOST_SERIAL_STATE event with bOverRun set, rx_overruns statistics)
  */
 typedef bool (*cdc_acm_data_callback_t)(const uint8_t *data, size_t data_len, void *user_arg);
 
+/**
+ * @brief Data transmit completion callback type
+ *
+ * @param[in] status   ESP_OK if the data were sent, ESP_ERR_TIMEOUT, ESP_ERR_INVALID_STATE if the transfer was canceled
+ *                     or the device was disconnected, ESP_ERR_INVALID_RESPONSE on other transfer errors,
+ *                     ESP_ERR_NO_MEM if queued data were dropped from full TX queue
+ * @param[in] data_len Number of bytes sent
+ * @param[in] user_arg User's argument passed to cdc_acm_host_data_tx_async() or cdc_acm_host_data_tx_queue()
+ */
+typedef void (*cdc_acm_tx_done_callback_t)(esp_err_t status, size_t data_len, void *user_arg);
+
+/**
+ * @brief Control request completion callback type
+ *
+ * The callback runs in the CDC-ACM driver task, which handles USB Host client events.
+ * Blocking CTRL functions (line coding, control line state, port settings and custom requests) wait for completion
+ * in that task, so they return ESP_ERR_INVALID_STATE when called from this or any other driver callback.
+ * Use the *_async() variants here instead.
+ *
+ * @param[in] status   ESP_OK if the request succeeded, ESP_ERR_INVALID_RESPONSE if it failed or was STALLed,
+ *                     ESP_ERR_INVALID_STATE if the device was closed before the request was sent,
+ *                     ESP_ERR_INVALID_SIZE if encapsulated response did not fit in ctrl_buffer_size and data hold only its beginning
+ * @param[in] data     Data stage of IN request, valid only during the callback. NULL for OUT requests
+ * @param[in] data_len Length of data in bytes, the device can return less than wLength
+ * @param[in] user_arg User's argument passed with the request
+ */
+typedef void (*cdc_acm_ctrl_done_callback_t)(esp_err_t status, const uint8_t *data, size_t data_len, void *user_arg);
+
 /**
  * @brief Device event callback type
  *
@@ -75,6 +108,65 @@ typedef bool (*cdc_acm_data_callback_t)(const uint8_t *data, size_t data_len, vo
  */
 typedef void (*cdc_acm_host_dev_callback_t)(const cdc_acm_host_dev_event_data_t *event, void *user_ctx);
 
+/**
+ * @brief Element of scatter-gather list for cdc_acm_host_data_tx_iov()
+ *
+ */
+typedef struct {
+    const void *iov_base;                 /**< Pointer to data */
+    size_t iov_len;                       /**< Length of data in bytes */
+} cdc_iovec_t;
+
+/**
+ * @brief CDC-ACM device statistics
+ *
+ */
+typedef struct {
+    size_t in_xfer_size;                  /**< Size of bulk IN transfers currently requested from the device */
+    uint32_t in_xfer_size_grow;           /**< Number of times the adaptive IN transfer size was increased */
+    uint32_t in_xfer_size_shrink;         /**< Number of times the adaptive IN transfer size was decreased */
+    uint64_t rx_bytes;                    /**< Number of bytes received from the device */
+    uint32_t rx_transfers;                /**< Number of completed bulk IN transfers */
+    uint32_t rx_short_transfers;          /**< Number of bulk IN transfers ended by a short packet */
+    uint32_t rx_overruns;                 /**< Number of times received data were dropped */
+    uint64_t tx_bytes;                    /**< Number of bytes sent to the device */
+    uint32_t tx_transfers;                /**< Number of completed bulk OUT transfers */
+    uint32_t tx_timeouts;                 /**< Number of bulk OUT transfers cancelled by the driver after timeout */
+    uint32_t notif_transfers;             /**< Number of received notifications */
+    uint32_t xfer_errors;                 /**< Number of transfers that failed with an error, overflow or were skipped */
+    uint32_t xfer_stalls;                 /**< Number of transfers that were STALLed by the device */
+    uint32_t xfer_timeouts;               /**< Number of transfers that timed out in USB Host Library */
+    uint32_t tx_coalesced_writes;         /**< Number of writes passed to cdc_acm_host_data_tx_coalesced() */
+    uint32_t tx_coalesce_flushes;         /**< Number of OUT transfers sent by cdc_acm_host_data_tx_coalesced() */
+    uint32_t tx_coalesce_latency_max_ms;  /**< Maximum time data waited in coalescing buffer in [ms] */
+    uint32_t tx_queue_depth;              /**< Number of items currently waiting in TX queue */
+    uint32_t tx_queue_depth_max;          /**< Maximum number of items that waited in TX queue */
+    uint32_t tx_queue_drops;              /**< Number of items dropped or refused because TX queue was full */
+    uint32_t tx_pace_waits;               /**< Number of times TX pacing delayed an OUT transfer */
+    uint32_t tx_pace_wait_ms;             /**< Total time OUT transfers were delayed by TX pacing in [ms] */
+} cdc_acm_host_stats_t;
+
+/**
+ * @brief Usage of static device pool
+ *
+ * @see CONFIG_CDC_ACM_STATIC_POOL
+ */
+typedef struct {
+    int size;                             /**< Number of devices in the pool */
+    int in_use;                           /**< Number of devices currently taken from the pool */
+    int high_water;                       /**< Maximum number of devices taken from the pool since the driver was installed */
+} cdc_acm_host_pool_stats_t;
+
+/**
+ * @brief Behavior of cdc_acm_host_data_tx_queue() when TX queue is full
+ *
+ */
+typedef enum {
+    CDC_ACM_TX_QUEUE_BLOCK = 0,           /**< Wait up to timeout_ms for free space in the queue */
+    CDC_ACM_TX_QUEUE_DROP_OLDEST,         /**< Drop the oldest queued item, its done_cb is called with ESP_ERR_NO_MEM */
+    CDC_ACM_TX_QUEUE_FAIL,                /**< Return ESP_ERR_NO_MEM immediately */
+} cdc_acm_tx_queue_full_policy_t;
+
 /**
  * @brief Configuration structure of USB Host CDC-ACM driver
  *
@@ -97,6 +189,48 @@ typedef struct {
     cdc_acm_host_dev_callback_t event_cb; /**< Device's event callback function. Can be NULL */
     cdc_acm_data_callback_t data_cb;      /**< Device's data RX callback function. Can be NULL for write-only devices */
     void *user_arg;                       /**< User's argument that will be passed to the callbacks */
+    uint8_t in_transfer_count;            /**< Number of bulk in transfers kept in flight, max 8. 0 is treated as 1. RX buffer append is only supported with 1 transfer,
+                                               data_cb must not return false with more transfers unless rx_ring_size is set */
+    size_t rx_ring_size;                  /**< Size of RX ring in bytes. If non-zero, received data are copied to the ring and data_cb is called from a dedicated RX task,
+                                               or the data are read by cdc_acm_host_data_rx() if data_cb is NULL.
+                                               If 0, data_cb is called directly from USB Host context. The device must not be closed from data_cb if RX task is used.
+                                               With RX task, data not processed by data_cb are offered again with the next data, up to rx_ring_size bytes,
+                                               and 2 * rx_ring_size bytes are allocated so that the data are contiguous across the end of the ring.
+                                               With CONFIG_CDC_ACM_STATIC_POOL, max CONFIG_CDC_ACM_STATIC_POOL_RX_RING_SIZE */
+    unsigned rx_task_priority;            /**< Priority of the RX task, only used if rx_ring_size is non-zero */
+    int rx_task_core_id;                  /**< Core affinity of the RX task, only used if rx_ring_size is non-zero */
+    uint8_t rx_loan_count;                /**< Number of spare IN buffers, max 8. This is the number of RX buffers that the user can hold at once, see cdc_acm_host_rx_buffer_hold() */
+    size_t rx_trigger_level;              /**< cdc_acm_host_data_rx() returns as soon as this many bytes are received. 0 is treated as 1 */
+    size_t rx_high_water;                 /**< Flow control: IN polling is paused when the RX ring holds this many bytes, so the device NAKs instead of data being dropped.
+                                               Leave room for in_transfer_count * in_buffer_size bytes above it. Without RX ring, any non-zero value pauses
+                                               IN polling when the RX append buffer is full, until cdc_acm_host_rx_resume() is called. 0 disables flow control.
+                                               Without RX ring, flow control requires in_transfer_count <= 1 */
+    size_t rx_low_water;                  /**< Flow control: IN polling is resumed when the RX ring drains to this many bytes */
+    bool in_adaptive_size;                /**< Start with IN transfers of Maximum Packet Size and grow them up to in_buffer_size under sustained traffic.
+                                               Short replies are then delivered in small transfers. If false, IN transfers always request the whole buffer */
+    uint8_t out_transfer_count;           /**< Number of bulk out transfers that can be in flight, max 8. 0 is treated as 1. Each transfer has a buffer of out_buffer_size bytes */
+    uint32_t tx_coalesce_ms;              /**< Maximum latency added by cdc_acm_host_data_tx_coalesced(). Data are sent at the latest this long after their first byte was written.
+                                               0 disables TX coalescing */
+    bool tx_flush_on_delimiter;           /**< cdc_acm_host_data_tx_coalesced() sends data immediately after tx_delimiter is written */
+    uint8_t tx_delimiter;                 /**< Delimiter byte, for example end of command of framed protocol */
+    size_t tx_queue_len;                  /**< Length of TX queue of cdc_acm_host_data_tx_queue(). If non-zero, a dedicated TX task sends the queued data.
+                                               0 disables the TX task. With CONFIG_CDC_ACM_STATIC_POOL, max CONFIG_CDC_ACM_STATIC_POOL_TX_QUEUE_LEN */
+    cdc_acm_tx_queue_full_policy_t tx_queue_full_policy; /**< Behavior of cdc_acm_host_data_tx_queue() on full TX queue */
+    unsigned tx_task_priority;            /**< Priority of the TX task, only used if tx_queue_len is non-zero */
+    int tx_task_core_id;                  /**< Core affinity of the TX task, only used if tx_queue_len is non-zero */
+    bool tx_pacing;                       /**< Limit rate of OUT transfers of cdc_acm_host_data_tx_blocking() to the UART rate of the device,
+                                               so the device does not NAK data it cannot send yet. The rate is taken from the last line coding
+                                               set or read by cdc_acm_host_line_coding_set()/get(), there is no pacing before that */
+    size_t tx_pacing_fifo_size;           /**< Estimated size of the device's TX FIFO in bytes, it may hold this much data ahead of the UART.
+                                               0 is treated as OUT endpoint Maximum Packet Size */
+    cdc_acm_ctrl_done_callback_t encap_response_cb; /**< Encapsulated response callback. On RESPONSE_AVAILABLE notification the response is fetched
+                                               by GET_ENCAPSULATED_RESPONSE request and passed to this callback with user_arg.
+                                               If NULL, the notification is ignored. Only used by devices with notification element */
+    const char *serial_number;            /**< Open only the USB device with this serial number (iSerialNumber string, ASCII), so devices with equal VID/PID
+                                               can be told apart. NULL for any device */
+    uint16_t ctrl_buffer_size;            /**< Size of data stage of CTRL requests in bytes, it limits encapsulated commands and responses
+                                               and wLength of custom requests. Smaller values, including 0, are raised to CDC_ACM_ENCAP_MAX_SIZE.
+                                               Longer encapsulated responses are passed to encap_response_cb with ESP_ERR_INVALID_SIZE */
 } cdc_acm_host_device_config_t;
 
 /**
@@ -143,6 +277,7 @@ esp_err_t cdc_acm_host_register_new_dev_callback(cdc_acm_new_dev_callback_t new_
  *
  * Use CDC_HOST_ANY_* macros to signal that you don't care about the device's VID and PID. In this case, first USB device will be opened.
  * It is recommended to use this feature if only one device can ever be in the system (there is no USB HUB connected).
+ * If dev_config->serial_number is set, devices with a different serial number are skipped.
  *
  * @param[in] vid           Device's Vendor ID, set to CDC_HOST_ANY_VID for any
  * @param[in] pid           Device's Product ID, set to CDC_HOST_ANY_PID for any
@@ -152,9 +287,11 @@ esp_err_t cdc_acm_host_register_new_dev_callback(cdc_acm_new_dev_callback_t new_
  * @return
  *   - ESP_OK: Success
  *   - ESP_ERR_INVALID_STATE: The CDC driver is not installed
- *   - ESP_ERR_INVALID_ARG: dev_config or cdc_hdl_ret is NULL
+ *   - ESP_ERR_INVALID_ARG: dev_config or cdc_hdl_ret is NULL, or dev_config is not valid
  *   - ESP_ERR_NO_MEM: Not enough memory for opening the device
- *   - ESP_ERR_NOT_FOUND: USB device with specified VID/PID is not connected or does not have specified interface
+ *   - ESP_ERR_NOT_FOUND: USB device with specified VID/PID (and serial number) is not connected or does not have specified interface
+ *   - ESP_ERR_NOT_SUPPORTED: rx_ring_size or tx_queue_len is larger than reserved by CONFIG_CDC_ACM_STATIC_POOL_RX_RING_SIZE
+ *                            or CONFIG_CDC_ACM_STATIC_POOL_TX_QUEUE_LEN
  */
 esp_err_t cdc_acm_host_open(uint16_t vid, uint16_t pid, uint8_t interface_idx, const cdc_acm_host_device_config_t *dev_config, cdc_acm_dev_hdl_t *cdc_hdl_ret);
 
@@ -178,6 +315,16 @@ esp_err_t cdc_acm_host_close(cdc_acm_dev_hdl_t cdc_hdl);
 /**
  * @brief Transmit data - blocking mode
  *
+ * Data longer than out_buffer_size are split into chunks of whole packets, which are pipelined in all OUT transfers.
+ * The write is terminated by a zero-length packet if its length is a multiple of Maximum Packet Size.
+ * With tx_pacing, chunks are submitted no faster than the device sends them over UART. Data sent by the other TX functions
+ * are accounted for, but they are not delayed.
+ *
+ * On timeout the OUT endpoint is halted and flushed to cancel the transfers of this call, if no other OUT transfer is taken.
+ * Otherwise, transfers of cdc_acm_host_data_tx_async(), cdc_acm_host_data_tx_coalesced(), cdc_acm_host_data_tx_queue() and
+ * cdc_acm_host_tx_acquire() are not canceled: the timed out transfers are left in flight, so their data can still be sent
+ * after this function returned.
+ *
  * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
  * @param[in] data       Data to be sent
  * @param[in] data_len   Data length
@@ -186,9 +333,212 @@ esp_err_t cdc_acm_host_close(cdc_acm_dev_hdl_t cdc_hdl);
  */
 esp_err_t cdc_acm_host_data_tx_blocking(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, uint32_t timeout_ms);
 
+/**
+ * @brief Transmit data from scatter-gather list - blocking mode
+ *
+ * Elements of the list are gathered directly to OUT transfers and sent as one write,
+ * with the same chunking as cdc_acm_host_data_tx_blocking().
+ *
+ * Timeout is handled as in cdc_acm_host_data_tx_blocking().
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[in] iov        Scatter-gather list, elements can be empty
+ * @param[in] iov_cnt    Number of elements in the list
+ * @param[in] timeout_ms Timeout in [ms]
+ * @return esp_err_t
+ */
+esp_err_t cdc_acm_host_data_tx_iov(cdc_acm_dev_hdl_t cdc_hdl, const cdc_iovec_t *iov, int iov_cnt, uint32_t timeout_ms);
+
+/**
+ * @brief Transmit data - non-blocking mode
+ *
+ * Data are copied to an idle OUT transfer, which is submitted without waiting for its completion.
+ * Up to out_transfer_count transfers can be in flight, so back-to-back calls keep the bulk OUT endpoint busy.
+ *
+ * @note done_cb is called from USB Host context, it can submit next data.
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[in] data     Data to be sent
+ * @param[in] data_len Data length
+ * @param[in] done_cb  Completion callback, can be NULL
+ * @param[in] user_arg Argument of done_cb
+ * @return
+ *   - ESP_OK: Transfer was submitted, done_cb will be called
+ *   - ESP_ERR_INVALID_ARG: Invalid device or data
+ *   - ESP_ERR_INVALID_SIZE: data_len is larger than out_buffer_size
+ *   - ESP_ERR_NOT_SUPPORTED: Device was opened as read-only
+ *   - ESP_ERR_NO_MEM: All OUT transfers are in flight
+ */
+esp_err_t cdc_acm_host_data_tx_async(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, cdc_acm_tx_done_callback_t done_cb, void *user_arg);
+
+/**
+ * @brief Get OUT transfer buffer to be filled by the caller - zero-copy mode
+ *
+ * The caller writes data directly to the transfer buffer and sends them by cdc_acm_host_tx_commit().
+ * Only one buffer per device can be acquired at a time.
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[out] buf        Transfer buffer
+ * @param[out] cap        Capacity of the transfer buffer in bytes
+ * @param[in]  timeout_ms Timeout for an OUT transfer to become idle in [ms]
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: Invalid device, buf or cap
+ *   - ESP_ERR_NOT_SUPPORTED: Device was opened as read-only
+ *   - ESP_ERR_INVALID_STATE: A buffer is already acquired
+ *   - ESP_ERR_TIMEOUT: No OUT transfer became idle in timeout_ms
+ */
+esp_err_t cdc_acm_host_tx_acquire(cdc_acm_dev_hdl_t cdc_hdl, uint8_t **buf, size_t *cap, uint32_t timeout_ms);
+
+/**
+ * @brief Send data written to the buffer from cdc_acm_host_tx_acquire()
+ *
+ * The function does not wait for transmission. The buffer must not be accessed after this call.
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[in] len Number of bytes written to the buffer. 0 releases the buffer without sending anything
+ * @return
+ *   - ESP_OK: Transfer was submitted or the buffer was released
+ *   - ESP_ERR_INVALID_ARG: Invalid device
+ *   - ESP_ERR_INVALID_SIZE: len is larger than buffer capacity
+ *   - ESP_ERR_INVALID_STATE: No buffer is acquired
+ */
+esp_err_t cdc_acm_host_tx_commit(cdc_acm_dev_hdl_t cdc_hdl, size_t len);
+
+/**
+ * @brief Transmit data - coalescing mode
+ *
+ * Short writes are merged in one OUT transfer, which is sent when it is full, when tx_delimiter is written
+ * or tx_coalesce_ms after its first byte was written, whichever comes first.
+ * If another write holds the coalescing buffer at the deadline, the deadline is checked again tx_coalesce_ms later.
+ * The function returns when the data are copied, it does not wait for their transmission.
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[in] data       Data to be sent
+ * @param[in] data_len   Data length
+ * @param[in] timeout_ms Timeout for an OUT transfer to become idle in [ms]
+ * @return
+ *   - ESP_OK: Data were queued
+ *   - ESP_ERR_INVALID_ARG: Invalid device or data
+ *   - ESP_ERR_NOT_SUPPORTED: Device was opened without tx_coalesce_ms
+ *   - ESP_ERR_TIMEOUT: No OUT transfer became idle in timeout_ms
+ */
+esp_err_t cdc_acm_host_data_tx_coalesced(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, uint32_t timeout_ms);
+
+/**
+ * @brief Transmit data - queued mode
+ *
+ * Data are queued to the TX task, which sends them by cdc_acm_host_data_tx_blocking(), so the caller never waits for the OUT pipe.
+ * Data are not copied, the buffer must stay valid until done_cb is called.
+ * Items left in the queue when the device is closed complete with ESP_ERR_INVALID_STATE. A caller waiting for free space
+ * in the queue while the device is being closed is let through, and its item completes the same way.
+ *
+ * @note done_cb is called from the TX task, or from the caller's context if the item is dropped or the device is closed.
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[in] data       Data to be sent
+ * @param[in] data_len   Data length
+ * @param[in] done_cb    Completion callback, can be NULL
+ * @param[in] user_arg   Argument of done_cb
+ * @param[in] timeout_ms Timeout for free space in the queue in [ms], only used with CDC_ACM_TX_QUEUE_BLOCK policy
+ * @return
+ *   - ESP_OK: Data were queued, done_cb will be called
+ *   - ESP_ERR_INVALID_ARG: Invalid device or data
+ *   - ESP_ERR_NOT_SUPPORTED: Device was opened without tx_queue_len
+ *   - ESP_ERR_INVALID_STATE: The device is being closed
+ *   - ESP_ERR_TIMEOUT: The queue stayed full for timeout_ms (CDC_ACM_TX_QUEUE_BLOCK)
+ *   - ESP_ERR_NO_MEM: The queue is full (CDC_ACM_TX_QUEUE_FAIL)
+ */
+esp_err_t cdc_acm_host_data_tx_queue(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, cdc_acm_tx_done_callback_t done_cb, void *user_arg, uint32_t timeout_ms);
+
+/**
+ * @brief Receive data - blocking mode
+ *
+ * Reads data from RX ring of a device opened with rx_ring_size > 0 and data_cb = NULL.
+ * Returns as soon as rx_trigger_level bytes (or data_len bytes, whichever is lower) are received.
+ * On timeout, returns the data received so far.
+ *
+ * @param     cdc_hdl      CDC handle obtained from cdc_acm_host_open()
+ * @param[out] data         Buffer for received data
+ * @param[in]  data_len     Size of the buffer
+ * @param[out] data_len_ret Number of received bytes
+ * @param[in]  timeout_ms   Timeout in [ms]
+ * @return
+ *   - ESP_OK: Success, at least one byte was received
+ *   - ESP_ERR_INVALID_ARG: Invalid input arguments
+ *   - ESP_ERR_NOT_SUPPORTED: The device was not opened in pull mode
+ *   - ESP_ERR_TIMEOUT: No data were received within timeout
+ */
+esp_err_t cdc_acm_host_data_rx(cdc_acm_dev_hdl_t cdc_hdl, uint8_t *data, size_t data_len, size_t *data_len_ret, uint32_t timeout_ms);
+
+/**
+ * @brief Pause reception
+ *
+ * Bulk IN transfers are no longer submitted, so the device's data are held back by NAKs.
+ * Transfers that are already in flight complete normally.
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: Invalid device
+ *   - ESP_ERR_NOT_SUPPORTED: The device was opened as write-only
+ */
+esp_err_t cdc_acm_host_rx_pause(cdc_acm_dev_hdl_t cdc_hdl);
+
+/**
+ * @brief Resume reception
+ *
+ * Resumes reception paused by cdc_acm_host_rx_pause() or by full RX append buffer (see rx_high_water).
+ * All data in full RX append buffer are passed to data_cb once more, from the calling task. If data_cb returns true,
+ * the buffer is flushed and reception resumes. If it returns false again, the data are kept and reception stays paused.
+ * Reception paused by RX ring high-water mark resumes automatically.
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: Invalid device
+ *   - ESP_ERR_NOT_SUPPORTED: The device was opened as write-only
+ *   - ESP_ERR_INVALID_STATE: data_cb did not process the data in full RX append buffer, reception stays paused
+ */
+esp_err_t cdc_acm_host_rx_resume(cdc_acm_dev_hdl_t cdc_hdl);
+
+/**
+ * @brief Hold received data buffer
+ *
+ * Must be called from the data receive callback, with data pointer passed to the callback.
+ * The buffer is not reused by the driver until it is returned with cdc_acm_host_rx_buffer_release(),
+ * so the user does not have to copy the received data. The driver continues with a spare IN buffer in the meantime.
+ * A held buffer is always considered processed, the return value of the data receive callback is ignored.
+ *
+ * @note Not available with RX task (rx_ring_size != 0). Held buffers are freed when the device is closed.
+ *
+ * @param     cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[in] data    Pointer to received data, as passed to the data receive callback
+ * @return
+ *   - ESP_OK: Success, the buffer is valid until it is released
+ *   - ESP_ERR_INVALID_ARG: Invalid device or data pointer
+ *   - ESP_ERR_INVALID_STATE: Not called from the data receive callback
+ *   - ESP_ERR_NO_MEM: No spare IN buffer is available, the user must copy the data
+ */
+esp_err_t cdc_acm_host_rx_buffer_hold(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data);
+
+/**
+ * @brief Release received data buffer
+ *
+ * Returns buffer held by cdc_acm_host_rx_buffer_hold() to the driver. Can be called from any task.
+ *
+ * @param     cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[in] data    Pointer to any byte of the held buffer
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: Invalid device or data pointer
+ *   - ESP_ERR_NOT_FOUND: The data pointer does not belong to any held buffer
+ */
+esp_err_t cdc_acm_host_rx_buffer_release(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data);
+
 /**
  * @brief SetLineCoding function
  *
+ * The request is skipped if Line Coding is equal to the one last set or read.
+ *
  * @see Chapter 6.3.10, USB CDC-PSTN specification rev. 1.2
  *
  * @param     cdc_hdl     CDC handle obtained from cdc_acm_host_open()
@@ -200,6 +550,8 @@ esp_err_t cdc_acm_host_line_coding_set(cdc_acm_dev_hdl_t cdc_hdl, const cdc_acm_
 /**
  * @brief GetLineCoding function
  *
+ * Line Coding that was already set or read is returned from the driver's shadow copy, without a request to the device.
+ *
  * @see Chapter 6.3.11, USB CDC-PSTN specification rev. 1.2
  *
  * @param      cdc_hdl     CDC handle obtained from cdc_acm_host_open()
@@ -208,9 +560,22 @@ esp_err_t cdc_acm_host_line_coding_set(cdc_acm_dev_hdl_t cdc_hdl, const cdc_acm_
  */
 esp_err_t cdc_acm_host_line_coding_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_acm_line_coding_t *line_coding);
 
+/**
+ * @brief GetLineCoding function, always reads Line Coding from the device
+ *
+ * The driver's shadow copy is updated.
+ *
+ * @param      cdc_hdl     CDC handle obtained from cdc_acm_host_open()
+ * @param[out] line_coding Line Coding structure to be filled
+ * @return esp_err_t
+ */
+esp_err_t cdc_acm_host_line_coding_refresh(cdc_acm_dev_hdl_t cdc_hdl, cdc_acm_line_coding_t *line_coding);
+
 /**
  * @brief SetControlLineState function
  *
+ * The request is skipped if the state is equal to the one last set.
+ *
  * @see Chapter 6.3.12, USB CDC-PSTN specification rev. 1.2
  *
  * @param     cdc_hdl CDC handle obtained from cdc_acm_host_open()
@@ -220,6 +585,22 @@ esp_err_t cdc_acm_host_line_coding_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_acm_line_c
  */
 esp_err_t cdc_acm_host_set_control_line_state(cdc_acm_dev_hdl_t cdc_hdl, bool dtr, bool rts);
 
+/**
+ * @brief Set Line Coding and Control Line State in one call
+ *
+ * Both requests are sent back-to-back, each of them is skipped if the setting is equal to the one last set.
+ *
+ * @param     cdc_hdl     CDC handle obtained from cdc_acm_host_open()
+ * @param[in] line_coding Line Coding structure
+ * @param[in] dtr         Data Terminal Ready
+ * @param[in] rts         Request To Send
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_STATE: Called from a driver callback
+ *   - Else: Error of the failed request
+ */
+esp_err_t cdc_acm_host_apply_port_settings(cdc_acm_dev_hdl_t cdc_hdl, const cdc_acm_line_coding_t *line_coding, bool dtr, bool rts);
+
 /**
  * @brief SendBreak function
  *
@@ -233,6 +614,70 @@ esp_err_t cdc_acm_host_set_control_line_state(cdc_acm_dev_hdl_t cdc_hdl, bool dt
  */
 esp_err_t cdc_acm_host_send_break(cdc_acm_dev_hdl_t cdc_hdl, uint16_t duration_ms);
 
+/**
+ * @brief SetLineCoding function - non-blocking mode
+ *
+ * If the line coding equals the driver's shadow copy and no other request changing it is queued, nothing is sent
+ * and done_cb is called with ESP_OK before this function returns.
+ *
+ * @see cdc_acm_host_send_custom_request_async()
+ *
+ * @param     cdc_hdl     CDC handle obtained from cdc_acm_host_open()
+ * @param[in] line_coding Line Coding structure, it is copied
+ * @param[in] done_cb     Completion callback, can be NULL
+ * @param[in] user_arg    Argument of done_cb
+ * @return esp_err_t
+ */
+esp_err_t cdc_acm_host_line_coding_set_async(cdc_acm_dev_hdl_t cdc_hdl, const cdc_acm_line_coding_t *line_coding, cdc_acm_ctrl_done_callback_t done_cb, void *user_arg);
+
+/**
+ * @brief GetLineCoding function - non-blocking mode
+ *
+ * Line Coding structure is passed to done_cb as data.
+ *
+ * @see cdc_acm_host_send_custom_request_async()
+ *
+ * @param     cdc_hdl  CDC handle obtained from cdc_acm_host_open()
+ * @param[in] done_cb  Completion callback
+ * @param[in] user_arg Argument of done_cb
+ * @return esp_err_t
+ */
+esp_err_t cdc_acm_host_line_coding_get_async(cdc_acm_dev_hdl_t cdc_hdl, cdc_acm_ctrl_done_callback_t done_cb, void *user_arg);
+
+/**
+ * @brief SetControlLineState function - non-blocking mode
+ *
+ * If the control line state equals the driver's shadow copy and no other request changing it is queued, nothing is sent
+ * and done_cb is called with ESP_OK before this function returns.
+ *
+ * @see cdc_acm_host_send_custom_request_async()
+ *
+ * @param     cdc_hdl  CDC handle obtained from cdc_acm_host_open()
+ * @param[in] dtr      Data Terminal Ready
+ * @param[in] rts      Request To Send
+ * @param[in] done_cb  Completion callback, can be NULL
+ * @param[in] user_arg Argument of done_cb
+ * @return esp_err_t
+ */
+esp_err_t cdc_acm_host_set_control_line_state_async(cdc_acm_dev_hdl_t cdc_hdl, bool dtr, bool rts, cdc_acm_ctrl_done_callback_t done_cb, void *user_arg);
+
+/**
+ * @brief SendEncapsulatedCommand function - non-blocking mode
+ *
+ * The response is not polled for. When the device signals RESPONSE_AVAILABLE notification, the driver fetches
+ * the response and passes it to encap_response_cb from the device config.
+ *
+ * @see cdc_acm_host_send_custom_request_async()
+ *
+ * @param     cdc_hdl  CDC handle obtained from cdc_acm_host_open()
+ * @param[in] data     Command in protocol of the device, for example AT command
+ * @param[in] data_len Length of the command, max ctrl_buffer_size bytes from the device config
+ * @param[in] done_cb  Completion callback, it is called when the command is sent. Can be NULL
+ * @param[in] user_arg Argument of done_cb
+ * @return esp_err_t
+ */
+esp_err_t cdc_acm_host_send_encapsulated_command(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, uint16_t data_len, cdc_acm_ctrl_done_callback_t done_cb, void *user_arg);
+
 /**
  * @brief Print device's descriptors
  *
@@ -242,6 +687,40 @@ esp_err_t cdc_acm_host_send_break(cdc_acm_dev_hdl_t cdc_hdl, uint16_t duration_m
  */
 void cdc_acm_host_desc_print(cdc_acm_dev_hdl_t cdc_hdl);
 
+/**
+ * @brief Get device statistics
+ *
+ * @param      cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[out] stats   Device statistics
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: Invalid device or stats pointer
+ */
+esp_err_t cdc_acm_host_stats_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_acm_host_stats_t *stats);
+
+/**
+ * @brief Reset device statistics
+ *
+ * All counters are set to zero. Current IN transfer size is kept.
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: Invalid device
+ */
+esp_err_t cdc_acm_host_stats_reset(cdc_acm_dev_hdl_t cdc_hdl);
+
+/**
+ * @brief Get usage of static device pool
+ *
+ * @param[out] stats Pool usage
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: stats is NULL
+ *   - ESP_ERR_NOT_SUPPORTED: The driver is built without CONFIG_CDC_ACM_STATIC_POOL
+ */
+esp_err_t cdc_acm_host_pool_stats_get(cdc_acm_host_pool_stats_t *stats);
+
 /**
  * @brief Get protocols defined in USB-CDC interface descriptors
  *
@@ -267,6 +746,19 @@ esp_err_t cdc_acm_host_protocols_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_comm_protoco
  */
 esp_err_t cdc_acm_host_cdc_desc_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_desc_subtype_t desc_type, const usb_standard_desc_t **desc_out);
 
+/**
+ * @brief Get information about the USB device of a CDC device
+ *
+ * The string descriptors (e.g. serial number) can be used to tell apart devices with equal VID/PID.
+ *
+ * @param cdc_hdl   CDC handle obtained from cdc_acm_host_open()
+ * @param[out] info USB device information
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: Invalid device or info is NULL
+ */
+esp_err_t cdc_acm_host_device_info_get(cdc_acm_dev_hdl_t cdc_hdl, usb_device_info_t *info);
+
 /**
  * @brief Send command to CTRL endpoint
  *
@@ -274,6 +766,12 @@ esp_err_t cdc_acm_host_cdc_desc_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_desc_subtype_
  * This function can be used by device drivers that use custom/vendor specific commands.
  * These commands can either extend or replace commands defined in USB CDC-PSTN specification rev. 1.2.
  *
+ * @note The function blocks until the transfer completes. The completion is delivered by the driver task,
+ *       so calling it from a driver callback returns ESP_ERR_INVALID_STATE. The same applies to all blocking
+ *       CDC-PSTN requests above, which are sent through this function.
+ * @note Concurrent CTRL requests to one device are serialized by a semaphore without priority inheritance,
+ *       a low priority task holding the CTRL transfer is not boosted by a waiting high priority task.
+ *
  * @param        cdc_hdl       CDC handle obtained from cdc_acm_host_open()
  * @param[in]    bmRequestType Field of USB control request
  * @param[in]    bRequest      Field of USB control request
@@ -285,6 +783,33 @@ esp_err_t cdc_acm_host_cdc_desc_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_desc_subtype_
  */
 esp_err_t cdc_acm_host_send_custom_request(cdc_acm_dev_hdl_t cdc_hdl, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength, uint8_t *data);
 
+/**
+ * @brief Send command to CTRL endpoint - non-blocking mode
+ *
+ * The request is queued and the function returns immediately. Queued requests are sent back-to-back
+ * in order of submission, interleaved with blocking requests. done_cb is called exactly once for every queued request.
+ *
+ * @note done_cb is called from USB Host context, it can queue next request. If the request cannot be submitted,
+ *       done_cb is called with the submission error from the context that started the submission.
+ *       Requests left in the queue when the device is closed complete with ESP_ERR_INVALID_STATE.
+ * @param        cdc_hdl       CDC handle obtained from cdc_acm_host_open()
+ * @param[in]    bmRequestType Field of USB control request
+ * @param[in]    bRequest      Field of USB control request
+ * @param[in]    wValue        Field of USB control request
+ * @param[in]    wIndex        Field of USB control request
+ * @param[in]    wLength       Field of USB control request
+ * @param[in]    data          Data of OUT request, it is copied. Not used for IN requests
+ * @param[in]    done_cb       Completion callback, can be NULL
+ * @param[in]    user_arg      Argument of done_cb
+ * @return
+ *   - ESP_OK: Request was queued, done_cb will be called
+ *   - ESP_ERR_INVALID_ARG: Invalid device or data
+ *   - ESP_ERR_INVALID_SIZE: wLength is larger than CTRL transfer buffer
+ *   - ESP_ERR_NO_MEM: Request queue is full
+ */
+esp_err_t cdc_acm_host_send_custom_request_async(cdc_acm_dev_hdl_t cdc_hdl, uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength,
+        const uint8_t *data, cdc_acm_ctrl_done_callback_t done_cb, void *user_arg);
+
 #ifdef __cplusplus
 }
 class CdcAcmDevice {
@@ -304,6 +829,61 @@ public:
         return cdc_acm_host_data_tx_blocking(this->cdc_hdl, data, len, timeout_ms);
     }
 
+    inline esp_err_t tx_iov(const cdc_iovec_t *iov, int iov_cnt, uint32_t timeout_ms = 100)
+    {
+        return cdc_acm_host_data_tx_iov(this->cdc_hdl, iov, iov_cnt, timeout_ms);
+    }
+
+    inline esp_err_t tx_coalesced(const uint8_t *data, size_t len, uint32_t timeout_ms = 100)
+    {
+        return cdc_acm_host_data_tx_coalesced(this->cdc_hdl, data, len, timeout_ms);
+    }
+
+    inline esp_err_t tx_queue(const uint8_t *data, size_t len, cdc_acm_tx_done_callback_t done_cb, void *user_arg, uint32_t timeout_ms = 100)
+    {
+        return cdc_acm_host_data_tx_queue(this->cdc_hdl, data, len, done_cb, user_arg, timeout_ms);
+    }
+
+    inline esp_err_t tx_acquire(uint8_t **buf, size_t *cap, uint32_t timeout_ms = 100)
+    {
+        return cdc_acm_host_tx_acquire(this->cdc_hdl, buf, cap, timeout_ms);
+    }
+
+    inline esp_err_t tx_commit(size_t len)
+    {
+        return cdc_acm_host_tx_commit(this->cdc_hdl, len);
+    }
+
+    inline esp_err_t tx_async(const uint8_t *data, size_t len, cdc_acm_tx_done_callback_t done_cb, void *user_arg)
+    {
+        return cdc_acm_host_data_tx_async(this->cdc_hdl, data, len, done_cb, user_arg);
+    }
+
+    inline esp_err_t rx(uint8_t *data, size_t len, size_t *rx_len, uint32_t timeout_ms = 100)
+    {
+        return cdc_acm_host_data_rx(this->cdc_hdl, data, len, rx_len, timeout_ms);
+    }
+
+    inline esp_err_t rx_pause()
+    {
+        return cdc_acm_host_rx_pause(this->cdc_hdl);
+    }
+
+    inline esp_err_t rx_resume()
+    {
+        return cdc_acm_host_rx_resume(this->cdc_hdl);
+    }
+
+    inline esp_err_t rx_buffer_hold(const uint8_t *data)
+    {
+        return cdc_acm_host_rx_buffer_hold(this->cdc_hdl, data);
+    }
+
+    inline esp_err_t rx_buffer_release(const uint8_t *data)
+    {
+        return cdc_acm_host_rx_buffer_release(this->cdc_hdl, data);
+    }
+
     inline esp_err_t open(uint16_t vid, uint16_t pid, uint8_t interface_idx, const cdc_acm_host_device_config_t *dev_config)
     {
         return cdc_acm_host_open(vid, pid, interface_idx, dev_config, &this->cdc_hdl);
@@ -333,6 +913,16 @@ public:
         return cdc_acm_host_line_coding_set(this->cdc_hdl, line_coding);
     }
 
+    inline esp_err_t line_coding_refresh(cdc_acm_line_coding_t *line_coding)
+    {
+        return cdc_acm_host_line_coding_refresh(this->cdc_hdl, line_coding);
+    }
+
+    inline esp_err_t apply_port_settings(const cdc_acm_line_coding_t *line_coding, bool dtr, bool rts)
+    {
+        return cdc_acm_host_apply_port_settings(this->cdc_hdl, line_coding, dtr, rts);
+    }
+
     virtual inline esp_err_t set_control_line_state(bool dtr, bool rts)
     {
         return cdc_acm_host_set_control_line_state(this->cdc_hdl, dtr, rts);
@@ -343,11 +933,52 @@ public:
         return cdc_acm_host_send_break(this->cdc_hdl, duration_ms);
     }
 
+    inline esp_err_t line_coding_set_async(const cdc_acm_line_coding_t *line_coding, cdc_acm_ctrl_done_callback_t done_cb, void *user_arg)
+    {
+        return cdc_acm_host_line_coding_set_async(this->cdc_hdl, line_coding, done_cb, user_arg);
+    }
+
+    inline esp_err_t line_coding_get_async(cdc_acm_ctrl_done_callback_t done_cb, void *user_arg)
+    {
+        return cdc_acm_host_line_coding_get_async(this->cdc_hdl, done_cb, user_arg);
+    }
+
+    inline esp_err_t set_control_line_state_async(bool dtr, bool rts, cdc_acm_ctrl_done_callback_t done_cb, void *user_arg)
+    {
+        return cdc_acm_host_set_control_line_state_async(this->cdc_hdl, dtr, rts, done_cb, user_arg);
+    }
+
+    inline esp_err_t send_encapsulated_command(const uint8_t *data, uint16_t data_len, cdc_acm_ctrl_done_callback_t done_cb, void *user_arg)
+    {
+        return cdc_acm_host_send_encapsulated_command(this->cdc_hdl, data, data_len, done_cb, user_arg);
+    }
+
+    inline esp_err_t stats_get(cdc_acm_host_stats_t *stats) const
+    {
+        return cdc_acm_host_stats_get(this->cdc_hdl, stats);
+    }
+
+    inline esp_err_t stats_reset()
+    {
+        return cdc_acm_host_stats_reset(this->cdc_hdl);
+    }
+
+    inline esp_err_t device_info_get(usb_device_info_t *info) const
+    {
+        return cdc_acm_host_device_info_get(this->cdc_hdl, info);
+    }
+
     inline esp_err_t send_custom_request(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength, uint8_t *data)
     {
         return cdc_acm_host_send_custom_request(this->cdc_hdl, bmRequestType, bRequest, wValue, wIndex, wLength, data);
     }
 
+    inline esp_err_t send_custom_request_async(uint8_t bmRequestType, uint8_t bRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength, const uint8_t *data,
+            cdc_acm_ctrl_done_callback_t done_cb, void *user_arg)
+    {
+        return cdc_acm_host_send_custom_request_async(this->cdc_hdl, bmRequestType, bRequest, wValue, wIndex, wLength, data, done_cb, user_arg);
+    }
+
 private:
     CdcAcmDevice &operator= (const CdcAcmDevice &Copy);
     bool operator== (const CdcAcmDevice &param) const;
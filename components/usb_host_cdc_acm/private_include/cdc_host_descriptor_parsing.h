@@ -9,7 +9,13 @@
 #include "esp_err.h"
 #include "usb/usb_types_ch9.h"
 
-typedef const usb_standard_desc_t *cdc_func_array_t[]; // Array of pointers to const usb_standard_desc_t
+#define CDC_FUNC_DESC_MAX (8) // Maximum number of CDC functional descriptors of one interface, further descriptors are ignored
+
+// CDC functional descriptor stored as offset in Configuration descriptor
+typedef struct {
+    uint16_t offset;  // Offset of the descriptor in Configuration descriptor
+    uint8_t subtype;  // bDescriptorSubtype of the descriptor
+} cdc_func_desc_t;
 
 typedef struct {
     const usb_ep_desc_t *notif_ep;
@@ -17,7 +23,7 @@ typedef struct {
     const usb_ep_desc_t *out_ep;
     const usb_intf_desc_t *notif_intf;
     const usb_intf_desc_t *data_intf;
-    cdc_func_array_t *func;
+    cdc_func_desc_t func[CDC_FUNC_DESC_MAX];
     int func_cnt;
 } cdc_parsed_info_t;
 
@@ -33,6 +39,29 @@ extern "C" {
  * #. Check if the device is CDC compliant
  * #. For CDC compliant devices also parse second interface descriptor and functional descriptors
  *
+ * The Configuration descriptor is walked once to build an index of its interfaces, endpoints, IADs and functional descriptors.
+ * The index is kept until a different Configuration descriptor is parsed, so opening further interfaces is only a lookup.
+ *
+ * @note The index is not thread-safe, the driver calls this function with open_close_mutex taken.
+ * @param[in] device_desc Pointer to Device descriptor
+ * @param[in] config_desc Pointer do Configuration descriptor
+ * @param[in] intf_idx    Index of the required interface
+ * @param[out] info_ret   Array of parsed information, see cdc_parsed_info_t
+ * @return
+ *     - ESP_OK:                Success
+ *     - ESP_ERR_NOT_FOUND:     Interfaces and endpoints NOT found
+ *     - ESP_ERR_NOT_SUPPORTED: Configuration descriptor has too many descriptors for the index
+ */
+esp_err_t cdc_parse_interface_descriptor(const usb_device_desc_t *device_desc, const usb_config_desc_t *config_desc, uint8_t intf_idx, cdc_parsed_info_t *info_ret);
+
+/**
+ * @brief Parse CDC interface descriptor, with cache of recently parsed interfaces
+ *
+ * Parsed interfaces are cached by VID, PID, bcdDevice, interface index and hash of the Configuration descriptor.
+ * On cache hit, the result is rebuilt from offsets in the Configuration descriptor without parsing.
+ * Only successfully parsed interfaces are cached, the least recently used entry is replaced.
+ *
+ * @note The cache is not thread-safe, the driver calls this function with open_close_mutex taken.
  * @param[in] device_desc Pointer to Device descriptor
  * @param[in] config_desc Pointer do Configuration descriptor
  * @param[in] intf_idx    Index of the required interface
@@ -40,8 +69,14 @@ extern "C" {
  * @return
  *     - ESP_OK:            Success
  *     - ESP_ERR_NOT_FOUND: Interfaces and endpoints NOT found
+ *     - ESP_ERR_NOT_SUPPORTED: Configuration descriptor has too many descriptors for the index
  */
-esp_err_t cdc_parse_interface_descriptor(const usb_device_desc_t *device_desc, const usb_config_desc_t *config_desc, uint8_t intf_idx, cdc_parsed_info_t *info_ret);
+esp_err_t cdc_parse_interface_descriptor_cached(const usb_device_desc_t *device_desc, const usb_config_desc_t *config_desc, uint8_t intf_idx, cdc_parsed_info_t *info_ret);
+
+/**
+ * @brief Invalidate all entries of the parsing cache and the Configuration descriptor index
+ */
+void cdc_parse_cache_clear(void);
 
 /**
  * @brief Print CDC specific descriptor in human readable form
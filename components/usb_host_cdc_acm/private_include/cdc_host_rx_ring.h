@@ -0,0 +1,98 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+
+/**
+ * @brief Lock-free single-producer single-consumer byte ring
+ *
+ * The producer (USB Host client task) only moves head, the consumer only moves tail.
+ * Both indexes run over twice the ring size, so the ring can be filled up to its full size.
+ */
+typedef struct {
+    uint8_t *buf;        // Ring storage
+    bool buf_owned;      // Storage was allocated by cdc_rx_ring_init()
+    size_t size;         // Size of the ring storage in bytes
+    atomic_size_t head;  // Write index, only modified by the producer
+    atomic_size_t tail;  // Read index, only modified by the consumer
+    bool linear;         // Storage is followed by the same number of bytes for data that wrap around, see cdc_rx_ring_peek_all()
+    size_t linear_len;   // Number of bytes from the start of the ring already copied behind its end, only used by the consumer
+} cdc_rx_ring_t;
+
+/**
+ * @brief Initialize ring and allocate its storage
+ *
+ * @param[out] ring    Ring to be initialized
+ * @param[in]  size    Size of the ring in bytes
+ * @param[in]  linear  Reserve space for cdc_rx_ring_peek_all(), this doubles the size of the storage
+ * @param[in]  storage Storage provided by the caller, large enough for size and linear. NULL to allocate it
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: Size is 0
+ *   - ESP_ERR_NO_MEM: Not enough memory for the ring storage
+ */
+esp_err_t cdc_rx_ring_init(cdc_rx_ring_t *ring, size_t size, bool linear, uint8_t *storage);
+
+/**
+ * @brief Free ring storage, if it was allocated by cdc_rx_ring_init()
+ *
+ * @param[in] ring Ring to be freed
+ */
+void cdc_rx_ring_deinit(cdc_rx_ring_t *ring);
+
+/**
+ * @brief Copy data to the ring (producer)
+ *
+ * @param[in] ring Ring
+ * @param[in] data Data to be copied
+ * @param[in] len  Length of data
+ * @return Number of bytes written. Less than len if the ring is full
+ */
+size_t cdc_rx_ring_write(cdc_rx_ring_t *ring, const uint8_t *data, size_t len);
+
+/**
+ * @brief Get the oldest contiguous block of data in the ring (consumer)
+ *
+ * The data stay in the ring until cdc_rx_ring_consume() is called.
+ *
+ * @param[in]  ring Ring
+ * @param[out] data Pointer to the first unread byte
+ * @return Length of the contiguous block in bytes, 0 if the ring is empty
+ */
+size_t cdc_rx_ring_peek(cdc_rx_ring_t *ring, const uint8_t **data);
+
+/**
+ * @brief Get all data in the ring as one contiguous block (consumer)
+ *
+ * Data that wrap around the end of the ring are copied behind it, so a block that was not consumed
+ * can grow up to the full size of the ring. The ring must be initialized with linear = true.
+ *
+ * @param[in]  ring Ring
+ * @param[out] data Pointer to the first unread byte
+ * @return Length of the block in bytes, 0 if the ring is empty
+ */
+size_t cdc_rx_ring_peek_all(cdc_rx_ring_t *ring, const uint8_t **data);
+
+/**
+ * @brief Release data obtained by cdc_rx_ring_peek() (consumer)
+ *
+ * @param[in] ring Ring
+ * @param[in] len  Number of bytes to be released
+ */
+void cdc_rx_ring_consume(cdc_rx_ring_t *ring, size_t len);
+
+/**
+ * @brief Get number of bytes stored in the ring
+ *
+ * @param[in] ring Ring
+ * @return Number of bytes stored in the ring
+ */
+size_t cdc_rx_ring_used(cdc_rx_ring_t *ring);
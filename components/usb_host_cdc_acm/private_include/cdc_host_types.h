@@ -7,41 +7,201 @@
 #pragma once
 
 #include <stdint.h>
-#include <sys/queue.h>
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/timers.h"
+#include "freertos/queue.h"
 
 #include "usb/usb_host.h"      // For USB device handle and transfers
 #include "usb/cdc_acm_host.h"  // For callback types
 #include "usb/usb_types_cdc.h" // For protocol and serial state
+#include "cdc_host_rx_ring.h"
+#include "cdc_host_descriptor_parsing.h" // For functional descriptors
+
+#define CDC_ACM_CTRL_TRANSFER_SIZE (64) // All standard CTRL requests and responses fit in this size
+#define CDC_ACM_CTRL_QUEUE_LEN     (8)  // Number of asynchronous CTRL requests that can wait for the CTRL transfer
+#define CDC_ACM_IN_XFER_NUM_MAX (8) // Maximum number of bulk IN transfers that can be kept in flight
+#define CDC_ACM_OUT_XFER_NUM_MAX (8) // Maximum number of bulk OUT transfers that can be kept in flight
+#define CDC_ACM_RX_TASK_STACK_SIZE (4096)
+#define CDC_ACM_TX_TASK_STACK_SIZE (4096)
+
+// Adaptive IN transfer size hysteresis
+#define CDC_ACM_IN_SIZE_GROW_THRESHOLD   (2) // Number of consecutive full IN transfers that double the transfer size
+#define CDC_ACM_IN_SIZE_SHRINK_THRESHOLD (4) // Number of consecutive IN transfers filled to less than half that halve the transfer size
+
+// Reasons for paused polling of bulk IN endpoint
+#define CDC_ACM_RX_PAUSE_USER (1 << 0) // Paused by cdc_acm_host_rx_pause() or by full RX append buffer
+#define CDC_ACM_RX_PAUSE_FLOW (1 << 1) // RX ring reached high-water mark
 
 typedef struct cdc_dev_s cdc_dev_t;
+
+// Context of a bulk OUT transfer
+typedef struct {
+    cdc_dev_t *cdc_dev;                   // Device that owns the transfer
+    cdc_acm_tx_done_callback_t done_cb;   // User's TX completion callback, can be NULL
+    void *user_arg;                       // Argument of done_cb
+    uint32_t tx_seq;                      // Sequence number of cdc_acm_host_data_tx_blocking() call that submitted the transfer, 0 for other TX functions
+} cdc_out_xfer_ctx_t;
+
+// Asynchronous CTRL request
+typedef struct {
+    usb_setup_packet_t setup;             // Setup packet
+    uint8_t data[CDC_ACM_CTRL_TRANSFER_SIZE - sizeof(usb_setup_packet_t)]; // Copy of data of OUT request
+    uint8_t *data_ext;                    // Heap copy of data of OUT request that does not fit in data, NULL otherwise
+    cdc_acm_ctrl_done_callback_t done_cb; // User's completion callback, can be NULL
+    void *user_arg;                       // Argument of done_cb
+} cdc_ctrl_req_t;
+_Static_assert(CDC_ACM_ENCAP_MAX_SIZE <= sizeof(((cdc_ctrl_req_t *)0)->data), "Encapsulated command of default size does not fit in CTRL request");
+
+// Item of TX queue
+typedef struct {
+    const uint8_t *data;                  // Data to be sent, owned by the caller until done_cb
+    size_t data_len;                      // Length of data
+    cdc_acm_tx_done_callback_t done_cb;   // User's TX completion callback, can be NULL
+    void *user_arg;                       // Argument of done_cb
+} cdc_tx_item_t;
+
 struct cdc_dev_s {
     usb_device_handle_t dev_hdl;          // USB device handle
     void *cb_arg;                         // Common argument for user's callbacks (data IN and Notification)
     struct {
-        usb_transfer_t *out_xfer;         // OUT data transfer
-        usb_transfer_t *in_xfer;          // IN data transfer
+        usb_transfer_t *out_xfer[CDC_ACM_OUT_XFER_NUM_MAX]; // OUT data transfers
+        cdc_out_xfer_ctx_t out_ctx[CDC_ACM_OUT_XFER_NUM_MAX]; // Contexts of OUT data transfers
+        uint8_t out_xfer_num;             // Number of allocated OUT transfers, 0 for read-only devices
+        uint8_t out_xfer_idle;            // Bitmap of OUT transfers that are not submitted
+        uint16_t out_mps;                 // OUT endpoint Maximum Packet Size
+        SemaphoreHandle_t out_free;       // Counting semaphore of idle OUT transfers
+        usb_transfer_t *out_acquired;     // OUT transfer lent by cdc_acm_host_tx_acquire(), NULL if none
+        usb_transfer_t *in_xfer[CDC_ACM_IN_XFER_NUM_MAX]; // IN data transfers
+        uint8_t in_xfer_num;              // Number of allocated IN transfers, 0 for write-only devices
+        uint8_t in_xfer_idle;             // Bitmap of IN transfers that are not submitted
+        uint8_t in_pause;                 // Bitmap of CDC_ACM_RX_PAUSE_* reasons, IN transfers are not submitted while non-zero
+        bool in_flow_control;             // Pause IN polling instead of dropping data on RX overflow
+        bool in_adaptive;                 // Adapt size of IN transfers to the traffic
+        size_t in_xfer_size;              // Size of IN transfers requested from the device, multiple of in_mps
+        size_t in_xfer_size_max;          // Size of the IN buffer rounded down to in_mps
+        uint8_t in_full_cnt;              // Number of consecutive IN transfers that were filled completely
+        uint8_t in_short_cnt;             // Number of consecutive IN transfers that were filled to less than half
         cdc_acm_data_callback_t in_cb;    // User's callback for async (non-blocking) data IN
         uint16_t in_mps;                  // IN endpoint Maximum Packet Size
-        uint8_t *in_data_buffer_base;     // Pointer to IN data buffer in usb_transfer_t
+        uint8_t *in_data_buffer_base;     // Pointer to data buffer of the first IN transfer in usb_transfer_t
+        usb_transfer_t *in_xfer_spare[CDC_ACM_IN_XFER_NUM_MAX]; // Spare IN transfers, they replace IN transfers held by the user
+        uint8_t in_xfer_spare_num;        // Number of allocated spare IN transfers
+        uint8_t in_xfer_loaned;           // Bitmap of spare slots that contain a transfer held by the user
+        uint8_t in_xfer_hold;             // Spare slot (bitmap) reserved by cdc_acm_host_rx_buffer_hold() in current data_cb, 0 if none
+        usb_transfer_t *in_xfer_current;  // IN transfer passed to data_cb, NULL outside of data_cb
         const usb_intf_desc_t *intf_desc; // Pointer to data interface descriptor
-        SemaphoreHandle_t out_mux;        // OUT mutex
+        SemaphoreHandle_t out_mux;        // Serializes cdc_acm_host_data_tx_blocking() calls
+        SemaphoreHandle_t out_done;       // Counting semaphore given when an OUT transfer of cdc_acm_host_data_tx_blocking() completes
+        uint32_t out_done_seq;            // Sequence number of current cdc_acm_host_data_tx_blocking() call, completions of older calls are ignored
+        int out_done_cnt;                 // Number of completed OUT transfers of current cdc_acm_host_data_tx_blocking() call
+        esp_err_t out_done_status;        // First error of OUT transfers of cdc_acm_host_data_tx_blocking()
+        size_t out_done_len;              // Number of bytes sent by OUT transfers of cdc_acm_host_data_tx_blocking()
     } data;
 
+    struct {
+        cdc_rx_ring_t ring;               // Received data waiting for the RX task
+        TaskHandle_t task;                // RX task calling data_cb, NULL if data_cb is called from USB Host context
+        SemaphoreHandle_t task_done;      // Given by the RX task before it deletes itself
+        bool task_exit;                   // Request for the RX task to exit
+        SemaphoreHandle_t data_ready;     // Given after every write to the ring, only in pull mode (no data_cb)
+        SemaphoreHandle_t mux;            // Serializes cdc_acm_host_data_rx() calls
+        size_t trigger_level;             // cdc_acm_host_data_rx() returns once this many bytes are received
+        size_t high_water;                // IN polling is paused when the ring holds this many bytes, 0 to disable
+        size_t low_water;                 // IN polling is resumed when the ring drains to this many bytes
+    } rx;                                 // Deferred RX processing, only used if rx_ring_size is non-zero
+
+    struct {
+        TimerHandle_t timer;              // Flushes pending transfer at the deadline, NULL if coalescing is disabled
+        SemaphoreHandle_t mux;            // Protects pending transfer
+        SemaphoreHandle_t sync;           // Given by the timer service task after the timer is deleted
+        usb_transfer_t *pending;          // OUT transfer being filled, NULL if there is none
+        size_t pending_len;               // Number of bytes in pending transfer
+        TickType_t pending_since;         // Tick count when the first byte was added to pending transfer
+        bool flush_on_delimiter;          // Flush pending transfer when delimiter is written
+        uint8_t delimiter;                // Delimiter byte
+    } tx_coalesce;                        // TX coalescing, only used if tx_coalesce_ms is non-zero
+
+    struct {
+        QueueHandle_t queue;              // Queue of cdc_tx_item_t, NULL if TX task is disabled
+        TaskHandle_t task;                // TX task owning the OUT pipe
+        SemaphoreHandle_t task_done;      // Given by the TX task before it deletes itself
+        bool task_exit;                   // Request for the TX task to exit
+        bool closing;                     // The device is being closed: no new items are accepted and queued items are not sent
+        uint32_t users;                   // Number of cdc_acm_host_data_tx_queue() calls accessing the queue
+        cdc_acm_tx_queue_full_policy_t full_policy; // Behavior of cdc_acm_host_data_tx_queue() on full queue
+    } tx;                                 // TX task, only used if tx_queue_len is non-zero
+
+    struct {
+        bool enabled;                     // Pace OUT transfers of cdc_acm_host_data_tx_blocking()
+        uint32_t rate;                    // UART rate of the device in bytes per second, 0 if line coding is unknown
+        size_t fifo_size;                 // Estimated size of the device's TX FIFO in bytes
+        size_t backlog;                   // Estimated number of bytes waiting in the device's TX FIFO, protected by CDC-ACM spinlock
+        TickType_t backlog_tick;          // Tick count when backlog was last updated
+    } tx_pace;                            // TX pacing, only used if tx_pacing is true
+
     struct {
         usb_transfer_t *xfer;             // IN notification transfer
         const usb_intf_desc_t *intf_desc; // Pointer to notification interface descriptor, can be NULL if there is no notification channel in the device
         cdc_acm_host_dev_callback_t cb;   // User's callback for device events
+        cdc_acm_ctrl_done_callback_t encap_response_cb; // User's callback for encapsulated responses
     } notif;                              // Structure with Notif pipe data
 
     usb_transfer_t *ctrl_transfer;        // CTRL (endpoint 0) transfer
-    SemaphoreHandle_t ctrl_mux;           // CTRL mutex
+    uint16_t ctrl_buffer_size;            // Maximum data stage of CTRL requests. The transfer has one more byte to detect truncated encapsulated responses
+    SemaphoreHandle_t ctrl_mux;           // Ownership of CTRL transfer. Binary semaphore, so it can be returned from USB Host context (no priority inheritance)
+    SemaphoreHandle_t ctrl_done;          // Given when CTRL transfer of cdc_acm_host_send_custom_request() completes
+    struct {
+        QueueHandle_t queue;              // Queue of cdc_ctrl_req_t waiting for the CTRL transfer
+        cdc_ctrl_req_t current;           // Request in flight
+        bool closing;                     // Queued requests are not submitted anymore, the device is being closed
+    } ctrl_async;                         // Asynchronous CTRL requests
+    struct {
+        cdc_acm_line_coding_t line_coding; // Last line coding set to or read from the device
+        bool line_coding_valid;           // line_coding was set or read
+        uint16_t ctrl_line_state;         // Last control line state bitmap (DTR, RTS) set to the device
+        bool ctrl_line_state_valid;       // ctrl_line_state was set
+        uint8_t line_coding_pending;      // Number of queued asynchronous requests that set line coding
+        uint8_t ctrl_line_state_pending;  // Number of queued asynchronous requests that set control line state
+    } shadow;                             // Shadow copies of port settings, protected by CDC-ACM spinlock
     cdc_acm_uart_state_t serial_state;    // Serial State
+    cdc_acm_host_stats_t stats;           // Device statistics, protected by CDC-ACM spinlock
     cdc_comm_protocol_t comm_protocol;
     cdc_data_protocol_t data_protocol;
+    const usb_config_desc_t *config_desc; // Active Configuration descriptor, owned by USB Host library
     int cdc_func_desc_cnt;                // Number of CDC Functional descriptors in following array
-    const usb_standard_desc_t *(*cdc_func_desc)[]; // Pointer to array of pointers to const usb_standard_desc_t
-    SLIST_ENTRY(cdc_dev_s) list_entry;
+    cdc_func_desc_t cdc_func_desc[CDC_FUNC_DESC_MAX]; // CDC Functional descriptors, as offsets in config_desc
+    uint8_t cdc_func_desc_idx[USB_CDC_DESC_SUBTYPE_MAX]; // Index + 1 in cdc_func_desc of the first descriptor of each subtype, 0 if not present
+#if CONFIG_CDC_ACM_STATIC_POOL
+    struct {
+        StaticSemaphore_t ctrl_mux;
+        StaticSemaphore_t ctrl_done;
+        StaticQueue_t ctrl_queue;
+        uint8_t ctrl_queue_storage[CDC_ACM_CTRL_QUEUE_LEN * sizeof(cdc_ctrl_req_t)];
+        StaticSemaphore_t out_free;
+        StaticSemaphore_t out_done;
+        StaticSemaphore_t out_mux;
+        StaticSemaphore_t tx_coalesce_mux;
+        StaticSemaphore_t tx_coalesce_sync;
+        StaticTimer_t tx_coalesce_timer;
+        StaticSemaphore_t rx_data_ready;
+        StaticSemaphore_t rx_mux;
+        StaticSemaphore_t rx_task_done;
+        StaticSemaphore_t tx_task_done;
+#if CONFIG_CDC_ACM_STATIC_POOL_RX_RING_SIZE > 0
+        uint8_t rx_ring[2 * CONFIG_CDC_ACM_STATIC_POOL_RX_RING_SIZE]; // RX task needs twice the ring size, see cdc_rx_ring_peek_all()
+        StaticTask_t rx_task;
+        StackType_t rx_task_stack[CDC_ACM_RX_TASK_STACK_SIZE];
+#endif
+#if CONFIG_CDC_ACM_STATIC_POOL_TX_QUEUE_LEN > 0
+        StaticQueue_t tx_queue;
+        uint8_t tx_queue_storage[CONFIG_CDC_ACM_STATIC_POOL_TX_QUEUE_LEN * sizeof(cdc_tx_item_t)];
+        StaticTask_t tx_task;
+        StackType_t tx_task_stack[CDC_ACM_TX_TASK_STACK_SIZE];
+#endif
+    } static_buf;                         // Storage of FreeRTOS objects of a pooled device
+#endif
+    cdc_acm_dev_hdl_t hdl;                // Handle given to the user, NULL if the device is not in the device table
 };
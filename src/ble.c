@@ -10,11 +10,12 @@
 
 static const char* const TAG = "BRIDGE-BLE";
 #define BLE_SVC_SPP_UUID16 (0xABF0)
-#define BLE_SVC_SPP_CHR_UUID16 (0xABF1)
+#define BLE_SVC_SPP_CHR_UUID16 (0xABF1)  // Of channel 0.
 static const int CONFIG_EXAMPLE_IO_TYPE = 3;
 
 static uint8_t address_type;
-static bool client_notify_subscribed[CONFIG_BT_NIMBLE_MAX_CONNECTIONS + 1];
+static bool client_notify_subscribed[CONFIG_BT_NIMBLE_MAX_CONNECTIONS + 1]
+                                    [BLE_MAX_CHANNELS];
 static ble_data_receive_callback_t ble_data_receive_callback = NULL;
 
 
@@ -23,30 +24,48 @@ void ble_register_new_data_receive_callback(
   ble_data_receive_callback = callback;
 }
 
-static uint16_t ble_spp_service_gatt_read_val_handle;
+static uint16_t ble_spp_service_gatt_read_val_handles[BLE_MAX_CHANNELS];
 static int ble_service_gatt_handler(
     uint16_t conn_handle, uint16_t attr_handle,
     struct ble_gatt_access_ctxt* ctxt, void* arg);
+
+// Characteristic for READ | WRITE | NOTIFY of one channel; the channel is
+// passed to ble_service_gatt_handler() as arg.
+#define BLE_SPP_CHR_DEF(channel)                                          \
+  {                                                                       \
+    .uuid = BLE_UUID16_DECLARE(BLE_SVC_SPP_CHR_UUID16 + (channel)),       \
+    .access_cb = ble_service_gatt_handler,                                \
+    .arg = (void*)(intptr_t)(channel),                                    \
+    .val_handle = &ble_spp_service_gatt_read_val_handles[(channel)],      \
+    .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE |                 \
+             BLE_GATT_CHR_F_NOTIFY,                                       \
+  }
+_Static_assert(BLE_MAX_CHANNELS == 2, "Update new_ble_service_gatt_defs");
 static const struct ble_gatt_svc_def new_ble_service_gatt_defs[] = {
     {   // Service: SPP
         .type = BLE_GATT_SVC_TYPE_PRIMARY,
         .uuid = BLE_UUID16_DECLARE(BLE_SVC_SPP_UUID16),
         .characteristics = (struct ble_gatt_chr_def[]) {
-            {   // Single characteristic for READ | WRITE | NOTIFY.
-                .uuid = BLE_UUID16_DECLARE(BLE_SVC_SPP_CHR_UUID16),
-                .access_cb = ble_service_gatt_handler,
-                .val_handle = &ble_spp_service_gatt_read_val_handle,
-                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE |
-                         BLE_GATT_CHR_F_NOTIFY,
-            }, { 0, },  // No more characteristics
+            BLE_SPP_CHR_DEF(0),
+            BLE_SPP_CHR_DEF(1),
+            { 0, },  // No more characteristics
         },
     }, { 0, },  // No more services.
 };
 
+// Returns the channel of a characteristic value handle, or -1.
+static int ble_channel_from_val_handle(uint16_t val_handle) {
+  for (int i = 0; i < BLE_MAX_CHANNELS; ++i) {
+    if (ble_spp_service_gatt_read_val_handles[i] == val_handle) return i;
+  }
+  return -1;
+}
+
 
 static int ble_service_gatt_handler(
     uint16_t conn_handle, uint16_t attr_handle,
     struct ble_gatt_access_ctxt* ctxt, void* arg) {
+  const int channel = (int)(intptr_t)arg;
   switch (ctxt->op) {
   case BLE_GATT_ACCESS_OP_READ_CHR:
     ESP_LOGI(TAG, "Callback for read");
@@ -55,11 +74,13 @@ static int ble_service_gatt_handler(
   case BLE_GATT_ACCESS_OP_WRITE_CHR:
     ESP_LOGI(
         TAG,
-        "Data received in write event; conn_handle = %x; attr_handle = %x; "
-        "value = %.*s",
-        conn_handle, attr_handle, ctxt->om->om_len, ctxt->om->om_data);
+        "Data received in write event; channel = %d; conn_handle = %x; "
+        "attr_handle = %x; value = %.*s",
+        channel, conn_handle, attr_handle, ctxt->om->om_len,
+        ctxt->om->om_data);
     if (!ble_data_receive_callback) return 0;
-    return ble_data_receive_callback(ctxt->om->om_data, ctxt->om->om_len);
+    return ble_data_receive_callback(
+        channel, ctxt->om->om_data, ctxt->om->om_len);
 
   default:
     ESP_LOGI(TAG, "Default Callback");
@@ -192,7 +213,9 @@ static int ble_spp_server_gap_event(struct ble_gap_event *event, void* unused_ar
   case BLE_GAP_EVENT_DISCONNECT:
     ESP_LOGI(TAG, "Disconnected; reason=%d ", event->disconnect.reason);
     ble_spp_server_print_conn_desc(&event->disconnect.conn);
-    client_notify_subscribed[event->disconnect.conn.conn_handle] = false;
+    for (int i = 0; i < BLE_MAX_CHANNELS; ++i) {
+      client_notify_subscribed[event->disconnect.conn.conn_handle][i] = false;
+    }
     ble_spp_server_advertise();  // Connection terminated; resume advertising.
     return 0;
 
@@ -216,7 +239,7 @@ static int ble_spp_server_gap_event(struct ble_gap_event *event, void* unused_ar
              event->mtu.value);
     return 0;
 
-  case BLE_GAP_EVENT_SUBSCRIBE:
+  case BLE_GAP_EVENT_SUBSCRIBE: {
     ESP_LOGI(
         TAG,
         "Subscribe event; conn_handle=%d attr_handle=%d "
@@ -225,9 +248,14 @@ static int ble_spp_server_gap_event(struct ble_gap_event *event, void* unused_ar
         event->subscribe.reason, event->subscribe.prev_notify,
         event->subscribe.cur_notify, event->subscribe.prev_indicate,
         event->subscribe.cur_indicate);
-    client_notify_subscribed[
-        event->subscribe.conn_handle] = event->subscribe.cur_notify;
+    const int channel =
+        ble_channel_from_val_handle(event->subscribe.attr_handle);
+    if (channel >= 0) {
+      client_notify_subscribed[event->subscribe.conn_handle][channel] =
+          event->subscribe.cur_notify;
+    }
     return 0;
+  }
 
   default:
     return 0;
@@ -310,7 +338,9 @@ void ble_setup() {
   ESP_ERROR_CHECK(ret);
   ESP_ERROR_CHECK(nimble_port_init());
   for (int i = 0; i <= CONFIG_BT_NIMBLE_MAX_CONNECTIONS; ++i) {
-    client_notify_subscribed[i] = false;
+    for (int j = 0; j < BLE_MAX_CHANNELS; ++j) {
+      client_notify_subscribed[i][j] = false;
+    }
   }
 
   // Initialize the NimBLE host configuration.
@@ -327,16 +357,44 @@ void ble_setup() {
   nimble_port_freertos_init(ble_spp_server_host_task);
 }
 
-int ble_write_and_notify_subscribed_clients(const uint8_t* buf, size_t buf_len) {
+int ble_write_and_notify_subscribed_clients(
+    int channel, const uint8_t* buf, size_t buf_len) {
+  const ble_segment_t segment = {.buf = buf, .len = buf_len};
+  return ble_write_and_notify_subscribed_clients_segments(channel, &segment, 1);
+}
+
+// Copies the segments straight into an mbuf chain, so the caller does not need
+// to assemble the message in a contiguous buffer first.
+static struct os_mbuf* ble_mbuf_from_segments(
+    const ble_segment_t* segments, int segment_count) {
+  struct os_mbuf* om = ble_hs_mbuf_from_flat(segments[0].buf, segments[0].len);
+  if (!om) return NULL;
+  for (int i = 1; i < segment_count; ++i) {
+    if (os_mbuf_append(om, segments[i].buf, segments[i].len) != 0) {
+      os_mbuf_free_chain(om);
+      return NULL;
+    }
+  }
+  return om;
+}
+
+int ble_write_and_notify_subscribed_clients_segments(
+    int channel, const ble_segment_t* segments, int segment_count) {
+  assert(segment_count > 0);
+  assert(channel >= 0 && channel < BLE_MAX_CHANNELS);
   int clients_notified = 0;
   for (int i = 0; i <= CONFIG_BT_NIMBLE_MAX_CONNECTIONS; ++i) {
-    if (!client_notify_subscribed[i]) continue;
-    struct os_mbuf* txom = ble_hs_mbuf_from_flat(buf, buf_len);
+    if (!client_notify_subscribed[i][channel]) continue;
+    struct os_mbuf* txom = ble_mbuf_from_segments(segments, segment_count);
+    if (!txom) {
+      ESP_LOGE(TAG, "Out of mbufs for write and notify");
+      continue;
+    }
+    const int txom_len = OS_MBUF_PKTLEN(txom);  // txom is consumed below.
     const int rc = ble_gatts_notify_custom(
-        i, ble_spp_service_gatt_read_val_handle, txom);
+        i, ble_spp_service_gatt_read_val_handles[channel], txom);
     if (rc == 0) {
-      ESP_LOGI(TAG, "Write and notify sent successfully; message: %.*s",
-               buf_len, buf);
+      ESP_LOGI(TAG, "Write and notify sent successfully; %d bytes", txom_len);
       ++clients_notified;
     } else {
       ESP_LOGI(TAG, "Error in write and notify; rc = %d", rc);
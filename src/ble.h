@@ -4,18 +4,32 @@
  *   https://github.com/espressif/esp-idf/tree/master/examples/bluetooth/nimble/ble_spp/spp_server
  *
  * Note that there is no official SPP standard for BLE. In this case a service
- * is created with a single READ / WRITE / NOTIFY characteristic that is used
- * for exchanging data.
+ * is created with one READ / WRITE / NOTIFY characteristic per channel that is
+ * used for exchanging data.
  */
 #pragma once
 
 #include <stddef.h>
 #include <stdint.h>
 
+// Each channel is a characteristic of the SPP service, with UUID
+// 0xABF1 + channel.
+#define BLE_MAX_CHANNELS (2)
+
 typedef int (*ble_data_receive_callback_t)(
-    const uint8_t* data, size_t data_len);
+    int channel, const uint8_t* data, size_t data_len);
+
+// One piece of a message that is not stored contiguously in memory.
+typedef struct {
+  const uint8_t* buf;
+  size_t len;
+} ble_segment_t;
 
 void ble_setup();
-int ble_write_and_notify_subscribed_clients(const uint8_t* buf, size_t buf_len);
+int ble_write_and_notify_subscribed_clients(
+    int channel, const uint8_t* buf, size_t buf_len);
+// Sends the concatenation of the segments as a single notification.
+int ble_write_and_notify_subscribed_clients_segments(
+    int channel, const ble_segment_t* segments, int segment_count);
 void ble_register_new_data_receive_callback(
     ble_data_receive_callback_t callback);
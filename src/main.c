@@ -6,46 +6,106 @@
  * Tested on a ESP32-S3 DevKitC 2022-v1.3 development board (with dual USB-C
  * connectors). USB CAT connection tested with a QDX.  BLE client connection
  * tested with the nRF Connect app for Android.
+ *
+ * Several USB ports can be bridged at once: USB port N, selected by
+ * usb_routes[N], is bridged to BLE channel N.
  */
 
+#include <string.h>
 #include "esp_log.h"
 #include "freertos/ringbuf.h"
 #include "ble.h"
 #include "usb.h"
 
-#define BUFFER_SIZE (4096)
+// Maximum number of USB buffers held while waiting for the end of a message.
+// Should not exceed rx_loan_count in usb.c.
+#define MAX_HELD_SEGMENTS (4)
+
+// USB ports to bridge, routed by VID/PID/serial number and interface.
+static const usb_route_t usb_routes[] = {
+    // First port of any device; the QDX has a single port.
+    {.vid = CDC_HOST_ANY_VID, .pid = CDC_HOST_ANY_PID, .interface_idx = 0},
+    // Second port of a dual-port adapter, e.g. a CH342. Uncomment and adjust
+    // VID/PID to bridge it; set .serial to pick one device out of several of
+    // the same model.
+    // {.vid = 0x1A86, .pid = 0x55D2, .interface_idx = 2},
+};
+#define BRIDGE_CHANNEL_COUNT (sizeof(usb_routes) / sizeof(usb_routes[0]))
+_Static_assert(
+    BRIDGE_CHANNEL_COUNT <= USB_MAX_PORTS &&
+        BRIDGE_CHANNEL_COUNT <= BLE_MAX_CHANNELS,
+    "Too many routes");
 
-int bridge_ble_data_to_usb(const uint8_t* data, size_t data_len) {
-  usb_tx_blocking_if_connected(data, data_len, /*timeout_ms=*/1000);
+int bridge_ble_data_to_usb(int channel, const uint8_t* data, size_t data_len) {
+  usb_tx_coalesced_if_connected(channel, data, data_len, /*timeout_ms=*/1000);
   return 0;  // No error.
 }
 
 // Simply copies data from USB to BLE as it comes in.
 bool bridge_usb_data_to_ble_direct(
-    const uint8_t* data, size_t data_len, void* unused_arg) {
-  ble_write_and_notify_subscribed_clients(data, data_len);
+    int channel, const uint8_t* data, size_t data_len) {
+  ble_write_and_notify_subscribed_clients(channel, data, data_len);
   return true;  // Data consumed.
 }
 
-// Buffers incoming USB data until the end of a message (a semicolon) is 
-// detected, and then sends the complete message to BLE.
+// Pieces of the current message of a channel that are still in held USB
+// buffers, plus one slot for the final piece that completes the message.
+typedef struct {
+  ble_segment_t segments[MAX_HELD_SEGMENTS + 1];
+  int count;
+} held_message_t;
+
+static held_message_t held_messages[BRIDGE_CHANNEL_COUNT];
+
+// Sends the held pieces followed by `tail` as one BLE message and returns the
+// held USB buffers to the driver.
+static void send_held_message(
+    int channel, const uint8_t* tail, size_t tail_len) {
+  held_message_t* held = &held_messages[channel];
+  held->segments[held->count].buf = tail;
+  held->segments[held->count].len = tail_len;
+  ble_write_and_notify_subscribed_clients_segments(
+      channel, held->segments, held->count + 1);
+  for (int i = 0; i < held->count; ++i) {
+    usb_rx_buffer_release(channel, held->segments[i].buf);
+  }
+  held->count = 0;
+}
+
+// Held buffers are freed by the driver when the device goes away.
+static void drop_held_message(int channel) {
+  held_messages[channel].count = 0;
+}
+
+// Holds incoming USB buffers until the end of a message (a semicolon) is
+// detected, and then sends the complete message to BLE. The message is copied
+// only once, straight from the USB buffers to the BLE mbuf.
 bool bridge_usb_data_to_ble_buffer_to_end_of_message(
-    const uint8_t* data, size_t data_len, void* unused_arg) {
-  static uint8_t buffer[BUFFER_SIZE];
-  static int buffer_index = 0;
-  for (int i = 0; i < data_len; ++i) {
-    buffer[buffer_index++] = data[i];
-    if (data[i] == ';' || buffer_index == BUFFER_SIZE) {
-      ble_write_and_notify_subscribed_clients(buffer, buffer_index);
-      buffer_index = 0;
-    }
+    int channel, const uint8_t* data, size_t data_len) {
+  held_message_t* held = &held_messages[channel];
+  const uint8_t* end = data + data_len;
+  const uint8_t* delimiter;
+  while ((delimiter = memchr(data, ';', end - data)) != NULL) {
+    send_held_message(channel, data, delimiter + 1 - data);
+    data = delimiter + 1;
+  }
+  if (data == end) return true;  // Data consumed.
+
+  // Incomplete message; keep the USB buffer until the rest arrives. If no more
+  // buffers can be held, send what we have so far.
+  if (held->count == MAX_HELD_SEGMENTS || !usb_rx_buffer_hold(channel, data)) {
+    send_held_message(channel, data, end - data);
+    return true;
   }
+  held->segments[held->count].buf = data;
+  held->segments[held->count].len = end - data;
+  ++held->count;
   return true;  // Data consumed.
 }
 
 void app_main() {
   ble_setup();
-  usb_setup();
+  usb_setup(usb_routes, BRIDGE_CHANNEL_COUNT);
 
   ble_register_new_data_receive_callback(bridge_ble_data_to_usb);
 
@@ -54,4 +114,5 @@ void app_main() {
   // usb_register_new_data_receive_callback(bridge_usb_data_to_ble_direct)
   usb_register_new_data_receive_callback(
       bridge_usb_data_to_ble_buffer_to_end_of_message);
+  usb_register_disconnect_callback(drop_held_message);
 }
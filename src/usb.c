@@ -1,26 +1,92 @@
 #include "usb.h"
+#include <stdio.h>
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "freertos/ringbuf.h"
 #include "usb/usb_host.h"
 #include "usb/cdc_acm_host.h"
 
+// The driver opens the device as soon as it is enumerated, so the timeout only
+// bounds a single attempt.
+#define USB_OPEN_TIMEOUT_MS (100)
+// Failed open or configuration is retried with exponential backoff; after the
+// last attempt we wait for the device to be plugged in again.
+#define USB_RETRY_MAX (5)
+#define USB_RETRY_BACKOFF_FIRST_MS (10)
+#define USB_RETRY_BACKOFF_MAX_MS (160)
+// Data written while the device is away are sent after reconnect, if it comes
+// back within this time. Longer outages drop them, as stale CAT commands could
+// key the radio unexpectedly.
+#define USB_TX_HOLD_MS (2000)
+#define USB_TX_HOLD_BUFFER_SIZE (1024)
+
+// Bits of usb_port_t.events.
+#define USB_EVENT_NEW_DEVICE BIT0
+#define USB_EVENT_DISCONNECTED BIT1
+
+typedef enum {
+  USB_STATE_IDLE,         // No device; waiting for one to be plugged in.
+  USB_STATE_ENUMERATING,  // Opening the device, with bounded retries.
+  USB_STATE_CONFIGURING,  // Setting line coding and control lines.
+  USB_STATE_STREAMING,    // Data flows both ways.
+  USB_STATE_DRAINING,     // Device is gone; the handle must not be used.
+  USB_STATE_CLOSED,       // Handle closed; TX data are held for a while.
+} usb_state_t;
+
+static const char* const usb_state_names[] = {
+    "Idle", "Enumerating", "Configuring", "Streaming", "Draining", "Closed",
+};
+
 static const char* const TAG = "BRIDGE-USB";
 
-static SemaphoreHandle_t new_device_semaphore;
-static SemaphoreHandle_t device_disconnected_semaphore;
-// TODO(K6PLI): Add a mutex for cdc_device.
-static cdc_acm_dev_hdl_t cdc_device = NULL;
-static cdc_acm_data_callback_t usb_data_receive_callback = NULL;
+typedef struct {
+  int index;
+  const usb_route_t* route;
+  EventGroupHandle_t events;
+  // Serializes use of cdc_device with its open and close.
+  SemaphoreHandle_t device_mutex;
+  cdc_acm_dev_hdl_t cdc_device;
+  // State and TX hold are also changed from the driver callback, which must
+  // not block on device_mutex.
+  usb_state_t state;
+  bool tx_hold_active;
+  TickType_t tx_hold_deadline;
+  RingbufHandle_t tx_hold_buffer;
+} usb_port_t;
 
-void usb_register_new_data_receive_callback(cdc_acm_data_callback_t callback) {
+static usb_port_t usb_ports[USB_MAX_PORTS];
+static int usb_port_count = 0;
+static portMUX_TYPE state_lock = portMUX_INITIALIZER_UNLOCKED;
+static usb_data_receive_callback_t usb_data_receive_callback = NULL;
+static void (*usb_disconnect_callback)(int port) = NULL;
+
+void usb_register_new_data_receive_callback(
+    usb_data_receive_callback_t callback) {
   usb_data_receive_callback = callback;
 }
 
-// Temporarily give access to this for easier hacking.
-cdc_acm_dev_hdl_t usb_get_device() {
-  return cdc_device;
+void usb_register_disconnect_callback(void (*callback)(int port)) {
+  usb_disconnect_callback = callback;
+}
+
+static usb_state_t get_state(const usb_port_t* port) {
+  portENTER_CRITICAL(&state_lock);
+  const usb_state_t state = port->state;
+  portEXIT_CRITICAL(&state_lock);
+  return state;
+}
+
+static void set_state(usb_port_t* port, usb_state_t state) {
+  portENTER_CRITICAL(&state_lock);
+  const usb_state_t old_state = port->state;
+  port->state = state;
+  portEXIT_CRITICAL(&state_lock);
+  ESP_LOGI(
+      TAG, "Port %d: %s -> %s", port->index, usb_state_names[old_state],
+      usb_state_names[state]);
 }
 
 static void usb_lib_task(void* unused_arg) {
@@ -37,19 +103,30 @@ static void usb_lib_task(void* unused_arg) {
 }
 
 static void handle_cdc_event(const cdc_acm_host_dev_event_data_t* event, void* user_ctx) {
+  usb_port_t* port = user_ctx;
   switch (event->type) {
   case CDC_ACM_HOST_ERROR:
-    ESP_LOGE(TAG, "CDC-ACM error has occurred, err_no = %i", event->data.error);
+    ESP_LOGE(
+        TAG, "Port %d: CDC-ACM error has occurred, err_no = %i", port->index,
+        event->data.error);
     break;
   case CDC_ACM_HOST_DEVICE_DISCONNECTED:
-    ESP_LOGI(TAG, "Device disconnected");
-    assert(event->data.cdc_hdl == cdc_device);
-    cdc_device = NULL;
-    ESP_ERROR_CHECK(cdc_acm_host_close(event->data.cdc_hdl));
-    xSemaphoreGive(device_disconnected_semaphore);
+    // The handle is closed by usb_connection_task; closing it here, from the
+    // driver's own context, left the device unusable until power cycled.
+    ESP_LOGI(TAG, "Port %d: Device disconnected", port->index);
+    if (usb_disconnect_callback) usb_disconnect_callback(port->index);
+    portENTER_CRITICAL(&state_lock);
+    if (port->state == USB_STATE_STREAMING) port->state = USB_STATE_DRAINING;
+    port->tx_hold_active = true;
+    port->tx_hold_deadline =
+        xTaskGetTickCount() + pdMS_TO_TICKS(USB_TX_HOLD_MS);
+    portEXIT_CRITICAL(&state_lock);
+    xEventGroupSetBits(port->events, USB_EVENT_DISCONNECTED);
     break;
   case CDC_ACM_HOST_SERIAL_STATE:
-    ESP_LOGI(TAG, "Serial state notify 0x%04X", event->data.serial_state.val);
+    ESP_LOGI(
+        TAG, "Port %d: Serial state notify 0x%04X", port->index,
+        event->data.serial_state.val);
     break;
   case CDC_ACM_HOST_NETWORK_CONNECTION:
   default:
@@ -59,70 +136,241 @@ static void handle_cdc_event(const cdc_acm_host_dev_event_data_t* event, void* u
 }
 
 static bool handle_cdc_rx(const uint8_t *data, size_t data_len, void* arg) {
-  ESP_LOGI(TAG, "Data received: %.*s", data_len, data);
+  const usb_port_t* port = arg;
+  ESP_LOGD(TAG, "Port %d: Data received: %.*s", port->index, data_len, data);
   if (!usb_data_receive_callback) return true;
-  return usb_data_receive_callback(data, data_len, arg);
+  return usb_data_receive_callback(port->index, data, data_len);
 }
 
+// Any port may be waiting for the new device.
 static void handle_new_device(usb_device_handle_t new_usb_device) {
-  assert(new_device_semaphore);
-  xSemaphoreGive(new_device_semaphore);
+  for (int i = 0; i < usb_port_count; ++i) {
+    xEventGroupSetBits(usb_ports[i].events, USB_EVENT_NEW_DEVICE);
+  }
 }
 
-static void new_device_task(void* unused_arg) {
+static esp_err_t open_device(usb_port_t* port) {
+  const usb_route_t* route = port->route;
   const cdc_acm_host_device_config_t cdc_device_config = {
-      .connection_timeout_ms = 1000,
+      .connection_timeout_ms = USB_OPEN_TIMEOUT_MS,
       .out_buffer_size = 4096,
       .in_buffer_size = 4096,
-      .user_arg = NULL,
+      .user_arg = port,
       .event_cb = handle_cdc_event,
       .data_cb = handle_cdc_rx,
+      // Spare IN buffers, so received data can be held instead of copied.
+      .rx_loan_count = 4,
+      // Merge short BLE writes; a CAT command ends with ';'.
+      .tx_coalesce_ms = 5,
+      .tx_flush_on_delimiter = true,
+      .tx_delimiter = ';',
+      // Devices with equal VID/PID are told apart by the driver.
+      .serial_number = route->serial,
   };
-  while(true) {
-    assert(new_device_semaphore);
-    xSemaphoreTake(new_device_semaphore, portMAX_DELAY);
-    ESP_LOGI(TAG, "Opening CDC ACM device...");
-    esp_err_t err = cdc_acm_host_open(
-        CDC_HOST_ANY_VID, CDC_HOST_ANY_PID, 0, &cdc_device_config, &cdc_device);
+  // A disconnect of the previous device is no longer of interest.
+  xEventGroupClearBits(port->events, USB_EVENT_DISCONNECTED);
+  cdc_acm_dev_hdl_t device = NULL;
+  esp_err_t err = cdc_acm_host_open(
+      route->vid, route->pid, route->interface_idx, &cdc_device_config,
+      &device);
+  if (err != ESP_OK) {
+    ESP_LOGW(
+        TAG, "Port %d: Failed to open device as CDC ACM: %s", port->index,
+        esp_err_to_name(err));
+    return err;
+  }
+  cdc_acm_host_desc_print(device);
+  xSemaphoreTake(port->device_mutex, portMAX_DELAY);
+  port->cdc_device = device;
+  xSemaphoreGive(port->device_mutex);
+  return ESP_OK;
+}
+
+// Closing resets the device's endpoints, so the next open starts clean.
+static void close_device(usb_port_t* port) {
+  xSemaphoreTake(port->device_mutex, portMAX_DELAY);
+  if (port->cdc_device) {
+    const esp_err_t err = cdc_acm_host_close(port->cdc_device);
     if (err != ESP_OK) {
-      ESP_LOGI(TAG, "Failed to open device as CDC ACM.");
-      continue;
+      ESP_LOGW(
+          TAG, "Port %d: Failed to close device: %s", port->index,
+          esp_err_to_name(err));
     }
-    assert(cdc_device);
-    cdc_acm_host_desc_print(cdc_device);
+    port->cdc_device = NULL;
+  }
+  xSemaphoreGive(port->device_mutex);
+}
 
-    cdc_acm_line_coding_t line_coding;
-    ESP_ERROR_CHECK(cdc_acm_host_line_coding_get(cdc_device, &line_coding));
-    ESP_LOGI(
-        TAG,
-        "Line Get: Rate: %"PRIu32", Stop bits: %"PRIu8", Parity: %"PRIu8", "
-        "Databits: %"PRIu8"",
-        line_coding.dwDTERate, line_coding.bCharFormat, line_coding.bParityType,
-        line_coding.bDataBits);
-
-    ESP_LOGI(TAG, "Setting line coding.");
-    line_coding.dwDTERate = 9600;
-    line_coding.bDataBits = 8;
-    line_coding.bParityType = 0;
-    line_coding.bCharFormat = 0;
-    ESP_ERROR_CHECK(cdc_acm_host_line_coding_set(cdc_device, &line_coding));
-
-    ESP_ERROR_CHECK(cdc_acm_host_line_coding_get(cdc_device, &line_coding));
-    ESP_LOGI(
-        TAG,
-        "Line Get: Rate: %"PRIu32", Stop bits: %"PRIu8", Parity: %"PRIu8", "
-        "Databits: %"PRIu8"",
-        line_coding.dwDTERate, line_coding.bCharFormat, line_coding.bParityType,
-        line_coding.bDataBits);
+static esp_err_t configure_device(usb_port_t* port) {
+  // DTR and RTS stay deasserted, some radios key the transmitter on them.
+  // Settings equal to the driver's shadow copy are not sent again.
+  const cdc_acm_line_coding_t line_coding = {
+      .dwDTERate = 9600,
+      .bDataBits = 8,
+      .bParityType = 0,
+      .bCharFormat = 0,
+  };
+  const esp_err_t err = cdc_acm_host_apply_port_settings(
+      port->cdc_device, &line_coding, false, false);
+  if (err != ESP_OK) {
+    ESP_LOGW(
+        TAG, "Port %d: Failed to set line coding: %s", port->index,
+        esp_err_to_name(err));
+    return err;
+  }
+  ESP_LOGI(
+      TAG,
+      "Port %d: Line Set: Rate: %"PRIu32", Stop bits: %"PRIu8", "
+      "Parity: %"PRIu8", Databits: %"PRIu8"",
+      port->index, line_coding.dwDTERate, line_coding.bCharFormat,
+      line_coding.bParityType, line_coding.bDataBits);
+  return ESP_OK;
+}
+
+// Discards held TX data once the hold time is over.
+static void tx_hold_drop(usb_port_t* port) {
+  size_t item_size;
+  void* item;
+  int dropped = 0;
+  while ((item = xRingbufferReceive(port->tx_hold_buffer, &item_size, 0)) !=
+         NULL) {
+    vRingbufferReturnItem(port->tx_hold_buffer, item);
+    ++dropped;
+  }
+  portENTER_CRITICAL(&state_lock);
+  port->tx_hold_active = false;
+  portEXIT_CRITICAL(&state_lock);
+  if (dropped) {
+    ESP_LOGW(
+        TAG, "Port %d: Dropped %d writes held during disconnect", port->index,
+        dropped);
+  }
+}
+
+// Sends the data held during a short disconnect, then lets new writes through.
+// Holding device_mutex keeps new writes behind the held ones.
+static void start_streaming(usb_port_t* port) {
+  xSemaphoreTake(port->device_mutex, portMAX_DELAY);
+  size_t item_size;
+  void* item;
+  while ((item = xRingbufferReceive(port->tx_hold_buffer, &item_size, 0)) !=
+         NULL) {
+    const esp_err_t err = cdc_acm_host_data_tx_blocking(
+        port->cdc_device, item, item_size, /*timeout_ms=*/1000);
+    if (err != ESP_OK) {
+      ESP_LOGW(
+          TAG, "Port %d: Failed to send held data: %s", port->index,
+          esp_err_to_name(err));
+    }
+    vRingbufferReturnItem(port->tx_hold_buffer, item);
+  }
+  portENTER_CRITICAL(&state_lock);
+  port->tx_hold_active = false;
+  portEXIT_CRITICAL(&state_lock);
+  // Devices plugged in while opening this one are of no interest.
+  xEventGroupClearBits(port->events, USB_EVENT_NEW_DEVICE);
+  set_state(port, USB_STATE_STREAMING);
+  xSemaphoreGive(port->device_mutex);
+}
+
+// Returns the time until held TX data expire, or portMAX_DELAY if none.
+static TickType_t tx_hold_remaining(const usb_port_t* port) {
+  TickType_t remaining = portMAX_DELAY;
+  portENTER_CRITICAL(&state_lock);
+  if (port->tx_hold_active) {
+    const TickType_t now = xTaskGetTickCount();
+    remaining = ((TickType_t)(port->tx_hold_deadline - now) <
+                 pdMS_TO_TICKS(USB_TX_HOLD_MS))
+                    ? port->tx_hold_deadline - now
+                    : 0;
+  }
+  portEXIT_CRITICAL(&state_lock);
+  return remaining;
+}
+
+// Waits before the next attempt and returns the state to retry from, or Idle
+// after the last attempt.
+static usb_state_t retry_after_backoff(const usb_port_t* port, int* attempt) {
+  if (++*attempt >= USB_RETRY_MAX) {
+    ESP_LOGW(TAG, "Port %d: Giving up after %d attempts", port->index, *attempt);
+    return (tx_hold_remaining(port) != portMAX_DELAY) ? USB_STATE_CLOSED
+                                                      : USB_STATE_IDLE;
+  }
+  int backoff_ms = USB_RETRY_BACKOFF_FIRST_MS << (*attempt - 1);
+  if (backoff_ms > USB_RETRY_BACKOFF_MAX_MS) {
+    backoff_ms = USB_RETRY_BACKOFF_MAX_MS;
+  }
+  vTaskDelay(pdMS_TO_TICKS(backoff_ms));
+  return USB_STATE_ENUMERATING;
+}
 
-    // Block until device is disconnected; only one device is allowed at one
-    // time.
-    assert(device_disconnected_semaphore);
-    xSemaphoreTake(device_disconnected_semaphore, portMAX_DELAY);
+// Idle -> Enumerating -> Configuring -> Streaming -> Draining -> Closed.
+// Closed goes back to Enumerating when a device is plugged in while TX data
+// are held, or to Idle when the hold time is over.
+static void usb_connection_task(void* arg) {
+  usb_port_t* port = arg;
+  int attempt = 0;
+  while (true) {
+    switch (get_state(port)) {
+    case USB_STATE_IDLE:
+    case USB_STATE_CLOSED: {
+      const EventBits_t bits = xEventGroupWaitBits(
+          port->events, USB_EVENT_NEW_DEVICE, pdTRUE, pdFALSE,
+          tx_hold_remaining(port));
+      if (bits & USB_EVENT_NEW_DEVICE) {
+        attempt = 0;
+        set_state(port, USB_STATE_ENUMERATING);
+      } else {
+        tx_hold_drop(port);
+        set_state(port, USB_STATE_IDLE);
+      }
+      break;
+    }
+    case USB_STATE_ENUMERATING:
+      if (open_device(port) == ESP_OK) {
+        set_state(port, USB_STATE_CONFIGURING);
+      } else {
+        set_state(port, retry_after_backoff(port, &attempt));
+      }
+      break;
+    case USB_STATE_CONFIGURING:
+      if (configure_device(port) == ESP_OK) {
+        attempt = 0;
+        start_streaming(port);
+      } else if (xEventGroupGetBits(port->events) & USB_EVENT_DISCONNECTED) {
+        // Unplugged during configuration; wait for it to come back.
+        set_state(port, USB_STATE_DRAINING);
+      } else {
+        close_device(port);
+        set_state(port, retry_after_backoff(port, &attempt));
+      }
+      break;
+    case USB_STATE_STREAMING: {
+      // A device plugged in while streaming is for another port and is
+      // dropped. One that comes with the disconnect may be ours coming back,
+      // so Closed still sees it.
+      const EventBits_t bits = xEventGroupWaitBits(
+          port->events, USB_EVENT_NEW_DEVICE | USB_EVENT_DISCONNECTED,
+          pdFALSE, pdFALSE, portMAX_DELAY);
+      if (bits & USB_EVENT_DISCONNECTED) {
+        // handle_cdc_event() already stops new writes.
+        xEventGroupClearBits(port->events, USB_EVENT_DISCONNECTED);
+        set_state(port, USB_STATE_DRAINING);
+      } else {
+        xEventGroupClearBits(port->events, USB_EVENT_NEW_DEVICE);
+      }
+      break;
+    }
+    case USB_STATE_DRAINING:
+      close_device(port);
+      set_state(port, USB_STATE_CLOSED);
+      break;
+    }
   }
 }
 
-void usb_setup() {
+void usb_setup(const usb_route_t* routes, int route_count) {
+  assert(route_count > 0 && route_count <= USB_MAX_PORTS);
   ESP_LOGI(TAG, "Installing USB Host");
   const usb_host_config_t host_config = {
       .skip_phy_setup = false,
@@ -138,19 +386,78 @@ void usb_setup() {
   ESP_LOGI(TAG, "Installing CDC-ACM driver");
   ESP_ERROR_CHECK(cdc_acm_host_install(NULL));
 
-  new_device_semaphore = xSemaphoreCreateBinary();
-  device_disconnected_semaphore = xSemaphoreCreateBinary();
+  for (int i = 0; i < route_count; ++i) {
+    usb_port_t* port = &usb_ports[i];
+    port->index = i;
+    port->route = &routes[i];
+    port->state = USB_STATE_IDLE;
+    port->events = xEventGroupCreate();
+    port->device_mutex = xSemaphoreCreateMutex();
+    port->tx_hold_buffer =
+        xRingbufferCreate(USB_TX_HOLD_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+    assert(port->events && port->device_mutex && port->tx_hold_buffer);
+  }
+  usb_port_count = route_count;
   ESP_ERROR_CHECK(cdc_acm_host_register_new_dev_callback(handle_new_device));
-  task_created = xTaskCreate(
-      new_device_task, "new_device", 4096, xTaskGetCurrentTaskHandle(), USB_HOST_PRIORITY, NULL);
-  assert(task_created == pdTRUE);
+  for (int i = 0; i < usb_port_count; ++i) {
+    char task_name[configMAX_TASK_NAME_LEN];
+    snprintf(task_name, sizeof(task_name), "usb_port%d", i);
+    task_created = xTaskCreate(
+        usb_connection_task, task_name, 4096, &usb_ports[i], USB_HOST_PRIORITY,
+        NULL);
+    assert(task_created == pdTRUE);
+  }
+}
+
+bool usb_rx_buffer_hold(int port, const uint8_t* data) {
+  const cdc_acm_dev_hdl_t device = usb_ports[port].cdc_device;
+  if (!device) return false;
+  return cdc_acm_host_rx_buffer_hold(device, data) == ESP_OK;
+}
+
+void usb_rx_buffer_release(int port, const uint8_t* data) {
+  const cdc_acm_dev_hdl_t device = usb_ports[port].cdc_device;
+  if (!device) return;
+  cdc_acm_host_rx_buffer_release(device, data);
+}
+
+// Sends data while streaming. During a short disconnect the data are held and
+// sent after reconnect.
+static bool usb_tx(
+    usb_port_t* port, const uint8_t* buf, size_t buf_len, uint32_t timeout_ms,
+    bool coalesced) {
+  xSemaphoreTake(port->device_mutex, portMAX_DELAY);
+  const TickType_t hold_ticks = tx_hold_remaining(port);
+  bool sent = false;
+  if (get_state(port) == USB_STATE_STREAMING) {
+    const cdc_acm_dev_hdl_t device = port->cdc_device;
+    const esp_err_t err =
+        coalesced
+            ? cdc_acm_host_data_tx_coalesced(device, buf, buf_len, timeout_ms)
+            : cdc_acm_host_data_tx_blocking(device, buf, buf_len, timeout_ms);
+    if (err != ESP_OK) {
+      ESP_LOGW(
+          TAG, "Port %d: Failed to send data: %s", port->index,
+          esp_err_to_name(err));
+    }
+    sent = (err == ESP_OK);
+  } else if (hold_ticks != 0 && hold_ticks != portMAX_DELAY) {
+    sent = xRingbufferSend(port->tx_hold_buffer, buf, buf_len, 0) == pdTRUE;
+    if (!sent) ESP_LOGW(TAG, "Port %d: TX hold buffer full", port->index);
+  }
+  xSemaphoreGive(port->device_mutex);
+  return sent;
 }
 
 bool usb_tx_blocking_if_connected(
-    const uint8_t* buf, size_t buf_len, uint32_t timeout_ms) {
-  if (!cdc_device) return false;
-  ESP_ERROR_CHECK(
-      cdc_acm_host_data_tx_blocking(cdc_device, buf, buf_len, timeout_ms));
-  return true;
+    int port, const uint8_t* buf, size_t buf_len, uint32_t timeout_ms) {
+  if (port < 0 || port >= usb_port_count) return false;
+  return usb_tx(
+      &usb_ports[port], buf, buf_len, timeout_ms, /*coalesced=*/false);
 }
 
+bool usb_tx_coalesced_if_connected(
+    int port, const uint8_t* buf, size_t buf_len, uint32_t timeout_ms) {
+  if (port < 0 || port >= usb_port_count) return false;
+  return usb_tx(&usb_ports[port], buf, buf_len, timeout_ms, /*coalesced=*/true);
+}
@@ -1,8 +1,11 @@
 /*
- * Code to act as USB host for a CDC ACM compatible device.
+ * Code to act as USB host for CDC ACM compatible devices.
  * Largely derived with modifications from the ESP-IDF cdc_acm_host example:
  *   https://github.com/espressif/esp-idf/tree/master/examples/peripherals/usb/host/cdc/cdc_acm_host
  *
+ * Several ports are bridged at once; each port is one CDC interface, selected
+ * by a usb_route_t, and has its own connection task and buffers.
+ *
  * TODO(K6PLI): Debug why end of tx data corrupts beginning of next tx.
  */
 #pragma once
@@ -14,7 +17,40 @@
 
 static const int USB_HOST_PRIORITY = 20;
 
-void usb_setup();
+// Maximum number of ports bridged at the same time.
+#define USB_MAX_PORTS (2)
+
+// Selects the device and interface of a port. Devices with equal VID/PID are
+// told apart by serial number, NULL accepts any.
+typedef struct {
+  uint16_t vid;  // Or CDC_HOST_ANY_VID.
+  uint16_t pid;  // Or CDC_HOST_ANY_PID.
+  const char* serial;
+  uint8_t interface_idx;
+} usb_route_t;
+
+typedef bool (*usb_data_receive_callback_t)(
+    int port, const uint8_t* data, size_t data_len);
+
+// Port N is opened according to routes[N]. routes must stay valid.
+void usb_setup(const usb_route_t* routes, int route_count);
+// The ports are opened, and reopened after a disconnect, in the background.
+// While a device is away for a short time, writes are held and sent on
+// reconnect.
 bool usb_tx_blocking_if_connected(
-    const uint8_t* buf, size_t buf_len, uint32_t timeout_ms);
-void usb_register_new_data_receive_callback(cdc_acm_data_callback_t callback);
+    int port, const uint8_t* buf, size_t buf_len, uint32_t timeout_ms);
+// Queues data without waiting for transmission. Short writes are merged and
+// sent on ';' or within a few milliseconds.
+bool usb_tx_coalesced_if_connected(
+    int port, const uint8_t* buf, size_t buf_len, uint32_t timeout_ms);
+void usb_register_new_data_receive_callback(
+    usb_data_receive_callback_t callback);
+// Called when the device of a port is disconnected; buffers held with
+// usb_rx_buffer_hold() are no longer valid after this.
+void usb_register_disconnect_callback(void (*callback)(int port));
+
+// Zero-copy receive: may only be called from the data receive callback. On
+// success the received buffer stays valid until usb_rx_buffer_release(); if it
+// returns false the data must be copied before the callback returns.
+bool usb_rx_buffer_hold(int port, const uint8_t* data);
+void usb_rx_buffer_release(int port, const uint8_t* data);